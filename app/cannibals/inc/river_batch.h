@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_RIVER_BATCH_H_
+#define CS776_RIVER_BATCH_H_
+#include "river_state.h"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+/*
+CrossingTable answers "what is the fewest crossings for m missionaries and
+c cannibals" for one boat capacity, for as many sizes as are asked.
+
+Whether a bank is safe depends on how many people are on the other bank,
+so every size has its own state graph and the distances of one size say
+nothing about another's. What is shared between the sizes is everything
+else:
+  * the boat loads (missionaries, cannibals) for the capacity, worked out
+    once instead of for every state expanded
+  * the breadth first search's buffers: the queue, and a visited mark per
+    (missionaries on origin, cannibals on origin, boat) slot which is the
+    number of the search that set it, so it never has to be cleared
+  * the answers, so a size asked for again isn't searched again
+
+The table is built for the largest group it will be asked about, and
+only the loads that many people can fill are made: a boat with more seats
+than there are people is no different from one with exactly that many.
+
+Sizes the rules alone decide don't need a search at all: more cannibals
+than (at least one) missionaries is unsafe from the start, and a group the
+boat can carry at once takes one crossing.
+
+The search is the same one RiverBfs does (the same states are valid and
+the same trips are allowed), only on plain counts, stopping at the goal.
+*/
+class CrossingTable
+{
+public:
+	static const uint32_t kUnsolvable = UINT32_MAX;
+	//max_people is the most missionaries plus cannibals MinCrossings will be asked about
+	CrossingTable(uint32_t boat_capacity, uint32_t max_people) : boat_capacity_(boat_capacity), max_people_(max_people), query_(0), num_searches_(0)
+	{
+		uint32_t max_load = std::min(boat_capacity, max_people);
+		for (uint32_t missionaries = 0; missionaries <= max_load; ++missionaries)
+		{
+			//someone has to drive the boat
+			for (uint32_t cannibals = (missionaries == 0 ? 1 : 0); missionaries + cannibals <= max_load; ++cannibals)
+			{
+				load_t load = {missionaries, cannibals};
+				loads_.push_back(load);
+			}
+		}
+	}
+	uint32_t BoatCapacity() const
+	{
+		return boat_capacity_;
+	}
+	//the fewest crossings to get everyone across, kUnsolvable if it can't be done
+	uint32_t MinCrossings(uint32_t num_missionaries, uint32_t num_cannibals)
+	{
+		LOGASSERT((uint64_t)num_missionaries + num_cannibals <= max_people_, "The crossing table was built for at most %u people", max_people_);
+		uint64_t key = ((uint64_t)num_missionaries << 32) | num_cannibals;
+		std::unordered_map<uint64_t, uint32_t>::const_iterator answer_it = answers_.find(key);
+		if (answer_it != answers_.end())
+		{
+			return answer_it->second;
+		}
+		uint32_t crossings;
+		if ((num_missionaries == 0 && num_cannibals == 0) || !IsBankValid(num_missionaries, num_cannibals))
+		{
+			//nobody to drive the boat, or the cannibals outnumber the missionaries before anyone moves
+			crossings = kUnsolvable;
+		} else if (num_missionaries + num_cannibals <= boat_capacity_)
+		{
+			crossings = 1;
+		} else
+		{
+			crossings = Search(num_missionaries, num_cannibals);
+		}
+		answers_[key] = crossings;
+		return crossings;
+	}
+	//how many sizes needed a search
+	uint64_t NumSearches() const
+	{
+		return num_searches_;
+	}
+private:
+	typedef struct load_s
+	{
+		uint32_t missionaries;
+		uint32_t cannibals;
+	} load_t;
+	//the same criteria as IsStateValid, for one bank
+	static inline bool IsBankValid(uint32_t missionaries, uint32_t cannibals)
+	{
+		return missionaries == 0 || missionaries >= cannibals;
+	}
+	//breadth first search from everyone on the origin side, indexes as in RiverState::Index
+	uint32_t Search(uint32_t num_missionaries, uint32_t num_cannibals)
+	{
+		num_searches_++;
+		if (++query_ == 0)
+		{
+			//the marks of 2^32 searches ago would look current, start again
+			std::fill(marks_.begin(), marks_.end(), 0);
+			query_ = 1;
+		}
+		size_t num_slots = ((size_t)num_missionaries + 1) * ((size_t)num_cannibals + 1) * 2;
+		if (marks_.size() < num_slots)
+		{
+			marks_.resize(num_slots, 0);
+			queue_.reserve(num_slots);
+		}
+		const uint32_t row = num_cannibals + 1;
+		queue_.clear();
+		//origin missionaries, origin cannibals, boat
+		size_t initial = ((size_t)num_missionaries * row + num_cannibals) << 1;
+		marks_[initial] = query_;
+		queue_.push_back((uint32_t)initial);
+		size_t level_begin = 0;
+		for (uint32_t crossings = 1; level_begin < queue_.size(); ++crossings)
+		{
+			size_t level_end = queue_.size();
+			for (size_t position = level_begin; position < level_end; ++position)
+			{
+				uint32_t slot = queue_[position];
+				bool boat = (slot & 1) != 0;
+				uint32_t cannibals_origin = (slot >> 1) % row;
+				uint32_t missionaries_origin = (slot >> 1) / row;
+				//people with the boat
+				uint32_t missionaries_here = boat ? num_missionaries - missionaries_origin : missionaries_origin;
+				uint32_t cannibals_here = boat ? num_cannibals - cannibals_origin : cannibals_origin;
+				for (std::vector<load_t>::const_iterator load_it = loads_.begin(); load_it != loads_.end(); ++load_it)
+				{
+					if (load_it->missionaries > missionaries_here || load_it->cannibals > cannibals_here)
+					{
+						continue;
+					}
+					uint32_t next_missionaries = boat ? missionaries_origin + load_it->missionaries : missionaries_origin - load_it->missionaries;
+					uint32_t next_cannibals = boat ? cannibals_origin + load_it->cannibals : cannibals_origin - load_it->cannibals;
+					if (!IsBankValid(next_missionaries, next_cannibals) || !IsBankValid(num_missionaries - next_missionaries, num_cannibals - next_cannibals))
+					{
+						continue;
+					}
+					size_t next_slot = (((size_t)next_missionaries * row + next_cannibals) << 1) | (boat ? 0 : 1);
+					if (marks_[next_slot] == query_)
+					{
+						continue;
+					}
+					if (next_slot == 1)
+					{
+						//nobody left on the origin side and the boat across
+						return crossings;
+					}
+					marks_[next_slot] = query_;
+					queue_.push_back((uint32_t)next_slot);
+				}
+			}
+			level_begin = level_end;
+		}
+		return kUnsolvable;
+	}
+	uint32_t boat_capacity_;
+	uint32_t max_people_;
+	std::vector<load_t> loads_;
+	//marks_[slot] == query_ means the slot has been reached by the current search
+	std::vector<uint32_t> marks_;
+	uint32_t query_;
+	std::vector<uint32_t> queue_;
+	std::unordered_map<uint64_t, uint32_t> answers_;
+	uint64_t num_searches_;
+};
+
+//one row of the batch table
+typedef struct batch_result_s
+{
+	RiverConfig river_config;
+	//CrossingTable::kUnsolvable if there is no solution
+	uint32_t crossings;
+} batch_result_t;
+
+/*
+  The fewest crossings for every one of configs, in the same order. The
+  configurations are grouped by boat capacity so each capacity's
+  CrossingTable is built once and shared by all of its sizes.
+*/
+inline std::vector<batch_result_t> SolveBatch(const std::vector<RiverConfig>& configs, uint64_t* num_searches)
+{
+	std::vector<uint32_t> order(configs.size());
+	for (uint32_t config = 0; config < (uint32_t)configs.size(); ++config)
+	{
+		order[config] = config;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return configs[a].boat_capacity < configs[b].boat_capacity;
+	});
+	std::vector<batch_result_t> results(configs.size());
+	*num_searches = 0;
+	size_t group_begin = 0;
+	while (group_begin < order.size())
+	{
+		const uint32_t boat_capacity = configs[order[group_begin]].boat_capacity;
+		uint32_t max_people = 0;
+		size_t group_end = group_begin;
+		for (; group_end < order.size() && configs[order[group_end]].boat_capacity == boat_capacity; ++group_end)
+		{
+			max_people = std::max(max_people, configs[order[group_end]].num_missionaries + configs[order[group_end]].num_cannibals);
+		}
+		CrossingTable table(boat_capacity, max_people);
+		for (group_end = group_begin; group_end < order.size() && configs[order[group_end]].boat_capacity == boat_capacity; ++group_end)
+		{
+			const RiverConfig& river_config = configs[order[group_end]];
+			results[order[group_end]].river_config = river_config;
+			results[order[group_end]].crossings = table.MinCrossings(river_config.num_missionaries, river_config.num_cannibals);
+		}
+		*num_searches += table.NumSearches();
+		group_begin = group_end;
+	}
+	return results;
+}
+#endif //CS776_RIVER_BATCH_H_
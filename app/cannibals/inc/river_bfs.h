@@ -0,0 +1,308 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_RIVER_BFS_H_
+#define CS776_RIVER_BFS_H_
+#include "river_state.h"
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+/*
+VisitedStates is the set of states a search has found, as one bit per
+possible (missionaries on origin, cannibals on origin, boat) combination:
+(M + 1) * (C + 1) * 2 bits, e.g. 4 MB for 4000 missionaries and 4000
+cannibals. Finding a state is an index calculation and a bit test, there's
+no hashing or probing.
+
+InsertConcurrent sets the bit with an atomic fetch_or, so any number of
+threads can insert at once without locks and exactly one of them is told
+the state is new.
+*/
+class VisitedStates
+{
+public:
+	VisitedStates() : num_words_(0)
+	{
+	}
+	//empties the set and sizes it for river_config's states
+	void Reset(const RiverConfig& river_config)
+	{
+		size_t num_words = (RiverState::NumIndexes(river_config) + 63) / 64;
+		if (num_words != num_words_)
+		{
+			words_.reset(new std::atomic<uint64_t>[num_words]);
+			num_words_ = num_words;
+		}
+		for (size_t word = 0; word < num_words_; ++word)
+		{
+			words_[word].store(0, std::memory_order_relaxed);
+		}
+	}
+	//adds state, returns false if it was already in the set. Only for one thread at a time
+	inline bool Insert(const RiverState& state)
+	{
+		size_t bit = state.Index();
+		std::atomic<uint64_t>& word = words_[bit / 64];
+		uint64_t mask = 1ull << (bit % 64);
+		uint64_t value = word.load(std::memory_order_relaxed);
+		if (value & mask)
+		{
+			return false;
+		}
+		word.store(value | mask, std::memory_order_relaxed);
+		return true;
+	}
+	//Insert for any number of threads at once
+	inline bool InsertConcurrent(const RiverState& state)
+	{
+		size_t bit = state.Index();
+		std::atomic<uint64_t>& word = words_[bit / 64];
+		uint64_t mask = 1ull << (bit % 64);
+		//most states generated have been seen already, a plain load rules those out without the locked instruction
+		if (word.load(std::memory_order_relaxed) & mask)
+		{
+			return false;
+		}
+		return (word.fetch_or(mask, std::memory_order_relaxed) & mask) == 0;
+	}
+private:
+	size_t num_words_;
+	std::unique_ptr<std::atomic<uint64_t>[]> words_;
+};
+
+/*
+RiverBfs is a level synchronous breadth first search over the valid river
+states, starting from everyone on the origin side.
+
+Every state reached is appended to nodes_ along with the index of the node
+it was reached from, so nodes_ is both the BFS queue and the search tree:
+the nodes of each level are a contiguous range of it, and a level is
+expanded by walking that range while the next level is appended behind it.
+There is no recursion, so the depth of the state space doesn't matter.
+
+Since the levels are expanded in order the first time the goal is reached
+is by a shortest crossing, and the goal is recorded as soon as it is
+generated so the solution is read off the parent indexes without another
+search. Run either stops there (SOLVE) or carries on until every reachable
+state has been found (ENUMERATE), which is what the state space diagram
+needs.
+
+With SetNumThreads(n) the levels of at least kMinParallelLevel nodes are
+split into n contiguous slices, one per thread. Each thread appends what it
+discovers to its own buffer, the visited set is shared through
+InsertConcurrent, and the buffers are appended to nodes_ in thread order
+once the whole level is done, so the levels stay contiguous. A state
+reachable from nodes in two slices goes to whichever thread inserts it
+first, so the parents chosen (but not the levels, or the length of the
+solution) can differ from run to run.
+*/
+class RiverBfs
+{
+public:
+	enum Mode
+	{
+		SOLVE,
+		ENUMERATE
+	};
+	static const uint32_t kNoParent = UINT32_MAX;
+	//smaller levels are expanded by the calling thread alone, they are done before threads would have started
+	static const size_t kMinParallelLevel = 4096;
+	typedef struct node_s
+	{
+		RiverState state;
+		//the index of the node this one was reached from, kNoParent for the initial state
+		uint32_t parent;
+	} node_t;
+	explicit RiverBfs(const RiverConfig& river_config) : river_config_(river_config)
+	{
+		goal_ = kNoParent;
+		num_expanded_ = 0;
+		num_levels_ = 0;
+		num_threads_ = 1;
+	}
+	//0 means one per hardware thread
+	void SetNumThreads(uint32_t num_threads)
+	{
+		num_threads_ = num_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : num_threads;
+	}
+	//returns true if the goal was reached
+	bool Run(Mode mode)
+	{
+		return Run(mode, [](size_t, size_t) {});
+	}
+	/*
+	  Run which also calls level_done(level_begin, level_end) on the calling
+	  thread as soon as the level Nodes()[level_begin, level_end) has been
+	  expanded, i.e. every node it reached has been appended to Nodes(), so
+	  the search can be written out as it goes (see StateGraphWriter)
+	*/
+	template<typename LevelVisitor>
+	bool Run(Mode mode, LevelVisitor level_done)
+	{
+		nodes_.clear();
+		visited_.Reset(river_config_);
+		goal_ = kNoParent;
+		num_expanded_ = 0;
+		num_levels_ = 0;
+		const RiverState goal_state = RiverState::Goal(river_config_);
+		Discover(RiverState::Initial(river_config_), kNoParent, goal_state);
+		size_t level_begin = 0;
+		while (level_begin < nodes_.size() && !(mode == SOLVE && Solved()))
+		{
+			size_t level_end = nodes_.size();
+			if (num_threads_ > 1 && level_end - level_begin >= kMinParallelLevel)
+			{
+				ExpandLevelParallel(level_begin, level_end, mode, goal_state);
+			} else
+			{
+				for (size_t node = level_begin; node < level_end && !(mode == SOLVE && Solved()); ++node)
+				{
+					//copied since nodes_ may grow while the successors are added
+					RiverState state = nodes_[node].state;
+					ForEachSuccessor(state, river_config_.boat_capacity, [&](const RiverState& next_state)
+					{
+						Discover(next_state, (uint32_t)node, goal_state);
+					});
+					num_expanded_++;
+				}
+			}
+			level_done(level_begin, level_end);
+			level_begin = level_end;
+			num_levels_++;
+		}
+		return Solved();
+	}
+	bool Solved() const
+	{
+		return goal_ != kNoParent;
+	}
+	//the states from the initial state to the goal, empty if the goal wasn't reached
+	std::vector<RiverState> Solution() const
+	{
+		std::vector<RiverState> path;
+		for (uint32_t node = goal_; node != kNoParent; node = nodes_[node].parent)
+		{
+			path.push_back(nodes_[node].state);
+		}
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
+	//every state found, in the order they were found. A node's parent always comes before it
+	const std::vector<node_t>& Nodes() const
+	{
+		return nodes_;
+	}
+	size_t NumExpanded() const
+	{
+		return num_expanded_;
+	}
+	uint32_t NumLevels() const
+	{
+		return num_levels_;
+	}
+private:
+	void Discover(const RiverState& state, uint32_t parent, const RiverState& goal_state)
+	{
+		//insert only succeeds if no equivalent state has been found before
+		if (!visited_.Insert(state))
+		{
+			return;
+		}
+		if (state == goal_state)
+		{
+			goal_ = (uint32_t)nodes_.size();
+		}
+		node_t node;
+		node.state = state;
+		node.parent = parent;
+		nodes_.push_back(node);
+	}
+	//expands nodes_[level_begin, level_end) on num_threads_ threads, see the class comment
+	void ExpandLevelParallel(size_t level_begin, size_t level_end, Mode mode, const RiverState& goal_state)
+	{
+		uint32_t num_threads = num_threads_;
+		size_t level_size = level_end - level_begin;
+		//kept between levels so they only allocate while the levels are still growing
+		next_levels_.resize(num_threads);
+		std::vector<uint32_t> thread_goal(num_threads, kNoParent);
+		std::vector<size_t> thread_expanded(num_threads, 0);
+		std::atomic<bool> goal_found(false);
+		auto worker = [&](uint32_t thread_index)
+		{
+			std::vector<node_t>& next_level = next_levels_[thread_index];
+			next_level.clear();
+			size_t slice_end = level_begin + level_size * (thread_index + 1) / num_threads;
+			for (size_t node = level_begin + level_size * thread_index / num_threads; node < slice_end; ++node)
+			{
+				if (mode == SOLVE && goal_found.load(std::memory_order_relaxed))
+				{
+					break;
+				}
+				ForEachSuccessor(nodes_[node].state, river_config_.boat_capacity, [&](const RiverState& next_state)
+				{
+					if (!visited_.InsertConcurrent(next_state))
+					{
+						return;
+					}
+					if (next_state == goal_state)
+					{
+						thread_goal[thread_index] = (uint32_t)next_level.size();
+						goal_found.store(true, std::memory_order_relaxed);
+					}
+					node_t next_node;
+					next_node.state = next_state;
+					next_node.parent = (uint32_t)node;
+					next_level.push_back(next_node);
+				});
+				thread_expanded[thread_index]++;
+			}
+		};
+		std::vector<std::thread> threads;
+		for (uint32_t thread_index = 1; thread_index < num_threads; ++thread_index)
+		{
+			threads.push_back(std::thread(worker, thread_index));
+		}
+		//the calling thread does its share of the work too
+		worker(0);
+		for (std::vector<std::thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); ++thread_it)
+		{
+			thread_it->join();
+		}
+		for (uint32_t thread_index = 0; thread_index < num_threads; ++thread_index)
+		{
+			if (thread_goal[thread_index] != kNoParent)
+			{
+				goal_ = (uint32_t)nodes_.size() + thread_goal[thread_index];
+			}
+			nodes_.insert(nodes_.end(), next_levels_[thread_index].begin(), next_levels_[thread_index].end());
+			num_expanded_ += thread_expanded[thread_index];
+		}
+	}
+	RiverConfig river_config_;
+	std::vector<node_t> nodes_;
+	VisitedStates visited_;
+	uint32_t goal_;
+	size_t num_expanded_;
+	uint32_t num_levels_;
+	uint32_t num_threads_;
+	std::vector<std::vector<node_t>> next_levels_;
+};
+#endif //CS776_RIVER_BFS_H_
@@ -0,0 +1,281 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_RIVER_SEARCH_H_
+#define CS776_RIVER_SEARCH_H_
+#include "river_state.h"
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+
+/*
+The searches which only look for a shortest solution, as opposed to
+RiverBfs which can also enumerate the state space. Both work on
+ForEachSuccessor directly and only keep a hash map of the states they have
+reached, so their memory is proportional to what they explore rather than
+to the size of the state space.
+*/
+
+//what a search found and how much work it took
+typedef struct river_search_result_s
+{
+	bool solved;
+	//the states from the initial state to the goal, empty if there is no solution
+	std::vector<RiverState> solution;
+	//states whose successors were generated
+	size_t num_expanded;
+	//states reached, including the ones never expanded
+	size_t num_reached;
+} river_search_result_t;
+
+/*
+  A lower bound on the number of crossings from state to the goal. A trip
+  from the origin carries at most boat_capacity people and, unless it is
+  the last one, someone has to bring the boat back, so every round trip
+  moves at most boat_capacity - 1 people across. With p people on the
+  origin and the boat there that is at least
+
+	2 * ceil((p - boat_capacity) / (boat_capacity - 1)) + 1
+
+  crossings (1 if they all fit in the boat). With the boat on the
+  destination side one crossing is needed to bring it back, with at least
+  one person, first. A boat of one seat can't shuttle anyone, so the bound
+  is just whether a crossing is needed at all.
+*/
+inline uint32_t CrossingsLowerBound(const RiverState& state, uint32_t boat_capacity)
+{
+	uint32_t on_origin = state.MissionariesOrigin() + state.CannibalsOrigin();
+	if (on_origin == 0)
+	{
+		return 0;
+	}
+	uint32_t return_trip = 0;
+	if (state.BoatState())
+	{
+		return_trip = 1;
+		on_origin++;
+	}
+	if (boat_capacity < 2)
+	{
+		return return_trip + 1;
+	}
+	if (on_origin <= boat_capacity)
+	{
+		return return_trip + 1;
+	}
+	//ceil((on_origin - boat_capacity) / (boat_capacity - 1))
+	uint32_t round_trips = (on_origin - 2) / (boat_capacity - 1);
+	return return_trip + 2 * round_trips + 1;
+}
+
+//the path ending at end through a map of state keys to the key of the state each was reached from, end first
+template<typename Record>
+inline void TracePath(const std::unordered_map<uint64_t, Record>& records, RiverState end, uint64_t no_parent, std::vector<RiverState>* path)
+{
+	uint64_t key = end.Key();
+	while (key != no_parent)
+	{
+		const Record& record = records.find(key)->second;
+		path->push_back(record.state);
+		key = record.parent;
+	}
+}
+
+/*
+  A* from the initial state to the goal, with f = crossings so far +
+  CrossingsLowerBound. Every crossing costs 1 and the bound never
+  overestimates, so the first time the goal is taken off the open list its
+  path is a shortest one. Ties in f go to the deeper state, which heads
+  straight for the goal once the bound is exact instead of widening the
+  search. A state reached again by a shorter path is reopened, so the
+  result doesn't depend on the bound being consistent.
+*/
+inline river_search_result_t SolveAStar(const RiverConfig& river_config)
+{
+	//no packed state uses the top bits, so this is never a key
+	const uint64_t kNoParent = UINT64_MAX;
+	typedef struct astar_record_s
+	{
+		RiverState state;
+		uint64_t parent;
+		uint32_t crossings;
+		bool closed;
+	} astar_record_t;
+	typedef struct open_entry_s
+	{
+		uint32_t estimate;
+		uint32_t crossings;
+		RiverState state;
+		//the priority queue is a max heap, so the "largest" entry is the one with the smallest estimate and then the most crossings
+		bool operator<(const open_entry_s& rhs) const
+		{
+			if (estimate != rhs.estimate)
+			{
+				return estimate > rhs.estimate;
+			}
+			return crossings < rhs.crossings;
+		}
+	} open_entry_t;
+
+	river_search_result_t result;
+	result.solved = false;
+	result.num_expanded = 0;
+	const RiverState initial_state = RiverState::Initial(river_config);
+	const RiverState goal_state = RiverState::Goal(river_config);
+	std::unordered_map<uint64_t, astar_record_t> records;
+	std::priority_queue<open_entry_t> open;
+	astar_record_t initial_record = {initial_state, kNoParent, 0, false};
+	records[initial_state.Key()] = initial_record;
+	open_entry_t initial_entry = {CrossingsLowerBound(initial_state, river_config.boat_capacity), 0, initial_state};
+	open.push(initial_entry);
+	while (!open.empty())
+	{
+		open_entry_t entry = open.top();
+		open.pop();
+		astar_record_t& record = records[entry.state.Key()];
+		//stale entries are left in the queue when a state is reopened with fewer crossings, skip them
+		if (record.closed || entry.crossings != record.crossings)
+		{
+			continue;
+		}
+		if (entry.state == goal_state)
+		{
+			result.solved = true;
+			TracePath(records, goal_state, kNoParent, &result.solution);
+			std::reverse(result.solution.begin(), result.solution.end());
+			break;
+		}
+		record.closed = true;
+		result.num_expanded++;
+		uint32_t next_crossings = entry.crossings + 1;
+		ForEachSuccessor(entry.state, river_config.boat_capacity, [&](const RiverState& next_state)
+		{
+			std::pair<std::unordered_map<uint64_t, astar_record_t>::iterator, bool> inserted = records.insert(std::make_pair(next_state.Key(), astar_record_t()));
+			astar_record_t& next_record = inserted.first->second;
+			if (!inserted.second && next_record.crossings <= next_crossings)
+			{
+				return;
+			}
+			next_record.state = next_state;
+			next_record.parent = entry.state.Key();
+			next_record.crossings = next_crossings;
+			next_record.closed = false;
+			open_entry_t next_entry = {next_crossings + CrossingsLowerBound(next_state, river_config.boat_capacity), next_crossings, next_state};
+			open.push(next_entry);
+		});
+	}
+	result.num_reached = records.size();
+	return result;
+}
+
+/*
+  Breadth first search from the initial state and from the goal at the same
+  time. ForEachSuccessor is its own inverse (a trip is undone by taking the
+  same people back), so the backward search uses it unchanged.
+
+  Each step expands a whole level of whichever side has the smaller
+  frontier. When that level reaches a state the other side has already
+  found, the rest of the level is still expanded and the meeting with the
+  fewest crossings in total is kept: the meetings found in one level can
+  differ in the other side's depth, and the first one found isn't
+  necessarily the shortest.
+
+  Both sides only grow to about half the solution, which saves a lot when
+  the number of states grows quickly with depth. The river problems aren't
+  like that: their state space is closer to a long corridor, so the two
+  sides sweep most of it before they meet (see --bench-search), and A* is
+  the one which expands far fewer states.
+*/
+inline river_search_result_t SolveBidirectional(const RiverConfig& river_config)
+{
+	const uint64_t kNoParent = UINT64_MAX;
+	typedef struct bfs_record_s
+	{
+		RiverState state;
+		uint64_t parent;
+		uint32_t crossings;
+	} bfs_record_t;
+	typedef std::unordered_map<uint64_t, bfs_record_t> RecordMap;
+
+	river_search_result_t result;
+	result.solved = false;
+	result.num_expanded = 0;
+	const RiverState initial_state = RiverState::Initial(river_config);
+	const RiverState goal_state = RiverState::Goal(river_config);
+	//[0] searches forward from the initial state, [1] backward from the goal
+	RecordMap records[2];
+	std::vector<RiverState> frontiers[2];
+	bfs_record_t initial_record = {initial_state, kNoParent, 0};
+	bfs_record_t goal_record = {goal_state, kNoParent, 0};
+	records[0][initial_state.Key()] = initial_record;
+	frontiers[0].push_back(initial_state);
+	//the forward search only generates valid states, so an invalid goal (e.g. more cannibals than missionaries) can't be reached and mustn't be searched from
+	if (IsStateValid(goal_state))
+	{
+		records[1][goal_state.Key()] = goal_record;
+		frontiers[1].push_back(goal_state);
+	}
+	bool met = initial_state == goal_state;
+	RiverState meeting_state = initial_state;
+	std::vector<RiverState> next_frontier;
+	while (!met && !frontiers[0].empty() && !frontiers[1].empty())
+	{
+		uint32_t side = frontiers[0].size() <= frontiers[1].size() ? 0 : 1;
+		RecordMap& own_records = records[side];
+		const RecordMap& other_records = records[1 - side];
+		uint32_t best_crossings = UINT32_MAX;
+		next_frontier.clear();
+		for (std::vector<RiverState>::const_iterator state_it = frontiers[side].begin(); state_it != frontiers[side].end(); ++state_it)
+		{
+			const RiverState state = *state_it;
+			uint32_t next_crossings = own_records[state.Key()].crossings + 1;
+			ForEachSuccessor(state, river_config.boat_capacity, [&](const RiverState& next_state)
+			{
+				bfs_record_t next_record = {next_state, state.Key(), next_crossings};
+				if (!own_records.insert(std::make_pair(next_state.Key(), next_record)).second)
+				{
+					return;
+				}
+				next_frontier.push_back(next_state);
+				RecordMap::const_iterator other_it = other_records.find(next_state.Key());
+				if (other_it != other_records.end() && next_crossings + other_it->second.crossings < best_crossings)
+				{
+					best_crossings = next_crossings + other_it->second.crossings;
+					meeting_state = next_state;
+					met = true;
+				}
+			});
+			result.num_expanded++;
+		}
+		frontiers[side].swap(next_frontier);
+	}
+	result.num_reached = records[0].size() + records[1].size();
+	if (met)
+	{
+		result.solved = true;
+		//the forward half ends at the meeting state and the backward half starts there
+		TracePath(records[0], meeting_state, kNoParent, &result.solution);
+		std::reverse(result.solution.begin(), result.solution.end());
+		std::vector<RiverState> backward;
+		TracePath(records[1], meeting_state, kNoParent, &backward);
+		result.solution.insert(result.solution.end(), backward.begin() + 1, backward.end());
+	}
+	return result;
+}
+#endif //CS776_RIVER_SEARCH_H_
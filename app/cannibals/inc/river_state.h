@@ -0,0 +1,233 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_RIVER_STATE_H_
+#define CS776_RIVER_STATE_H_
+#include "ionlib\log.h"
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <algorithm>
+
+//This is used to get command line paramters
+typedef struct RiverConfig_e {
+	uint32_t num_missionaries;
+	uint32_t num_cannibals;
+	uint32_t boat_capacity;
+} RiverConfig;
+
+/*
+RiverState defines one configuration of the missionaries, cannibals, and the boat
+
+Only how many missionaries and cannibals are on each side matters, not which
+ones, so the state is packed into a single integer: the number of each on the
+origin side, where the boat is, and the totals (so the destination counts can
+be worked out without the RiverConfig). Moving people and checking the
+cannibal criteria are then a few additions and comparisons, and a state is 8
+bytes with nothing on the heap.
+
+The output format still lists every person, see operator<<
+*/
+class RiverState
+{
+public:
+	//each count is a 15 bit field of the packed state
+	static const uint32_t kMaxPeople = (1u << 15) - 1;
+	RiverState() : packed_(0)
+	{
+	}
+	//the convention is that boat_state answers the question "is the boat on the correct side of the river?",
+	//that is, the initial state is false and the final state is true
+	RiverState(uint32_t num_missionaries, uint32_t num_cannibals, uint32_t missionaries_origin, uint32_t cannibals_origin, bool boat_state)
+	{
+		LOGASSERT(num_missionaries <= kMaxPeople && num_cannibals <= kMaxPeople, "At most 32767 missionaries and 32767 cannibals are supported");
+		LOGASSERT(missionaries_origin <= num_missionaries && cannibals_origin <= num_cannibals);
+		packed_ = ((uint64_t)num_missionaries << kNumMissionariesShift) | ((uint64_t)num_cannibals << kNumCannibalsShift) |
+			((uint64_t)missionaries_origin << kMissionariesOriginShift) | ((uint64_t)cannibals_origin << kCannibalsOriginShift) | (boat_state ? 1 : 0);
+	}
+	//everyone (and the boat) on the origin side
+	static RiverState Initial(const RiverConfig& river_config)
+	{
+		return RiverState(river_config.num_missionaries, river_config.num_cannibals, river_config.num_missionaries, river_config.num_cannibals, false);
+	}
+	//everyone (and the boat) on the destination side
+	static RiverState Goal(const RiverConfig& river_config)
+	{
+		return RiverState(river_config.num_missionaries, river_config.num_cannibals, 0, 0, true);
+	}
+	inline uint32_t NumMissionaries() const
+	{
+		return Field(kNumMissionariesShift);
+	}
+	inline uint32_t NumCannibals() const
+	{
+		return Field(kNumCannibalsShift);
+	}
+	inline uint32_t MissionariesOrigin() const
+	{
+		return Field(kMissionariesOriginShift);
+	}
+	inline uint32_t CannibalsOrigin() const
+	{
+		return Field(kCannibalsOriginShift);
+	}
+	inline uint32_t MissionariesDestination() const
+	{
+		return NumMissionaries() - MissionariesOrigin();
+	}
+	inline uint32_t CannibalsDestination() const
+	{
+		return NumCannibals() - CannibalsOrigin();
+	}
+	inline bool BoatState() const
+	{
+		return (packed_ & 1) != 0;
+	}
+	//the number of missionaries/cannibals on the same side as the boat
+	inline uint32_t MissionariesWithBoat() const
+	{
+		return BoatState() ? MissionariesDestination() : MissionariesOrigin();
+	}
+	inline uint32_t CannibalsWithBoat() const
+	{
+		return BoatState() ? CannibalsDestination() : CannibalsOrigin();
+	}
+	//Two states are equal exactly when their keys are
+	inline uint64_t Key() const
+	{
+		return packed_;
+	}
+	//a number in [0, NumIndexes(river_config)) unique to the state among those with its totals, for tables with a slot per state
+	inline size_t Index() const
+	{
+		return (((size_t)MissionariesOrigin() * (NumCannibals() + 1) + CannibalsOrigin()) << 1) | (BoatState() ? 1 : 0);
+	}
+	static size_t NumIndexes(const RiverConfig& river_config)
+	{
+		return ((size_t)river_config.num_missionaries + 1) * ((size_t)river_config.num_cannibals + 1) * 2;
+	}
+	bool operator==(const RiverState& rhs) const
+	{
+		return packed_ == rhs.packed_;
+	}
+	/*
+	  Prints <missionaries><cannibals><boat> with a 0 (origin) or 1
+	  (destination) per person. Since people aren't told apart the ones on the
+	  destination side are listed first, e.g. 2 of 3 missionaries across is
+	  <1,1,0>
+	*/
+	friend std::ostream& operator<<(std::ostream& output, const RiverState& state)
+	{
+		output << "<";
+		PrintSides(output, state.MissionariesDestination(), state.NumMissionaries());
+		output << "><";
+		PrintSides(output, state.CannibalsDestination(), state.NumCannibals());
+		output << "><" << state.BoatState() << ">";
+		return output;
+	}
+private:
+	static const uint32_t kCannibalsOriginShift = 1;
+	static const uint32_t kMissionariesOriginShift = 16;
+	static const uint32_t kNumCannibalsShift = 31;
+	static const uint32_t kNumMissionariesShift = 46;
+	inline uint32_t Field(uint32_t shift) const
+	{
+		return (uint32_t)(packed_ >> shift) & kMaxPeople;
+	}
+	static void PrintSides(std::ostream& output, uint32_t num_destination, uint32_t num_people)
+	{
+		for (uint32_t person = 0; person < num_people; ++person)
+		{
+			output << (person < num_destination ? "1" : "0");
+			if (person + 1 != num_people)
+			{
+				output << ",";
+			}
+		}
+	}
+	uint64_t packed_;
+};
+//This function updates state by moving a number of people to the other side of
+//the river. Notice that state includes the position of the boat, so "move" is
+//not ambiguous
+inline RiverState MovePeople(RiverState state, size_t num_missionaries, size_t num_cannibals)
+{
+	LOGASSERT(num_missionaries <= state.MissionariesWithBoat(), "Attempted to move more missionaries than are available");
+	LOGASSERT(num_cannibals <= state.CannibalsWithBoat(), "Attempted to move more cannibals than are available");
+	uint32_t missionaries_origin = state.MissionariesOrigin();
+	uint32_t cannibals_origin = state.CannibalsOrigin();
+	if (state.BoatState())
+	{
+		missionaries_origin += (uint32_t)num_missionaries;
+		cannibals_origin += (uint32_t)num_cannibals;
+	} else
+	{
+		missionaries_origin -= (uint32_t)num_missionaries;
+		cannibals_origin -= (uint32_t)num_cannibals;
+	}
+	return RiverState(state.NumMissionaries(), state.NumCannibals(), missionaries_origin, cannibals_origin, !state.BoatState());
+}
+//This function checks if the cannibals outnumber the missionaries on either
+//side of the river
+inline bool IsStateValid(RiverState state)
+{
+	bool result = true;
+	if (state.MissionariesOrigin() > 0)
+	{
+		if (state.MissionariesOrigin() < state.CannibalsOrigin())
+		{
+			result = false;
+		}
+	}
+	if (state.MissionariesDestination() > 0)
+	{
+		if (state.MissionariesDestination() < state.CannibalsDestination())
+		{
+			result = false;
+		}
+	}
+	return result;
+}
+/*
+  Calls visit(next_state) for every valid state one boat trip away from
+  state, in the order the original enumeration generated them: by number of
+  missionaries moved, then number of cannibals moved.
+
+  A trip can always be undone by taking the same people back, so this is
+  also every state which can reach state in one trip.
+*/
+template<typename Visitor>
+inline void ForEachSuccessor(const RiverState& state, uint32_t boat_capacity, Visitor visit)
+{
+	//cap the number of movable people at the boat's capacity
+	uint32_t num_missionaries_movable = std::min(boat_capacity, state.MissionariesWithBoat());
+	uint32_t num_cannibals_movable = std::min(boat_capacity, state.CannibalsWithBoat());
+	for (uint32_t num_missionaries_moved = 0; num_missionaries_moved <= num_missionaries_movable; ++num_missionaries_moved)
+	{
+		uint32_t max_cannibals_to_move = std::min(boat_capacity - num_missionaries_moved, num_cannibals_movable);
+		//someone has to drive the boat
+		for (uint32_t num_cannibals_moved = (num_missionaries_moved == 0 ? 1 : 0); num_cannibals_moved <= max_cannibals_to_move; ++num_cannibals_moved)
+		{
+			RiverState next_state = MovePeople(state, num_missionaries_moved, num_cannibals_moved);
+			if (IsStateValid(next_state))
+			{
+				visit(next_state);
+			}
+		}
+	}
+}
+#endif //CS776_RIVER_STATE_H_
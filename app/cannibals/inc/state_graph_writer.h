@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_STATE_GRAPH_WRITER_H_
+#define CS776_STATE_GRAPH_WRITER_H_
+#include "river_state.h"
+#include "river_bfs.h"
+#include <stdio.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+BufferedFile collects what is written in a string and hands it to the C
+library a megabyte at a time, so writing a line is a few appends instead of
+a trip through iostream formatting.
+*/
+class BufferedFile
+{
+public:
+	static const size_t kBufferSize = 1 << 20;
+	BufferedFile() : file_(nullptr)
+	{
+	}
+	~BufferedFile()
+	{
+		Close();
+	}
+	bool Open(const std::string& filename)
+	{
+		Close();
+		file_ = fopen(filename.c_str(), "w");
+		buffer_.reserve(kBufferSize + 256);
+		return file_ != nullptr;
+	}
+	inline void Write(const char* text, size_t length)
+	{
+		buffer_.append(text, length);
+		if (buffer_.size() >= kBufferSize)
+		{
+			Flush();
+		}
+	}
+	inline void Write(const char* text)
+	{
+		Write(text, strlen(text));
+	}
+	inline void WriteNumber(uint64_t value)
+	{
+		char digits[20];
+		size_t num_digits = 0;
+		do
+		{
+			digits[num_digits++] = (char)('0' + value % 10);
+			value /= 10;
+		} while (value != 0);
+		while (num_digits > 0)
+		{
+			buffer_.push_back(digits[--num_digits]);
+		}
+	}
+	void Flush()
+	{
+		if (file_ != nullptr && !buffer_.empty())
+		{
+			fwrite(buffer_.data(), 1, buffer_.size(), file_);
+		}
+		buffer_.clear();
+	}
+	void Close()
+	{
+		if (file_ != nullptr)
+		{
+			Flush();
+			fclose(file_);
+			file_ = nullptr;
+		}
+	}
+private:
+	FILE* file_;
+	std::string buffer_;
+};
+
+/*
+StateGraphWriter writes the state space diagram while RiverBfs enumerates
+it: WriteLevel is the search's level_done callback, so nothing is kept
+besides what the search keeps anyway and the file is written as the levels
+are finished.
+
+Every state is a node named by its index in the search (n0 is the initial
+state) and its label, the same <missionaries><cannibals><boat> text as the
+solution, is written once when the state is found. Edges only refer to the
+names, so a state's label isn't repeated for every edge it is on.
+
+The edges are either
+  * SPANNING_TREE: the edge each state was first reached by, which is the
+    diagram the tree used to print
+  * ALL_TRANSITIONS: every valid boat trip, in both directions, so the
+    cycles and the edges back to earlier levels are in the diagram too. Each
+    state's trips are written once the level after it has been found, when
+    every state a trip can reach has a name. Finding that name takes a table
+    of one index per possible state, sized like the search's visited set
+*/
+class StateGraphWriter
+{
+public:
+	enum Edges
+	{
+		SPANNING_TREE,
+		ALL_TRANSITIONS
+	};
+	StateGraphWriter(const RiverConfig& river_config, Edges edges) : river_config_(river_config), edges_(edges), num_labelled_(0)
+	{
+		//the label of d of n people across is the 2n - 1 characters starting at 2(n - d): "1," n times then "0," n times
+		BuildSides(river_config.num_missionaries, &missionary_sides_);
+		BuildSides(river_config.num_cannibals, &cannibal_sides_);
+		if (edges_ == ALL_TRANSITIONS)
+		{
+			node_ids_.assign(RiverState::NumIndexes(river_config), (uint32_t)RiverBfs::kNoParent);
+		}
+	}
+	bool Open(const std::string& filename)
+	{
+		if (!file_.Open(filename))
+		{
+			return false;
+		}
+		file_.Write("digraph G {\nroot -> n0\n");
+		return true;
+	}
+	//writes the states search found while expanding Nodes()[level_begin, level_end), and their edges
+	void WriteLevel(const RiverBfs& search, size_t level_begin, size_t level_end)
+	{
+		const std::vector<RiverBfs::node_t>& nodes = search.Nodes();
+		for (; num_labelled_ < nodes.size(); ++num_labelled_)
+		{
+			WriteLabel((uint32_t)num_labelled_, nodes[num_labelled_].state);
+			if (edges_ == SPANNING_TREE && nodes[num_labelled_].parent != RiverBfs::kNoParent)
+			{
+				WriteEdge(nodes[num_labelled_].parent, (uint32_t)num_labelled_);
+			}
+		}
+		if (edges_ == ALL_TRANSITIONS)
+		{
+			for (size_t node = level_begin; node < level_end; ++node)
+			{
+				ForEachSuccessor(nodes[node].state, river_config_.boat_capacity, [&](const RiverState& next_state)
+				{
+					WriteEdge((uint32_t)node, node_ids_[next_state.Index()]);
+				});
+			}
+		}
+	}
+	void Close()
+	{
+		file_.Write("}\n");
+		file_.Close();
+	}
+private:
+	static void BuildSides(uint32_t num_people, std::string* sides)
+	{
+		sides->clear();
+		for (uint32_t person = 0; person < num_people; ++person)
+		{
+			sides->append("1,");
+		}
+		for (uint32_t person = 0; person < num_people; ++person)
+		{
+			sides->append("0,");
+		}
+	}
+	inline void WriteSides(const std::string& sides, uint32_t num_destination, uint32_t num_people)
+	{
+		if (num_people > 0)
+		{
+			file_.Write(sides.data() + 2 * (num_people - num_destination), 2 * num_people - 1);
+		}
+	}
+	void WriteLabel(uint32_t id, const RiverState& state)
+	{
+		if (edges_ == ALL_TRANSITIONS)
+		{
+			node_ids_[state.Index()] = id;
+		}
+		file_.Write("n", 1);
+		file_.WriteNumber(id);
+		file_.Write(" [label=\"<", 10);
+		WriteSides(missionary_sides_, state.MissionariesDestination(), state.NumMissionaries());
+		file_.Write("><", 2);
+		WriteSides(cannibal_sides_, state.CannibalsDestination(), state.NumCannibals());
+		file_.Write(state.BoatState() ? "><1>\"]\n" : "><0>\"]\n", 7);
+	}
+	inline void WriteEdge(uint32_t from, uint32_t to)
+	{
+		file_.Write("n", 1);
+		file_.WriteNumber(from);
+		file_.Write(" -> n", 5);
+		file_.WriteNumber(to);
+		file_.Write("\n", 1);
+	}
+	RiverConfig river_config_;
+	Edges edges_;
+	BufferedFile file_;
+	//how many of the search's nodes have had their label written
+	size_t num_labelled_;
+	std::string missionary_sides_;
+	std::string cannibal_sides_;
+	//ALL_TRANSITIONS only: the name of every state found, by RiverState::Index
+	std::vector<uint32_t> node_ids_;
+};
+#endif //CS776_STATE_GRAPH_WRITER_H_
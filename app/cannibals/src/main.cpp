@@ -16,213 +16,221 @@ along with this program.If not, see <http://www.gnu.org/licenses/>.
 
 */
 #include "ionlib\log.h"
-#include "ionlib\tree.h"
 #include "ionlib\math.h"
+#include "river_state.h"
+#include "river_bfs.h"
+#include "river_search.h"
+#include "state_graph_writer.h"
+#include "river_batch.h"
+#include <stdio.h>
 #include <vector>
+#include <string>
 #include <fstream>
 #include <sstream>
-
-//This is used to get command line paramters
-typedef struct RiverConfig_e {
-	uint32_t num_missionaries;
-	uint32_t num_cannibals;
-	uint32_t boat_capacity;
-} RiverConfig;
+#include <chrono>
+#include <thread>
 
 /*
-RiverState defines one configuration of the missionaries, cannibals, and the boat
-
-Its primary purpose is just to store the member variables, and includes some
-other required operators
+  Enumerates the whole state space of river_config with 1, 2, 4, ... up to
+  max_threads threads and prints the states expanded per second and the
+  speedup over one thread for each.
 */
-class RiverState
+void BenchmarkBfs(const RiverConfig& river_config, uint32_t max_threads)
 {
-public:
-	//the convention is that the fields below answer the question "is the item on the correct side of the river?",
-	//that is, the initial state is false and the final state is true
-	std::vector<bool> missionaries;
-	std::vector<bool> cannibals;
-	bool boat_state;
-	bool operator==(const RiverState& rhs) const
+	printf("%u missionaries, %u cannibals, %u seats\n", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity);
+	printf("threads   states   levels  seconds  expanded/s  speedup  efficiency\n");
+	double single_thread_seconds = 0.0;
+	for (uint32_t num_threads = 1; num_threads <= max_threads; num_threads = (num_threads * 2 > max_threads && num_threads != max_threads) ? max_threads : num_threads * 2)
 	{
-		if (this->boat_state != rhs.boat_state)
+		RiverBfs search(river_config);
+		search.SetNumThreads(num_threads);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		search.Run(RiverBfs::ENUMERATE);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (num_threads == 1)
 		{
-			return false;
+			single_thread_seconds = seconds;
 		}
-		size_t num_missionaries_lhs = std::count(this->missionaries.begin(), this->missionaries.end(), false);
-		size_t num_canibals_lhs = std::count(this->cannibals.begin(), this->cannibals.end(), false);
-		size_t num_missionaries_rhs = std::count(rhs.missionaries.begin(), rhs.missionaries.end(), false);
-		size_t num_canibals_rhs = std::count(rhs.cannibals.begin(), rhs.cannibals.end(), false);
-		return (num_missionaries_lhs == num_missionaries_rhs && num_canibals_lhs == num_canibals_rhs);
+		double speedup = single_thread_seconds / seconds;
+		printf("%7u %8zu %8u %8.3lf %11.0lf %8.2lf %10.1lf%%\n", num_threads, search.Nodes().size(), search.NumLevels(), seconds, search.NumExpanded() / seconds, speedup, speedup * 100.0 / num_threads);
+		LOGINFO("%u threads: %zu states expanded in %.3lf s, %.0lf per second", num_threads, search.NumExpanded(), seconds, search.NumExpanded() / seconds);
 	}
-	friend std::ostream& operator<<(std::ostream& output, RiverState state)
+}
+
+//how the solution is found, see --search
+enum SearchMethod
+{
+	EXHAUSTIVE,
+	ASTAR,
+	BIDIRECTIONAL
+};
+bool ParseSearchMethod(const std::string& name, SearchMethod* method)
+{
+	if (name == "bfs")
 	{
-		output << "<";
-		for (std::vector<bool>::iterator missionary = state.missionaries.begin(); missionary != state.missionaries.end(); ++missionary)
-		{
-			output << *missionary;
-			if (missionary + 1 != state.missionaries.end())
-			{
-				output << ",";
-			}
-		}
-		output << "><";
-		for (std::vector<bool>::iterator cannibal = state.cannibals.begin(); cannibal != state.cannibals.end(); ++cannibal)
-		{
-			output << *cannibal;
-			if (cannibal + 1 != state.cannibals.end())
-			{
-				output << ",";
-			}
-		}
-		output << "><" << state.boat_state << ">";
-		return output;
+		*method = EXHAUSTIVE;
+	} else if (name == "astar")
+	{
+		*method = ASTAR;
+	} else if (name == "bidirectional")
+	{
+		*method = BIDIRECTIONAL;
+	} else
+	{
+		return false;
 	}
+	return true;
+}
+
+//the configurations in the results directory
+const RiverConfig kResultsConfigs[] = {
+	{3, 3, 2}, {3, 3, 3}, {3, 4, 3}, {4, 3, 2}, {4, 3, 3}, {4, 4, 3}, {5, 4, 3}, {5, 5, 3}, {6, 5, 3}
 };
-//This function updates state by moving a number of people to the other side of
-//the river. Notice that state includes the position of the boat, so "move" is
-//not ambiguous
-RiverState MovePeople(RiverState state, size_t num_missionaries, size_t num_cannibals)
+
+/*
+  Runs search() on river_config repeatedly for at least kMinSeconds, so the
+  smallest configurations are timed over many runs, and prints one row of
+  the BenchmarkSearch table
+*/
+template<typename Search>
+void BenchmarkSearchMethod(const char* name, const RiverConfig& river_config, Search search)
 {
-	size_t index = 0;
-	while (num_missionaries > 0)
+	const double kMinSeconds = 0.2;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double seconds = 0.0;
+	uint32_t num_runs = 0;
+	river_search_result_t result;
+	do
 	{
-		LOGASSERT(index < state.missionaries.size(), "Attempted to move more missionaries than are available");
-		if (state.missionaries[index] == state.boat_state)
-		{
-			state.missionaries[index] = !state.missionaries[index];
-			num_missionaries--;
-		}
-		++index;
+		result = search();
+		num_runs++;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (seconds < kMinSeconds);
+	double microseconds = seconds * 1e6 / num_runs;
+	if (result.solved)
+	{
+		printf("%3u %3u %4u  %-14s %10zu %10zu %10zu %13.1lf\n", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity, name,
+			result.solution.size() - 1, result.num_expanded, result.num_reached, microseconds);
+	} else
+	{
+		printf("%3u %3u %4u  %-14s %10s %10zu %10zu %13.1lf\n", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity, name,
+			"none", result.num_expanded, result.num_reached, microseconds);
 	}
-	index = 0;
-	while (num_cannibals > 0)
+	LOGINFO("%u/%u/%u %s: %zu expanded, %zu reached, %.1lf us", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity, name,
+		result.num_expanded, result.num_reached, microseconds);
+}
+
+/*
+  Compares the number of states expanded and the time taken to find a
+  solution by exhausting the state space (what the diagram needs), by
+  breadth first search stopping at the goal, by A* and by bidirectional
+  breadth first search, for each of configs
+*/
+void BenchmarkSearch(const std::vector<RiverConfig>& configs)
+{
+	printf("  M   C seats  method          crossings   expanded    reached  microseconds\n");
+	for (std::vector<RiverConfig>::const_iterator config_it = configs.begin(); config_it != configs.end(); ++config_it)
 	{
-		LOGASSERT(index < state.cannibals.size(), "Attempted to move more cannibals than are available");
-		if (state.cannibals[index] == state.boat_state)
+		const RiverConfig& river_config = *config_it;
+		//the BFS variants are wrapped to report what the others do
+		auto run_bfs = [&](RiverBfs::Mode mode)
 		{
-			state.cannibals[index] = !state.cannibals[index];
-			num_cannibals--;
-		}
-		++index;
+			RiverBfs search(river_config);
+			river_search_result_t result;
+			result.solved = search.Run(mode);
+			result.solution = search.Solution();
+			result.num_expanded = search.NumExpanded();
+			result.num_reached = search.Nodes().size();
+			return result;
+		};
+		BenchmarkSearchMethod("exhaustive", river_config, [&]() { return run_bfs(RiverBfs::ENUMERATE); });
+		BenchmarkSearchMethod("bfs", river_config, [&]() { return run_bfs(RiverBfs::SOLVE); });
+		BenchmarkSearchMethod("astar", river_config, [&]() { return SolveAStar(river_config); });
+		BenchmarkSearchMethod("bidirectional", river_config, [&]() { return SolveBidirectional(river_config); });
 	}
-	state.boat_state = !state.boat_state;
-	return state;
 }
-//This function checks if the cannibals outnumber the missionaries on either
-//side of the river
-bool IsStateValid(RiverState state)
-{
-	size_t num_missionaries_origin = std::count(state.missionaries.begin(), state.missionaries.end(), false);
-	size_t num_canibals_origin = std::count(state.cannibals.begin(), state.cannibals.end(), false);
-	size_t num_missionaries_dest = std::count(state.missionaries.begin(), state.missionaries.end(), true);
-	size_t num_canibals_dest = std::count(state.cannibals.begin(), state.cannibals.end(), true);
 
-	bool result = true;
-	if (num_missionaries_origin > 0)
+//the most counts one list of --batch may expand to, so a typo like 1-4000000000 is an error instead of billions of entries
+const size_t kMaxCountListSize = 100000;
+//the most configurations one --batch may solve
+const uint64_t kMaxBatchConfigs = 10000000;
+
+//parses a list of counts and ranges such as "3,5,10-20" into counts, returns false if it isn't one, it has more than kMaxCountListSize counts
+//or a count is more than RiverState::kMaxPeople (the most people of either kind, and more seats than that are never used)
+bool ParseCountList(const std::string& list, std::vector<uint32_t>* counts)
+{
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
 	{
-		if (num_missionaries_origin < num_canibals_origin)
+		unsigned int first;
+		unsigned int last;
+		char dash;
+		std::stringstream item_stream(item);
+		if (!(item_stream >> first))
 		{
-			result = false;
+			return false;
 		}
-	}
-	if (num_missionaries_dest > 0)
-	{
-		if (num_missionaries_dest < num_canibals_dest)
+		last = first;
+		if (item_stream >> dash && (dash != '-' || !(item_stream >> last) || last < first))
+		{
+			return false;
+		}
+		if (last > RiverState::kMaxPeople)
+		{
+			LOGERROR("%s has a count above the limit of %u", list.c_str(), RiverState::kMaxPeople);
+			return false;
+		}
+		if ((uint64_t)last - first + 1 > kMaxCountListSize - counts->size())
+		{
+			LOGERROR("%s has more than %zu counts", list.c_str(), kMaxCountListSize);
+			return false;
+		}
+		//a 64 bit counter so a range ending at UINT_MAX still ends
+		for (uint64_t count = first; count <= last; ++count)
 		{
-			result = false;
+			counts->push_back((uint32_t)count);
 		}
 	}
-	return result;
+	return !counts->empty();
 }
-/*
-  This function generates a tree of all possible, non-cyclic, valid (i.e. meeting
-  the cannibal criteria) states.
-
-  Notice that it does not stop at the goal. This is just so that the complete
-  state tree can be printed at the end. It could easily be optimized to stop at
-  the goal.
 
-  The basic algorithm here is:
-  1. Start at the root
-  2. Generate every possible set of moves given:
-	* The number of people on the boat's side of the river
-	* The boat's capacity
-	* The cannibal criteria
-  3. For each valid state found, push it into the tree and into a queue
-	 (implemented as a vector because why not)
-  4. For each element in the queue, recursively call this function
-
-  Note that the function is recursive and doesn't implement any depth-checking.
-  It is conceivable that this could recurse forever, but it shouldn't (i.e. I
-  tested it)
+/*
+  Solves every one of configs with SolveBatch and writes one table of them
+  to output_filename: the configuration, whether it can be solved, and the
+  fewest crossings
 */
-void enumerateAllStates(ion::TreeNode<RiverState>& root, ion::TreeNode<RiverState>* node, RiverConfig river_config)
+void RunBatch(const std::vector<RiverConfig>& configs, const std::string& output_filename)
 {
-	RiverState state = node->GetData();
-	//get the number of cannibals/missionaries that could possibly be moved
-	//cap the number of movable people at river_config.boat_capacity
-	size_t num_missionaries_movable = min(river_config.boat_capacity,std::count(state.missionaries.begin(), state.missionaries.end(), state.boat_state));
-	size_t num_cannibals_movable = min(river_config.boat_capacity, std::count(state.cannibals.begin(), state.cannibals.end(), state.boat_state));
-	
-	//This vector stores all the nodes waiting to be expanded
-	std::vector<ion::TreeNode<RiverState>*> pending_nodes;
-
-	//Generate all of this node's children.
-	for (size_t num_missionaries_moved = 0; num_missionaries_moved <= num_missionaries_movable; ++num_missionaries_moved)
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t num_searches;
+	std::vector<batch_result_t> results = SolveBatch(configs, &num_searches);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	FILE* table = fopen(output_filename.c_str(), "w");
+	if (table == nullptr)
 	{
-		size_t max_cannibals_to_move;
-		max_cannibals_to_move = min(river_config.boat_capacity - num_missionaries_moved, num_cannibals_movable);
-		for (size_t num_cannibals_moved = 0; num_cannibals_moved <= max_cannibals_to_move; ++num_cannibals_moved)
-		{
-			//check if there is no one to drive the boat, if so skip this state
-			if (num_cannibals_moved == 0 && num_missionaries_moved == 0)
-			{
-				continue;
-			}
-			//Generate the transition from this state to the next
-			RiverState new_state = MovePeople(state, num_missionaries_moved, num_cannibals_moved);
-			//check if the new_state is valid (i.e. cannibals don't outnumber missionaries)
-			bool valid_state = IsStateValid(new_state);
-			if (!valid_state)
-			{
-				continue;
-			}
-			/*
-				Note that the conditions on getting to this point in the loop
-				guarantees that:
-				  * There are enough people to move
-				  * The boat will fit this many people
-				  * The state is valid
-				So we can just check if it is in the tree already and add it
-				
-				The next function checks if this state is already in the tree.
-
-				Note the GetPath function returns an empty vector if there is no
-				path to this state. So, we don't actually need the path, just
-				its length
-			*/
-			std::vector<ion::TreeNode<RiverState>*> path = root.GetPath(new_state);
-			if (path.empty())
-			{
-				//there is no path in the tree which leads to an equivalent state, which means this state is novel
-				node->AddLeaf(new_state);
-				//push all the children of that state
-				pending_nodes.push_back(node->GetLeaf(node->NumLeafs() - 1));
-				
-			}
-		}
+		LOGFATAL("Could not open %s", output_filename.c_str());
 	}
-	/*
-		The pending_nodes vector now contains all of the child nodes we pushed
-		in this function. Recursively calling this function on each node in
-		pending_nodes causes us to do a breadth-first search
-	*/
-	for (std::vector<ion::TreeNode<RiverState>*>::iterator node_it = pending_nodes.begin(); node_it != pending_nodes.end(); ++node_it)
+	size_t num_solvable = 0;
+	fprintf(table, "missionaries cannibals seats solvable crossings\n");
+	for (std::vector<batch_result_t>::const_iterator result_it = results.begin(); result_it != results.end(); ++result_it)
 	{
-		enumerateAllStates(root, *node_it, river_config);
+		const RiverConfig& river_config = result_it->river_config;
+		if (result_it->crossings == CrossingTable::kUnsolvable)
+		{
+			fprintf(table, "%12u %9u %5u %8s %9s\n", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity, "no", "-");
+		} else
+		{
+			fprintf(table, "%12u %9u %5u %8s %9u\n", river_config.num_missionaries, river_config.num_cannibals, river_config.boat_capacity, "yes", result_it->crossings);
+			num_solvable++;
+		}
 	}
+	fclose(table);
+	printf("%zu configurations (%zu solvable, %llu searched) in %.3lf s, %.0lf per second, written to %s\n", results.size(), num_solvable,
+		(unsigned long long)num_searches, seconds, results.size() / seconds, output_filename.c_str());
+	LOGINFO("Solved %zu configurations (%llu searched) in %.3lf s", results.size(), (unsigned long long)num_searches, seconds);
 }
+
 int main(int argc, char* argv[])
 {
 	/*
@@ -234,15 +242,142 @@ int main(int argc, char* argv[])
 	*/
 	ion::LogInit("cannibals.log");
 
+	//Usage: main.exe --bench-bfs num_missionaries num_cannibals boat_capacity [max_threads]
+	if (argc >= 2 && std::string(argv[1]) == "--bench-bfs")
+	{
+		if (argc < 5)
+		{
+			LOGFATAL("Usage: main.exe --bench-bfs num_missionaries num_cannibals boat_capacity [max_threads]");
+		}
+		RiverConfig river_config;
+		river_config.num_missionaries = (uint32_t)atoi(argv[2]);
+		river_config.num_cannibals = (uint32_t)atoi(argv[3]);
+		river_config.boat_capacity = (uint32_t)atoi(argv[4]);
+		uint32_t max_threads = argc >= 6 ? (uint32_t)atoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency());
+		BenchmarkBfs(river_config, max_threads);
+		return 0;
+	}
+	//Usage: main.exe --bench-search [num_missionaries num_cannibals boat_capacity]...
+	//without any configurations the ones in the results directory are used
+	if (argc >= 2 && std::string(argv[1]) == "--bench-search")
+	{
+		if ((argc - 2) % 3 != 0)
+		{
+			LOGFATAL("Usage: main.exe --bench-search [num_missionaries num_cannibals boat_capacity]...");
+		}
+		std::vector<RiverConfig> configs;
+		for (int arg = 2; arg + 2 < argc; arg += 3)
+		{
+			RiverConfig river_config;
+			river_config.num_missionaries = (uint32_t)atoi(argv[arg]);
+			river_config.num_cannibals = (uint32_t)atoi(argv[arg + 1]);
+			river_config.boat_capacity = (uint32_t)atoi(argv[arg + 2]);
+			configs.push_back(river_config);
+		}
+		if (configs.empty())
+		{
+			configs.assign(kResultsConfigs, kResultsConfigs + sizeof(kResultsConfigs) / sizeof(kResultsConfigs[0]));
+		}
+		BenchmarkSearch(configs);
+		return 0;
+	}
+	//Usage: main.exe --batch missionaries cannibals seats [output_file]
+	//each of missionaries, cannibals and seats is a list of counts and ranges, e.g. 1-50 or 2,3,5-8, and every combination is solved
+	if (argc >= 2 && std::string(argv[1]) == "--batch")
+	{
+		std::vector<uint32_t> missionary_counts;
+		std::vector<uint32_t> cannibal_counts;
+		std::vector<uint32_t> seat_counts;
+		if (argc < 5 || !ParseCountList(argv[2], &missionary_counts) || !ParseCountList(argv[3], &cannibal_counts) || !ParseCountList(argv[4], &seat_counts))
+		{
+			LOGFATAL("Usage: main.exe --batch missionaries cannibals seats [output_file], e.g. --batch 1-50 1-50 2,3,4");
+		}
+		uint64_t num_configs = (uint64_t)missionary_counts.size() * cannibal_counts.size() * seat_counts.size();
+		if (num_configs > kMaxBatchConfigs)
+		{
+			LOGFATAL("--batch would solve %llu configurations, more than the limit of %llu", (unsigned long long)num_configs, (unsigned long long)kMaxBatchConfigs);
+		}
+		std::vector<RiverConfig> configs;
+		for (std::vector<uint32_t>::const_iterator missionaries_it = missionary_counts.begin(); missionaries_it != missionary_counts.end(); ++missionaries_it)
+		{
+			for (std::vector<uint32_t>::const_iterator cannibals_it = cannibal_counts.begin(); cannibals_it != cannibal_counts.end(); ++cannibals_it)
+			{
+				for (std::vector<uint32_t>::const_iterator seats_it = seat_counts.begin(); seats_it != seat_counts.end(); ++seats_it)
+				{
+					RiverConfig river_config = {*missionaries_it, *cannibals_it, *seats_it};
+					configs.push_back(river_config);
+				}
+			}
+		}
+		RunBatch(configs, argc >= 6 ? argv[5] : "batch.txt");
+		return 0;
+	}
+	//Usage: main.exe --batch-list config_file [output_file]
+	//config_file has one "missionaries cannibals seats" per line
+	if (argc >= 2 && std::string(argv[1]) == "--batch-list")
+	{
+		if (argc < 3)
+		{
+			LOGFATAL("Usage: main.exe --batch-list config_file [output_file]");
+		}
+		std::ifstream config_file(argv[2]);
+		if (!config_file.is_open())
+		{
+			LOGFATAL("Could not open %s", argv[2]);
+		}
+		std::vector<RiverConfig> configs;
+		RiverConfig river_config;
+		while (config_file >> river_config.num_missionaries >> river_config.num_cannibals >> river_config.boat_capacity)
+		{
+			if (river_config.num_missionaries > RiverState::kMaxPeople || river_config.num_cannibals > RiverState::kMaxPeople)
+			{
+				LOGFATAL("%u missionaries and %u cannibals in %s is more than the limit of %u of each", river_config.num_missionaries, river_config.num_cannibals, argv[2], RiverState::kMaxPeople);
+			}
+			configs.push_back(river_config);
+		}
+		RunBatch(configs, argc >= 4 ? argv[3] : "batch.txt");
+		return 0;
+	}
 	if (argc < 4)
 	{
-		LOGFATAL("Usage: main.exe num_missionaries num_cannibals boat_capacity");
+		LOGFATAL("Usage: main.exe num_missionaries num_cannibals boat_capacity [--solve-only] [--threads n] [--search bfs|astar|bidirectional] [--state-graph]");
 	}
 	//get the number of missionaries, cannibals, and boat capacity
 	RiverConfig river_config;
 	river_config.num_missionaries = (uint32_t)atoi(argv[1]);
 	river_config.num_cannibals = (uint32_t)atoi(argv[2]);
 	river_config.boat_capacity = (uint32_t)atoi(argv[3]);
+	//--solve-only stops at the goal instead of enumerating the whole state space, and so doesn't write the diagram
+	bool solve_only = false;
+	//--threads n expands the large BFS levels on n threads, 0 means one per hardware thread
+	uint32_t num_threads = 1;
+	//--search astar|bidirectional looks for the solution without the breadth first search, and so is solve only too
+	SearchMethod search_method = EXHAUSTIVE;
+	//--state-graph draws every boat trip between the states rather than just the tree of the first way each state was reached
+	StateGraphWriter::Edges diagram_edges = StateGraphWriter::SPANNING_TREE;
+	for (int arg = 4; arg < argc; ++arg)
+	{
+		std::string option(argv[arg]);
+		if (option == "--solve-only")
+		{
+			solve_only = true;
+		} else if (option == "--threads" && arg + 1 < argc)
+		{
+			num_threads = (uint32_t)atoi(argv[++arg]);
+		} else if (option == "--state-graph")
+		{
+			diagram_edges = StateGraphWriter::ALL_TRANSITIONS;
+		} else if (option == "--search" && arg + 1 < argc)
+		{
+			if (!ParseSearchMethod(argv[++arg], &search_method))
+			{
+				LOGFATAL("Unknown search method %s, expected bfs, astar or bidirectional", argv[arg]);
+			}
+		} else
+		{
+			LOGFATAL("Unknown option %s", option.c_str());
+		}
+	}
 
 	//open a file to write the results to
 	std::ofstream fout;
@@ -251,67 +386,58 @@ int main(int argc, char* argv[])
 	fout.open(result_filename.str());
 	fout << result_filename.str() << std::endl;
 
-	//Setup the problem with the requested number of actors
-	//Note the convention for true/false is the answer the question
-	//	"Is the item on the correct side of the river?"
-	RiverState initial_state;
-	initial_state.boat_state = false;
-	initial_state.cannibals.resize(river_config.num_cannibals, false);
-	initial_state.missionaries.resize(river_config.num_missionaries, false);
-
-	//Create the head of the tree
-	ion::TreeNode<RiverState> tree(initial_state,nullptr);
-
 	/*
-		This function generates a tree of the entire valid state space without
-		cycles.
+		The search finds every valid state reachable from the initial state
+		(unless solve_only), each one once, along with the state it was first
+		reached from, which makes a tree of the entire valid state space
+		without cycles. With --state-graph the diagram has every boat trip
+		between the states instead, cycles included.
 
-		Thus it does not care when it reaches the goal node, it just exhaustively
-		searches the space.
-
-		Of course this could be optimized to stop as soon as it reaches the goal,
-		but for the purpose of fulfilling question one of the assignment ("Draw a
+		For the purpose of fulfilling question one of the assignment ("Draw a
 		diagram of the complete state space") it is necessary to search to
-		exhaustion
-	*/
-	enumerateAllStates(tree, &tree, river_config);
-	
-	//This prints the complete map of the valid state space.
-	std::ofstream file;
-	std::stringstream map_filename;
-	map_filename << river_config.num_missionaries << "missionaries_" << river_config.num_cannibals << "cannibals_" << river_config.boat_capacity << "seats.gv";
-	file.open(map_filename.str());
-	tree.print(file);
-	file.close();
-
-	//Generate the goal node so we can search for it
-	RiverState goal_state;
-	goal_state.boat_state = true;
-	goal_state.cannibals.resize(river_config.num_cannibals, true);
-	goal_state.missionaries.resize(river_config.num_missionaries, true);
-
-	/*
-		This function finds the goal node in the tree. Note that it doesn't
-		actually matter which way I search I the graph here because it has
-		already been generated without cycles, that is, the goal node is unique
-		in the already-built graph.
+		exhaustion, but since it is breadth first the goal is found by the
+		shortest crossing either way.
 	*/
-
-	ion::TreeNode<RiverState>::iterator it(ion::BREADTH_FIRST);
-	it.init(&tree);
-	while (!it.complete())
+	std::vector<RiverState> path;
+	bool solved = false;
+	if (search_method == EXHAUSTIVE)
 	{
-		if ((*it)->GetData() == goal_state)
+		RiverBfs search(river_config);
+		search.SetNumThreads(num_threads);
+		if (solve_only)
 		{
-			//We have found the goal node, just quit this loop so we can go
-			//print the transitions. Note that it maintains its postion
-			break;
+			search.Run(RiverBfs::SOLVE);
+		} else
+		{
+			//This prints the complete map of the valid state space, streamed out a level at a time as the search finds it
+			std::stringstream map_filename;
+			map_filename << river_config.num_missionaries << "missionaries_" << river_config.num_cannibals << "cannibals_" << river_config.boat_capacity << "seats.gv";
+			StateGraphWriter diagram(river_config, diagram_edges);
+			if (!diagram.Open(map_filename.str()))
+			{
+				LOGFATAL("Could not open %s", map_filename.str().c_str());
+			}
+			search.Run(RiverBfs::ENUMERATE, [&](size_t level_begin, size_t level_end)
+			{
+				diagram.WriteLevel(search, level_begin, level_end);
+			});
+			diagram.Close();
 		}
-		++it;
+		LOGINFO("Found %zu states in %u levels, expanded %zu", search.Nodes().size(), search.NumLevels(), search.NumExpanded());
+		solved = search.Solved();
+		path = search.Solution();
+	} else
+	{
+		//A* and bidirectional search never build the tree, and usually expand a small part of the state space
+		river_search_result_t result = search_method == ASTAR ? SolveAStar(river_config) : SolveBidirectional(river_config);
+		LOGINFO("Reached %zu states, expanded %zu", result.num_reached, result.num_expanded);
+		solved = result.solved;
+		path.swap(result.solution);
 	}
-	if (it.complete())
+
+	if (!solved)
 	{
-		//this means we traversed the entire tree and didn't find the goal. Either
+		//this means we searched the entire space and didn't find the goal. Either
 		//there is a bug, or the problem isn't possible (for example the
 		//cannibals outnumber the missionaries). Just let the user know.
 		fout << "There was no solution to this problem";
@@ -320,19 +446,13 @@ int main(int argc, char* argv[])
 	} else
 	{
 		fout << "Format: <missionaries><cannibals><boat> where 0=origin, 1=destination" << std::endl;
-		//print the path to the goal
-		//Note that this function actually searches for the path again. I did
-		//it this way so that I could show how the tree is traversed above, but
-		//for convenience I just use my path function to get the real path
-		std::vector<ion::TreeNode<RiverState>*> path = tree.GetPath(goal_state);
-		
-		//The path is returned in order from the goal to the root, so traverse it backwards to print it in the logical order
-		for (std::vector<ion::TreeNode<RiverState>*>::reverse_iterator node_it = path.rbegin(); node_it != path.rend(); ++node_it)
+		//print the path to the goal, from the initial state
+		for (std::vector<RiverState>::iterator state_it = path.begin(); state_it != path.end(); ++state_it)
 		{
-			fout << (*node_it)->GetData() << std::endl;
+			fout << *state_it << std::endl;
 		}
 	}
 
 	fout.close();
 	return 0;
-}
\ No newline at end of file
+}
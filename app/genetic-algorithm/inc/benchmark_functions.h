@@ -0,0 +1,256 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_BENCHMARK_FUNCTIONS_H_
+#define CS776_BENCHMARK_FUNCTIONS_H_
+#include "random.h"
+#include "simd.h"
+#include <cstdint>
+#include <cstddef>
+
+/*
+The benchmark functions minimized by GABenchmark. Each one is a struct
+of compile time constants and static functions:
+  * kNumDimensions, kFieldLength: the chromosome is kNumDimensions sign and
+    magnitude fields of kFieldLength bits each
+  * kDivisor: a field decodes to its integer value divided by kDivisor, so
+    x is in +-(2^(kFieldLength - 1) - 1) / kDivisor
+  * Evaluate(x): the function at x[0, kNumDimensions). It is a template on
+    the number type so EvaluateBatch can run it on 4 members at once
+  * Worst(), Best(worst): the range of the function, a member's fitness is
+    (worst - f(x)) / (worst - best), which is in [0, 1]
+  * kNoiseDeviation: the standard deviation of the Gaussian noise added to
+    every value, 0 for the deterministic functions (all but DeJong4)
+
+Adding a function only takes the struct, a typedef of GABenchmark and an
+entry in main's --function list.
+*/
+struct BenchmarkFunction
+{
+	static constexpr double kNoiseDeviation = 0.0;
+	static double Best(double /*worst*/)
+	{
+		return 0.0;
+	}
+};
+
+//f at the point where every dimension is value
+template<typename Function>
+double EvaluateAt(double value)
+{
+	double x[Function::kNumDimensions];
+	for (uint32_t dim = 0; dim < Function::kNumDimensions; ++dim)
+	{
+		x[dim] = value;
+	}
+	return Function::Evaluate(x);
+}
+
+//sphere
+struct DeJong1 : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 3;
+	static const uint32_t kFieldLength = 10;
+	static constexpr double kDivisor = 100.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		return x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+	}
+	static double Worst()
+	{
+		return EvaluateAt<DeJong1>(-5.12);
+	}
+};
+
+//Rosenbrock's saddle
+struct DeJong2 : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 2;
+	static const uint32_t kFieldLength = 12;
+	static constexpr double kDivisor = 1000.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		return 100.0 * simd::Square(x[0] * x[0] - x[1]) + simd::Square(1.0 - x[0]);
+	}
+	static double Worst()
+	{
+		return EvaluateAt<DeJong2>(-2.048);
+	}
+};
+
+//step
+struct DeJong3 : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 5;
+	static const uint32_t kFieldLength = 10;
+	static constexpr double kDivisor = 100.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		return simd::Trunc(x[0]) + simd::Trunc(x[1]) + simd::Trunc(x[2]) + simd::Trunc(x[3]) + simd::Trunc(x[4]);
+	}
+	static double Worst()
+	{
+		return EvaluateAt<DeJong3>(5.12);
+	}
+	static double Best(double worst)
+	{
+		return -worst;
+	}
+};
+
+/*
+quartic with Gaussian noise. The function adds a standard normal per
+dimension, but only their sum is ever seen, and the sum of 30 independent
+standard normals is exactly a normal with standard deviation sqrt(30), so
+that is drawn instead: one number per member rather than 30.
+*/
+struct DeJong4 : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 30;
+	static const uint32_t kFieldLength = 8;
+	static constexpr double kDivisor = 100.0;
+	//sqrt(kNumDimensions)
+	static constexpr double kNoiseDeviation = 5.477225575051661;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		Real result = 0.0;
+		for (uint32_t i = 0; i < kNumDimensions; ++i)
+		{
+			result += (double)i * simd::Square(simd::Square(x[i]));
+		}
+		return result;
+	}
+	//note that we can't actually define a worst X for this function since it is random, however it is extremely unlikey we would exceed this value
+	static double Worst()
+	{
+		double noise;
+		rng::FillNormal(&noise, 1, 0.0, kNoiseDeviation);
+		return EvaluateAt<DeJong4>(1.28) + noise;
+	}
+	static double Best(double worst)
+	{
+		return -worst;
+	}
+};
+
+//the largest value of 10 + x^2 - 10cos(2 pi x) on [-5.12, 5.12] is 40.3533 at x = +-4.5230
+struct Rastrigin : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 10;
+	static const uint32_t kFieldLength = 10;
+	static constexpr double kDivisor = 100.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		Real result = 10.0 * kNumDimensions;
+		for (uint32_t i = 0; i < kNumDimensions; ++i)
+		{
+			result += x[i] * x[i] - 10.0 * simd::Cos(6.283185307179586 * x[i]);
+		}
+		return result;
+	}
+	static double Worst()
+	{
+		return 40.3534 * kNumDimensions;
+	}
+};
+
+//the largest value of 418.9829 - x sin(sqrt(|x|)) on [-500, 500] is 837.9658 at x = -420.9687
+struct Schwefel : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 10;
+	static const uint32_t kFieldLength = 10;
+	//x in [-500, 500]
+	static constexpr double kDivisor = 511.0 / 500.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		Real result = 418.9829 * kNumDimensions;
+		for (uint32_t i = 0; i < kNumDimensions; ++i)
+		{
+			result -= x[i] * simd::Sin(simd::Sqrt(simd::Abs(x[i])));
+		}
+		return result;
+	}
+	static double Worst()
+	{
+		return 837.9659 * kNumDimensions;
+	}
+};
+
+//the sum is at most 600^2 / 4000 = 90 per dimension and the product at least -1
+struct Griewank : BenchmarkFunction
+{
+	static const uint32_t kNumDimensions = 10;
+	static const uint32_t kFieldLength = 11;
+	//x in [-600, 600]
+	static constexpr double kDivisor = 1023.0 / 600.0;
+	template<typename Real>
+	static Real Evaluate(const Real* x)
+	{
+		Real sum = 0.0;
+		Real product = 1.0;
+		for (uint32_t i = 0; i < kNumDimensions; ++i)
+		{
+			sum += x[i] * x[i] * (1.0 / 4000.0);
+			product *= simd::Cos(x[i] * (1.0 / std::sqrt(i + 1.0)));
+		}
+		return 1.0 + sum - product;
+	}
+	static double Worst()
+	{
+		return 2.0 + 90.0 * kNumDimensions;
+	}
+};
+
+/*
+  Evaluates Function for count members whose decoded values are stored
+  structure of arrays: dimension dim of member is x[dim * stride + member].
+  With AVX2 four members go through Evaluate at once, each dimension being
+  one load of four consecutive values; the remainder (and everything
+  without AVX2) is evaluated one member at a time.
+*/
+template<typename Function>
+void EvaluateBatch(const double* x, size_t stride, size_t count, double* raw)
+{
+	size_t member = 0;
+#ifdef CS776_HAVE_AVX2
+	for (; member + simd::Vec4d::kWidth <= count; member += simd::Vec4d::kWidth)
+	{
+		simd::Vec4d lanes[Function::kNumDimensions];
+		for (uint32_t dim = 0; dim < Function::kNumDimensions; ++dim)
+		{
+			lanes[dim] = simd::Vec4d::Load(x + dim * stride + member);
+		}
+		Function::Evaluate(lanes).Store(raw + member);
+	}
+#endif
+	for (; member < count; ++member)
+	{
+		double values[Function::kNumDimensions];
+		for (uint32_t dim = 0; dim < Function::kNumDimensions; ++dim)
+		{
+			values[dim] = x[dim * stride + member];
+		}
+		raw[member] = Function::Evaluate(values);
+	}
+}
+#endif //CS776_BENCHMARK_FUNCTIONS_H_
@@ -1,309 +1,784 @@
 #include "ionlib\log.h"
 #include "ionlib\net.h"
 #include "ionlib\genetic_algorithm.h"
+#include "selection.h"
+#include "command_line.h"
+#include "random.h"
+#include "trial_runner.h"
+#include "statistics_writer.h"
+#include "flat_population.h"
+#include "bit_chromosome.h"
+#include "fitness_cache.h"
+#include "benchmark_functions.h"
+#include "sweep.h"
+//the CheckAllocations configuration defines COUNT_ALLOCATIONS, which counts every heap allocation for --check-allocations
+#include "allocation_counter.h"
 #include <fstream>
-#include <bitset>
 #include <sstream>
+#include <time.h>
+#include <chrono>
 
-int32_t signed_vector_to_int(std::vector<bool>::iterator first, std::vector<bool>::iterator end)
+//the crossover operators BitStringGA can apply to each pair of children
+enum BitCrossover
 {
-	LOGASSERT(end - first <= 32);
-	uint32_t result = 0;
-	for (std::vector<bool>::iterator it = first; it < end-1; ++it)
+	ONE_POINT,
+	TWO_POINT,
+	UNIFORM
+};
+
+bool ParseBitCrossover(const std::string& name, BitCrossover* crossover)
+{
+	if (name == "one-point")
 	{
-		if (*it)
-		{
-			uint32_t offset = (uint32_t)(it - first);
-			result |= 1 << offset;
-		}
+		*crossover = ONE_POINT;
+	} else if (name == "two-point")
+	{
+		*crossover = TWO_POINT;
+	} else if (name == "uniform")
+	{
+		*crossover = UNIFORM;
+	} else
+	{
+		return false;
 	}
-	int32_t sign = (*(end-1)) ? -1 : 1;
-	return sign * (int32_t)result;
+	return true;
 }
-class GANumOnes : public ion::GeneticAlgorithm<std::vector<bool>>
+
+/*
+BitStringGA is the common base of the bit string GAs below. It replaces the
+library's selection (which walks the fitness CDF for every child) with a
+ParentSelector so the selection method can be chosen at runtime, and
+crosses over each pair of children with the chosen BitCrossover operator.
+
+All of its random numbers come from the calling thread's rng stream rather
+than rand(), so trials can run on several threads and still be reproduced
+from their seed.
+
+The members are kNumBits long BitChromosomes, 64 genes to a word, stored in
+a FlatPopulation rather than in the library's population_, so the whole
+population and the next generation are in one buffer, a generation doesn't
+allocate and mutation, crossover and decoding work on whole words.
+*/
+template<size_t kNumBits>
+class BitStringGA : public ion::GeneticAlgorithm<std::vector<bool>>
 {
 public:
-	GANumOnes() = delete;
-	GANumOnes(size_t num_members, size_t chromosome_length, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, chromosome_length, mutation_probability, crossover_probability)
+	typedef BitChromosome<kNumBits> Chromosome;
+	BitStringGA(size_t num_members, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, kNumBits, mutation_probability, crossover_probability)
 	{
-		EvaluateMembers();
+		//the library initialized its members with rand(), draw ours from this thread's stream instead
+		genes_.Resize(num_members, 1);
+		for (size_t member_index = 0; member_index < genes_.NumMembers(); ++member_index)
+		{
+			Member(member_index).Randomize();
+		}
+		//only the size of the library's population is kept
+		population_.assign(num_members, std::vector<bool>());
+		crossover_ = ONE_POINT;
 	}
-	virtual void EvaluateMembers()
+	virtual void Mutate()
 	{
-		for (std::vector<std::vector<bool>>::iterator member_it = this->population_.begin(); member_it != this->population_.end(); ++member_it)
+		//the genes of every member but the first (we are doing elite selection) are numbered consecutively, and
+		//instead of drawing a number for every gene to decide if it flips we skip straight to the next one which does.
+		//the flips which land in the same word are collected into one mask and applied together
+		uint64_t num_genes = (uint64_t)(genes_.NumMembers() - 1) * kNumBits;
+		rng::SkipSampler skip(mutation_probability_);
+		uint64_t gene_index = skip.Next();
+		while (gene_index < num_genes)
 		{
-			double fitness = 0.0;
-			for (std::vector<bool>::iterator gene_it = member_it->begin(); gene_it != member_it->end(); ++gene_it)
+			size_t member_index = 1 + (size_t)(gene_index / kNumBits);
+			size_t word = (size_t)(gene_index % kNumBits) / 64;
+			//the first gene of the word after this one
+			uint64_t word_end = (member_index - 1) * (uint64_t)kNumBits + std::min<uint64_t>((word + 1) * 64, kNumBits);
+			uint64_t mask = 0;
+			do
 			{
-				if (*gene_it)
+				mask |= 1ull << ((gene_index % kNumBits) % 64);
+				gene_index = skip.Advance(gene_index, num_genes);
+			} while (gene_index < word_end);
+			if (cache_.Enabled())
+			{
+				uint64_t value = Member(member_index).Word(word);
+				hashes_[member_index] ^= Chromosome::WordHash(word, value) ^ Chromosome::WordHash(word, value ^ mask);
+			}
+			Member(member_index).FlipMask(word, mask);
+		}
+	}
+	//hides the library's version since the members aren't in population_
+	std::vector<bool> GetEliteMember()
+	{
+		const Chromosome& elite = Member(std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin());
+		std::vector<bool> genes(kNumBits);
+		for (size_t gene_index = 0; gene_index < kNumBits; ++gene_index)
+		{
+			genes[gene_index] = elite.Get(gene_index);
+		}
+		return genes;
+	}
+	void SetSelectionMethod(ParentSelector::Method method, uint32_t tournament_size)
+	{
+		selector_.SetMethod(method, tournament_size);
+	}
+	void SetCrossover(BitCrossover crossover)
+	{
+		crossover_ = crossover;
+	}
+	/*
+	  Memoizes the members' fitness in a cache of capacity entries keyed by
+	  their chromosome's hash, for the derived classes whose EvaluateMembers
+	  uses it. The hashes follow the members through Select and are updated
+	  word by word in Mutate, so only crossover children are rehashed.
+	*/
+	void EnableFitnessCache(size_t capacity)
+	{
+		cache_.Resize(capacity);
+		hashes_.resize(genes_.NumMembers());
+		offspring_hashes_.resize(genes_.NumMembers());
+		for (size_t member_index = 0; member_index < genes_.NumMembers(); ++member_index)
+		{
+			hashes_[member_index] = Member(member_index).Hash();
+		}
+	}
+	const FitnessCache& GetFitnessCache() const
+	{
+		return cache_;
+	}
+	virtual void Select()
+	{
+		//note that the fitnesses must already be set
+		//pick all of the parents up front, the elite member takes the first slot so we need one fewer
+		selector_.Prepare(fitness_);
+		selector_.Select(genes_.NumMembers() - 1, parents_);
+		//the next generation is built in the offspring half of genes_
+		//since we are using elite selection, copy the elite member
+		CopyMember(std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin(), 0);
+		for (uint32_t member_index = 1; member_index < genes_.NumMembers(); ++member_index)
+		{
+			CopyMember(parents_[member_index - 1], member_index);
+			//children are paired up as (1,2), (3,4), ... so the elite member is never crossed over
+			if (member_index % 2 == 0)
+			{
+				double random_number = rng::randlf(0.0, 1.0);
+				if (random_number < crossover_probability_)
 				{
-					fitness += 1.0 / member_it->size();
+					Crossover(genes_.Offspring(member_index)[0], genes_.Offspring(member_index - 1)[0]);
+					if (cache_.Enabled())
+					{
+						offspring_hashes_[member_index] = genes_.Offspring(member_index)[0].Hash();
+						offspring_hashes_[member_index - 1] = genes_.Offspring(member_index - 1)[0].Hash();
+					}
 				}
 			}
-			this->fitness_[member_it - this->population_.begin()] = fitness;
-			this->num_evaluations_++;
+		}
+		genes_.SwapGenerations();
+		hashes_.swap(offspring_hashes_);
+	}
+protected:
+	inline Chromosome& Member(size_t member_index)
+	{
+		return genes_.Member(member_index)[0];
+	}
+	//copies member from of the current generation into slot to of the next generation
+	inline void CopyMember(size_t from, size_t to)
+	{
+		genes_.CopyToOffspring(from, to);
+		if (cache_.Enabled())
+		{
+			offspring_hashes_[to] = hashes_[from];
 		}
 	}
+	void Crossover(Chromosome& mate1, Chromosome& mate2)
+	{
+		switch (crossover_)
+		{
+		case ONE_POINT:
+		{
+			//select a point to start the crossover at
+			size_t crossover_location = (size_t)rng::randull(0, kNumBits - 1);
+			Chromosome::OnePointCrossover(mate1, mate2, crossover_location);
+			break;
+		}
+		case TWO_POINT:
+		{
+			size_t first = (size_t)rng::randull(0, kNumBits - 1);
+			size_t last = (size_t)rng::randull(0, kNumBits - 1);
+			if (first > last)
+			{
+				std::swap(first, last);
+			}
+			Chromosome::TwoPointCrossover(mate1, mate2, first, last);
+			break;
+		}
+		case UNIFORM:
+			Chromosome::UniformCrossover(mate1, mate2);
+			break;
+		}
+	}
+	//decodes kNumFields consecutive sign and magnitude fields of kFieldLength bits each, divided by divisor
+	template<uint32_t kNumFields, uint32_t kFieldLength>
+	static void DecodeFields(const Chromosome& member, double divisor, double x[kNumFields])
+	{
+		static_assert(kNumFields * kFieldLength <= kNumBits, "the fields must fit in the chromosome");
+		for (uint32_t dim = 0; dim < kNumFields; ++dim)
+		{
+			x[dim] = (double)member.SignedField(dim * kFieldLength, kFieldLength) / divisor;
+		}
+	}
+	//one chromosome per member, so every member starts on its own cache line
+	FlatPopulation<Chromosome> genes_;
+	ParentSelector selector_;
+	std::vector<uint32_t> parents_;
+	BitCrossover crossover_;
+	//see EnableFitnessCache, hashes_[m] is the hash of member m while the cache is enabled
+	FitnessCache cache_;
+	std::vector<uint64_t> hashes_;
+	std::vector<uint64_t> offspring_hashes_;
 };
 
-double dejong1(double x[3])
-{
-	return x[0]*x[0] + x[1]*x[1] + x[2]*x[2];
-}
-
-class GADejong1 : public ion::GeneticAlgorithm<std::vector<bool>>
+template<size_t kNumBits>
+class GANumOnes : public BitStringGA<kNumBits>
 {
 public:
-	GADejong1() = delete;
-	GADejong1(size_t num_members, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, num_chromosomes_*chromosome_length_, mutation_probability, crossover_probability)
+	GANumOnes() = delete;
+	GANumOnes(size_t num_members, double mutation_probability, double crossover_probability) : BitStringGA<kNumBits>(num_members, mutation_probability, crossover_probability)
 	{
-		double worst_x[3];
-		worst_x[0] = worst_x[1] = worst_x[2] = -5.12;
-		worst_fitness_ = dejong1(worst_x);
 		EvaluateMembers();
 	}
 	virtual void EvaluateMembers()
 	{
-		for (std::vector<std::vector<bool>>::iterator member_it = this->population_.begin(); member_it != this->population_.end(); ++member_it)
+		for (size_t member_index = 0; member_index < this->genes_.NumMembers(); ++member_index)
 		{
+			this->fitness_[member_index] = (double)this->Member(member_index).Count() / kNumBits;
 			this->num_evaluations_++;
-			//convert to a value in range
-			double x[num_chromosomes_];
-			to_val(*member_it, x);
-			//evaluate
-			double raw_fitness = dejong1(x);
-			//scale to [0.0,1.0]
-			double fitness = (worst_fitness_ - raw_fitness) / worst_fitness_;
-			LOGASSERT(fitness <= 1.0 && fitness >= 0.0);
-			this->fitness_[member_it - population_.begin()] = fitness;
-		}
-	}
-	static const uint32_t num_chromosomes_ = 3;
-	static const uint32_t chromosome_length_ = 10;
-	double worst_fitness_;
-	void to_val(std::vector<bool> member, double x[num_chromosomes_])
-	{
-		for (uint32_t dim = 0; dim < num_chromosomes_; ++dim)
-		{
-			int32_t member_offset = signed_vector_to_int(member.begin() + dim*chromosome_length_, member.begin() + (dim + 1)*chromosome_length_);
-			x[dim] = (double)member_offset / 100.0;
 		}
 	}
 };
-double dejong2(double x[2])
-{
-	return 100 * pow(x[0]*x[0] - x[1], 2.0) + pow(1 - x[0], 2.0);
-}
 
-class GADejong2 : public ion::GeneticAlgorithm<std::vector<bool>>
+/*
+GABenchmark minimizes one of the benchmark functions in
+benchmark_functions.h. Every generation the whole population is decoded
+into a structure of arrays (dimension dim of member m is
+x_[dim * stride_ + m]) and evaluated in one EvaluateBatch pass, which
+evaluates four members at a time where AVX2 is available. A noisy
+function's noise is drawn for the whole generation at once.
+*/
+template<typename Function>
+class GABenchmark : public BitStringGA<Function::kNumDimensions * Function::kFieldLength>
 {
 public:
-	GADejong2() = delete;
-	GADejong2(size_t num_members, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, num_chromosomes_*chromosome_length_, mutation_probability, crossover_probability)
+	typedef BitStringGA<Function::kNumDimensions * Function::kFieldLength> Base;
+	GABenchmark() = delete;
+	GABenchmark(size_t num_members, double mutation_probability, double crossover_probability) : Base(num_members, mutation_probability, crossover_probability)
 	{
-		double worst_x[2];
-		worst_x[0] = worst_x[1] = -2.048;
-		worst_fitness_ = dejong2(worst_x);
+		//each row is padded to a multiple of the vector width
+		stride_ = (num_members + 3) & ~(size_t)3;
+		x_.resize(stride_ * Function::kNumDimensions);
+		raw_.resize(num_members);
+		if (Function::kNoiseDeviation > 0.0)
+		{
+			noise_.resize(num_members);
+		}
+		//where the members which missed the fitness cache are gathered to be decoded together
+		misses_.reserve(num_members);
+		miss_genes_.resize(num_members);
+		miss_raw_.resize(num_members);
+		worst_fitness_ = Function::Worst();
+		best_fitness_ = Function::Best(worst_fitness_);
 		EvaluateMembers();
 	}
 	virtual void EvaluateMembers()
 	{
-		for (std::vector<std::vector<bool>>::iterator member_it = this->population_.begin(); member_it != this->population_.end(); ++member_it)
+		size_t num_members = this->genes_.NumMembers();
+		size_t num_evaluated;
+		if (this->cache_.Enabled())
+		{
+			num_evaluated = EvaluateMisses();
+		} else
+		{
+			Evaluate(&this->Member(0), this->genes_.Stride(), num_members, raw_.data());
+			num_evaluated = num_members;
+		}
+		if (Function::kNoiseDeviation > 0.0)
+		{
+			//the whole generation's noise in one pass of the ziggurat
+			rng::FillNormal(noise_.data(), num_members, 0.0, Function::kNoiseDeviation);
+			for (size_t member_index = 0; member_index < num_members; ++member_index)
+			{
+				raw_[member_index] += noise_[member_index];
+			}
+		}
+		for (size_t member_index = 0; member_index < num_members; ++member_index)
 		{
-			this->num_evaluations_++;
-			//convert to a value in range
-			double x[num_chromosomes_];
-			to_val(*member_it, x);
-			//evaluate
-			double raw_fitness = dejong2(x);
 			//scale to [0.0,1.0]
-			double fitness = (worst_fitness_ - raw_fitness) / worst_fitness_;
+			double fitness = (worst_fitness_ - raw_[member_index]) / (worst_fitness_ - best_fitness_);
 			LOGASSERT(fitness <= 1.0 && fitness >= 0.0);
-			this->fitness_[member_it - population_.begin()] = fitness;
+			this->fitness_[member_index] = fitness;
 		}
+		this->num_evaluations_ += (decltype(this->num_evaluations_))num_evaluated;
 	}
-	static const uint32_t num_chromosomes_ = 2;
-	static const uint32_t chromosome_length_ = 12;
-	double worst_fitness_;
-	void to_val(std::vector<bool> member, double x[num_chromosomes_])
+private:
+	//the raw function values of count chromosomes stride apart
+	void Evaluate(const typename Base::Chromosome* first, size_t stride, size_t count, double* raw)
 	{
-		for (uint32_t dim = 0; dim < num_chromosomes_; ++dim)
+		//convert to a value in range, a dimension at a time so the field's position is worked out once per generation
+		for (uint32_t dim = 0; dim < Function::kNumDimensions; ++dim)
 		{
-			int32_t member_offset = signed_vector_to_int(member.begin() + dim*chromosome_length_, member.begin() + (dim + 1)*chromosome_length_);
-			x[dim] = (double)member_offset / 1000.0;
+			typename Base::Chromosome::FieldLocation location = Base::Chromosome::Locate(dim * Function::kFieldLength, Function::kFieldLength);
+			Base::Chromosome::DecodeSignedField(first, stride, count, location, kScale, &x_[dim * stride_]);
 		}
+		EvaluateBatch<Function>(x_.data(), stride_, count, raw);
 	}
+	/*
+	  Fills raw_ from the fitness cache, then evaluates the members which
+	  weren't in it as one batch and caches them. The cache holds the value
+	  before noise, so a noisy function still gets fresh noise on every
+	  evaluation. Returns the number of members evaluated.
+	*/
+	size_t EvaluateMisses()
+	{
+		misses_.clear();
+		for (size_t member_index = 0; member_index < this->genes_.NumMembers(); ++member_index)
+		{
+			if (!this->cache_.Find(this->hashes_[member_index], &raw_[member_index]))
+			{
+				miss_genes_[misses_.size()] = this->Member(member_index);
+				misses_.push_back((uint32_t)member_index);
+			}
+		}
+		Evaluate(miss_genes_.data(), 1, misses_.size(), miss_raw_.data());
+		for (size_t miss = 0; miss < misses_.size(); ++miss)
+		{
+			raw_[misses_[miss]] = miss_raw_[miss];
+			this->cache_.Insert(this->hashes_[misses_[miss]], miss_raw_[miss]);
+		}
+		return misses_.size();
+	}
+	//multiplying by the reciprocal never moves a decoded value across an integer, which DeJong3 truncates to
+	static constexpr double kScale = 1.0 / Function::kDivisor;
+	size_t stride_;
+	std::vector<double> x_;
+	std::vector<double> raw_;
+	std::vector<double> noise_;
+	std::vector<uint32_t> misses_;
+	std::vector<typename Base::Chromosome> miss_genes_;
+	std::vector<double> miss_raw_;
+	double worst_fitness_;
+	double best_fitness_;
 };
 
-double dejong3(double x[5])
+typedef GABenchmark<DeJong1> GADejong1;
+typedef GABenchmark<DeJong2> GADejong2;
+typedef GABenchmark<DeJong3> GADejong3;
+typedef GABenchmark<DeJong4> GADejong4;
+typedef GABenchmark<Rastrigin> GARastrigin;
+typedef GABenchmark<Schwefel> GASchwefel;
+typedef GABenchmark<Griewank> GAGriewank;
+
+//Settings which aren't the classic GA parameters, set from the command line
+typedef struct ga_options_s
 {
-	return (double)((int32_t)x[0] + (int32_t)x[1] + (int32_t)x[2] + (int32_t)x[3] + (int32_t)x[4]);
-}
+	ParentSelector::Method selection;
+	uint32_t tournament_size;
+	BitCrossover crossover;
+	//trial n is seeded with rng::StreamSeed(seed, n)
+	uint64_t seed;
+	//0 means one thread per hardware thread
+	uint32_t num_threads;
+	StatisticsWriter::Format stats_format;
+	//entries in each trial's fitness cache, 0 evaluates every member every generation
+	uint32_t fitness_cache_size;
+} ga_options_t;
+
+const uint32_t kNumTrials = 30;
+const uint32_t kMaxGenerations = 5000;
 
-class GADejong3 : public ion::GeneticAlgorithm<std::vector<bool>>
+//one point of a parameter sweep, the trials and their merged results
+typedef struct ga_configuration_s
 {
-public:
-	GADejong3() = delete;
-	GADejong3(size_t num_members, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, num_chromosomes_*chromosome_length_, mutation_probability, crossover_probability)
+	//index into kFunctions
+	uint32_t function;
+	uint32_t population_size;
+	double mutation_rate;
+	double crossover_rate;
+	//every trial records into its own statistics, so the trials can run in parallel
+	std::vector<TrialStatistics> trial_statistics;
+	GenerationSummary summary;
+} ga_configuration_t;
+
+//GeneticAlgorithm is the GABenchmark of the function
+template<typename GeneticAlgorithm>
+void RunGaTrial(const ga_configuration_t& configuration, const ga_options_t& options, TrialStatistics* statistics)
+{
+	statistics->Reserve(kMaxGenerations);
+	GeneticAlgorithm algo(configuration.population_size, configuration.mutation_rate, configuration.crossover_rate);
+	algo.SetSelectionMethod(options.selection, options.tournament_size);
+	algo.SetCrossover(options.crossover);
+	if (options.fitness_cache_size > 0)
 	{
-		double worst_x[5];
-		worst_x[0] = worst_x[1] = worst_x[2] = worst_x[3] = worst_x[4] = 5.12;
-		worst_fitness_ = dejong3(worst_x);
-		EvaluateMembers();
+		statistics->ReserveCache(kMaxGenerations);
+		algo.EnableFitnessCache(options.fitness_cache_size);
 	}
-	virtual void EvaluateMembers()
+	statistics->Record(algo);
+	if (options.fitness_cache_size > 0)
 	{
-		for (std::vector<std::vector<bool>>::iterator member_it = this->population_.begin(); member_it != this->population_.end(); ++member_it)
-		{
-			this->num_evaluations_++;
-			//convert to a value in range
-			double x[num_chromosomes_];
-			to_val(*member_it, x);
-			//evaluate
-			double raw_fitness = dejong3(x) + worst_fitness_;
-			//scale to [0.0,1.0]
-			double fitness = (worst_fitness_*2 - raw_fitness) / (2*worst_fitness_);
-			LOGASSERT(fitness <= 1.0 && fitness >= 0.0);
-			this->fitness_[member_it - population_.begin()] = fitness;
-		}
+		statistics->RecordCache(algo.GetFitnessCache().Hits(), algo.GetFitnessCache().Misses());
 	}
-	static const uint32_t num_chromosomes_ = 5;
-	static const uint32_t chromosome_length_ = 10;
-	double worst_fitness_;
-	void to_val(std::vector<bool> member, double x[num_chromosomes_])
+	for (uint32_t generation = 1; algo.GetMaxFitness() < 0.99999999 && generation < kMaxGenerations; ++generation)
 	{
-		for (uint32_t dim = 0; dim < num_chromosomes_; ++dim)
+		algo.NextGeneration();
+		statistics->Record(algo);
+		if (options.fitness_cache_size > 0)
 		{
-			int32_t member_offset = signed_vector_to_int(member.begin() + dim*chromosome_length_, member.begin() + (dim + 1)*chromosome_length_);
-			x[dim] = (double)member_offset / 100.0;
+			statistics->RecordCache(algo.GetFitnessCache().Hits(), algo.GetFitnessCache().Misses());
 		}
 	}
-};
+}
 
-double dejong4(double x[30])
+/*
+  How long a trial of configuration takes if it runs all kMaxGenerations,
+  from timing a few generations. Trials which converge early take less, the
+  sweep's work stealing makes up for that.
+*/
+template<typename GeneticAlgorithm>
+double EstimateTrialSeconds(const ga_configuration_t& configuration, const ga_options_t& options)
 {
-	double result = 0.0;
-	for (uint32_t i = 0; i < 30; ++i)
+	const uint32_t kTimedGenerations = 20;
+	GeneticAlgorithm algo(configuration.population_size, configuration.mutation_rate, configuration.crossover_rate);
+	algo.SetSelectionMethod(options.selection, options.tournament_size);
+	algo.SetCrossover(options.crossover);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t generation = 0; generation < kTimedGenerations; ++generation)
 	{
-		double random_number = ion::random_normal_distribution(0.0, 1.0);
-		result += i * pow(x[i], 4) + random_number;
+		algo.NextGeneration();
 	}
-	return result;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * kMaxGenerations / kTimedGenerations;
 }
 
-class GADejong4 : public ion::GeneticAlgorithm<std::vector<bool>>
+//the functions --function can choose, name is the start of the statistics file names
+typedef struct ga_function_s
 {
-public:
-	GADejong4() = delete;
-	GADejong4(size_t num_members, double mutation_probability, double crossover_probability) : ion::GeneticAlgorithm<std::vector<bool>>(num_members, num_chromosomes_*chromosome_length_, mutation_probability, crossover_probability)
+	const char* option;
+	const char* name;
+	void(*run_trial)(const ga_configuration_t& configuration, const ga_options_t& options, TrialStatistics* statistics);
+	double(*estimate_trial_seconds)(const ga_configuration_t& configuration, const ga_options_t& options);
+} ga_function_t;
+
+const ga_function_t kFunctions[] =
+{
+	{ "dj1", "DJ1", &RunGaTrial<GADejong1>, &EstimateTrialSeconds<GADejong1> },
+	{ "dj2", "DJ2", &RunGaTrial<GADejong2>, &EstimateTrialSeconds<GADejong2> },
+	{ "dj3", "DJ3", &RunGaTrial<GADejong3>, &EstimateTrialSeconds<GADejong3> },
+	{ "dj4", "DJ4", &RunGaTrial<GADejong4>, &EstimateTrialSeconds<GADejong4> },
+	{ "rastrigin", "Rastrigin", &RunGaTrial<GARastrigin>, &EstimateTrialSeconds<GARastrigin> },
+	{ "schwefel", "Schwefel", &RunGaTrial<GASchwefel>, &EstimateTrialSeconds<GASchwefel> },
+	{ "griewank", "Griewank", &RunGaTrial<GAGriewank>, &EstimateTrialSeconds<GAGriewank> }
+};
+const uint32_t kNumFunctions = sizeof(kFunctions) / sizeof(kFunctions[0]);
+
+//parses a comma separated list of function options, returns false if one isn't in kFunctions
+bool ParseFunctions(const std::string& list, std::vector<uint32_t>* functions)
+{
+	std::stringstream stream(list);
+	std::string option;
+	while (std::getline(stream, option, ','))
 	{
-		//note that we can't actually define a worst X for this function since it is random, however it is extremely unlikey we would exceed this value
-		double worst_x[30];
-		for (uint32_t x_index = 0; x_index < 30; ++x_index)
+		uint32_t function = 0;
+		while (function < kNumFunctions && option != kFunctions[function].option)
 		{
-			worst_x[x_index] = 1.28;
+			++function;
 		}
-		worst_fitness_ = dejong4(worst_x);
-		EvaluateMembers();
-	}
-	virtual void EvaluateMembers()
-	{
-		for (std::vector<std::vector<bool>>::iterator member_it = this->population_.begin(); member_it != this->population_.end(); ++member_it)
+		if (function == kNumFunctions)
 		{
-			this->num_evaluations_++;
-			//convert to a value in range
-			double x[num_chromosomes_];
-			to_val(*member_it, x);
-			//evaluate
-			double raw_fitness = dejong4(x) + worst_fitness_;
-			//scale to [0.0,1.0]
-			double fitness = (worst_fitness_ * 2 - raw_fitness) / (2 * worst_fitness_);
-			LOGASSERT(fitness <= 1.0 && fitness >= 0.0);
-			this->fitness_[member_it - population_.begin()] = fitness;
+			LOGERROR("Unknown function %s", option.c_str());
+			return false;
 		}
+		functions->push_back(function);
 	}
-	static const uint32_t num_chromosomes_ = 30;
-	static const uint32_t chromosome_length_ = 8;
-	double worst_fitness_;
-	void to_val(std::vector<bool> member, double x[num_chromosomes_])
+	return !functions->empty();
+}
+
+//writes the merged results of configuration to its statistics file
+void WriteConfiguration(const ga_configuration_t& configuration, const ga_options_t& options)
+{
+	std::stringstream filename;
+	filename << kFunctions[configuration.function].name << "_pop" << configuration.population_size << "_mut" << configuration.mutation_rate << "_xover" << configuration.crossover_rate << StatisticsWriter::Extension(options.stats_format);
+	std::vector<std::string> columns = { "Generation", "Min", "Max", "Mean", "Evals" };
+	if (options.fitness_cache_size > 0)
 	{
-		for (uint32_t dim = 0; dim < num_chromosomes_; ++dim)
-		{
-			int32_t member_offset = signed_vector_to_int(member.begin() + dim*chromosome_length_, member.begin() + (dim + 1)*chromosome_length_);
-			x[dim] = (double)member_offset / 100.0;
-		}
+		columns.push_back("Hits");
+		columns.push_back("Misses");
 	}
-};
+	StatisticsWriter writer(filename.str(), options.stats_format, columns);
+	for (size_t generation_index = 0; generation_index < configuration.summary.NumGenerations(); ++generation_index)
+	{
+		const generation_summary_t& generation = configuration.summary[generation_index];
+		double row[7] = { (double)generation_index, generation.min_fitness.Mean(), generation.max_fitness.Mean(), generation.avg_fitness.Mean(), generation.num_evals.Mean(),
+			generation.cache_hits.Mean(), generation.cache_misses.Mean() };
+		writer.AddRow(row);
+	}
+}
 
-void ExecuteGa(uint32_t population_size, double mutation_rate, double crossover_rate)
+/*
+  Runs kNumTrials trials of every configuration with RunSweep, so all the
+  threads stay busy across configurations, and writes each configuration's
+  statistics file as soon as its last trial is merged.
+*/
+sweep_report_t ExecuteSweep(std::vector<ga_configuration_t>& configurations, const ga_options_t& options)
 {
-
-	std::ofstream fout;
-	uint32_t dejong_num = 4;
-	std::stringstream filename;
-	filename << "DJ" << dejong_num << "_pop" << population_size << "_mut" << mutation_rate << "_xover" << crossover_rate << ".csv";
-	fout.open(filename.str());
-	fout << "Generation,Min,Max,Mean,Evals" << std::endl;
-	double max_fitness[5000] = { 0 };
-	double min_fitness[5000] = { 0 };
-	double avg_fitness[5000] = { 0 };
-	double num_evals[5000] = { 0 };
-	double num_hits[5000] = { 0 };
-	for (uint32_t trial = 0; trial < 30; ++trial)
-	{
-		//Change this next line to switch between functions
-		GADejong4 algo(population_size, mutation_rate, crossover_rate);
-		uint32_t generation = 0;
-		max_fitness[generation] += algo.GetMaxFitness();
-		min_fitness[generation] += algo.GetMinFitness();
-		avg_fitness[generation] += algo.GetAverageFitness();
-		num_evals[generation] += algo.GetNumEvals();
-		num_hits[generation]++;
-		for (generation = 1; algo.GetMaxFitness() < 0.99999999 && generation < 5000; ++generation)
-		{
-			algo.NextGeneration();
-			max_fitness[generation] += algo.GetMaxFitness();
-			min_fitness[generation] += algo.GetMinFitness();
-			avg_fitness[generation] += algo.GetAverageFitness();
-			num_evals[generation] += algo.GetNumEvals();
-			num_hits[generation]++;
-		}
-		LOGINFO("Completed trial %u", trial);
+	std::vector<double> costs(configurations.size());
+	for (size_t config = 0; config < configurations.size(); ++config)
+	{
+		configurations[config].trial_statistics.resize(kNumTrials);
+		costs[config] = kFunctions[configurations[config].function].estimate_trial_seconds(configurations[config], options);
 	}
-	//scale all of the computed values
-	for (uint32_t generation_index = 0; generation_index < 5000; ++generation_index)
+	return RunSweep(costs, kNumTrials, options.seed, options.num_threads, [&](uint32_t config, uint32_t trial)
+	{
+		ga_configuration_t& configuration = configurations[config];
+		kFunctions[configuration.function].run_trial(configuration, options, &configuration.trial_statistics[trial]);
+	}, [&](uint32_t config, uint32_t trial)
 	{
-		if (num_hits[generation_index] == 0)
+		//merged in trial order so the output doesn't depend on which thread ran which trial
+		ga_configuration_t& configuration = configurations[config];
+		if (trial == 0)
 		{
-			break;
+			configuration.summary.Reserve(kMaxGenerations);
+		}
+		configuration.summary.Add(configuration.trial_statistics[trial]);
+		configuration.trial_statistics[trial].Release();
+		if (trial == kNumTrials - 1)
+		{
+			WriteConfiguration(configuration, options);
+			configuration.summary = GenerationSummary();
+			LOGINFO("Completed %s pop %u, mutation %g, crossover %g", kFunctions[configuration.function].name, configuration.population_size, configuration.mutation_rate, configuration.crossover_rate);
 		}
-		max_fitness[generation_index] /= num_hits[generation_index];
-		min_fitness[generation_index] /= num_hits[generation_index];
-		avg_fitness[generation_index] /= num_hits[generation_index];
-		num_evals[generation_index] /= num_hits[generation_index];
-		fout << generation_index << "," << min_fitness[generation_index] << "," << max_fitness[generation_index] << "," << avg_fitness[generation_index] << "," << num_evals[generation_index] << std::endl;
+	});
+}
+
+#ifdef COUNT_ALLOCATIONS
+/*
+  Lets ga warm up so every buffer has reached its final size, then counts
+  the heap allocations made by the following generations, which should be 0.
+*/
+template<typename GeneticAlgorithm>
+uint64_t CheckAllocations(const char* name, GeneticAlgorithm& ga, uint32_t num_generations)
+{
+	const uint32_t kWarmupGenerations = 100;
+	for (uint32_t generation = 0; generation < kWarmupGenerations; ++generation)
+	{
+		ga.NextGeneration();
+	}
+	uint64_t allocations_before = NumAllocations();
+	for (uint32_t generation = 0; generation < num_generations; ++generation)
+	{
+		ga.NextGeneration();
+	}
+	uint64_t allocations = NumAllocations() - allocations_before;
+	printf("  %-10s %llu allocations in %u generations\n", name, (unsigned long long)allocations, num_generations);
+	LOGINFO("%s: %llu allocations in %u generations", name, (unsigned long long)allocations, num_generations);
+	return allocations;
+}
+#endif
+
+/*
+  Times num_generations generations of ga and reports the evaluations per
+  second, the figure the chromosome representation is tuned for.
+*/
+template<typename GeneticAlgorithm>
+double BenchmarkEvaluations(const char* name, GeneticAlgorithm& ga, uint32_t num_generations)
+{
+	uint32_t evaluations_before = ga.GetNumEvals();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t generation = 0; generation < num_generations; ++generation)
+	{
+		ga.NextGeneration();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double evaluations_per_second = (ga.GetNumEvals() - evaluations_before) / seconds;
+	printf("  %-10s %12.0lf evaluations/s (%u generations in %.3lf s)\n", name, evaluations_per_second, num_generations, seconds);
+	LOGINFO("%s: %.0lf evaluations/s", name, evaluations_per_second);
+	return evaluations_per_second;
+}
+
+//times num_passes calls of ga.EvaluateMembers alone and reports the time per member evaluated
+template<typename GeneticAlgorithm>
+double BenchmarkEvaluateMembers(const char* name, GeneticAlgorithm& ga, uint32_t num_passes)
+{
+	uint32_t evaluations_before = ga.GetNumEvals();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t pass = 0; pass < num_passes; ++pass)
+	{
+		ga.EvaluateMembers();
 	}
-	fout.close();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double nanoseconds_per_member = seconds * 1e9 / (ga.GetNumEvals() - evaluations_before);
+	printf("  %-10s %8.2lf ns per member\n", name, nanoseconds_per_member);
+	LOGINFO("%s: %.2lf ns per member evaluated", name, nanoseconds_per_member);
+	return nanoseconds_per_member;
 }
 
 int main(int argc, char* argv[])
 {
 	ion::Error result = ion::InitSockets();
 	ion::LogInit("genetic_algorithm");
-	//open a file for logging results
-	uint32_t population_set[3] = { 50, 100, 150 };
-	double mutation_set[3] = { 0.0001, 0.001, 0.01 };
-	double crossover_set[3] = { 0.2, 0.67, 0.99 };
-	for (uint32_t pop_choice = 0; pop_choice < 3; ++pop_choice)
+#ifdef COUNT_ALLOCATIONS
+	//Usage: genetic-algorithm.exe --check-allocations [generations]
+	if (argc >= 2 && std::string(argv[1]) == "--check-allocations")
 	{
-		for (uint32_t mutation_choice = 0; mutation_choice < 3; ++mutation_choice)
+		uint32_t num_generations = argc >= 3 ? (uint32_t)atoi(argv[2]) : 1000;
+		uint64_t allocations = 0;
+		for (uint32_t method = 0; method < 4; ++method)
 		{
-			for (uint32_t crossover_choice = 0; crossover_choice < 3; ++crossover_choice)
-			{
-				ExecuteGa(population_set[pop_choice], mutation_set[mutation_choice], crossover_set[crossover_choice]);
-				LOGINFO("Completed pop %d, mutation %d, crossover %d", pop_choice, mutation_choice, crossover_choice);
-			}
+			GANumOnes<100> num_ones(100, 0.01, 0.67);
+			GADejong1 dejong1(100, 0.01, 0.67);
+			GADejong2 dejong2(100, 0.01, 0.67);
+			GADejong3 dejong3(100, 0.01, 0.67);
+			GADejong4 dejong4(100, 0.01, 0.67);
+			GARastrigin rastrigin_cached(100, 0.01, 0.67);
+			rastrigin_cached.EnableFitnessCache(4096);
+			num_ones.SetSelectionMethod((ParentSelector::Method)method, 2);
+			dejong1.SetSelectionMethod((ParentSelector::Method)method, 2);
+			dejong2.SetSelectionMethod((ParentSelector::Method)method, 2);
+			dejong3.SetSelectionMethod((ParentSelector::Method)method, 2);
+			dejong4.SetSelectionMethod((ParentSelector::Method)method, 2);
+			rastrigin_cached.SetSelectionMethod((ParentSelector::Method)method, 2);
+			printf("selection method %u\n", method);
+			allocations += CheckAllocations("NumOnes", num_ones, num_generations);
+			allocations += CheckAllocations("DeJong1", dejong1, num_generations);
+			allocations += CheckAllocations("DeJong2", dejong2, num_generations);
+			allocations += CheckAllocations("DeJong3", dejong3, num_generations);
+			allocations += CheckAllocations("DeJong4", dejong4, num_generations);
+			allocations += CheckAllocations("Rastrigin (cached)", rastrigin_cached, num_generations);
+		}
+		if (allocations != 0)
+		{
+			LOGERROR("Steady state generations made %llu heap allocations", (unsigned long long)allocations);
+			return 1;
+		}
+		printf("No heap allocations in steady state generations\n");
+		return 0;
+	}
+#endif
+	//Usage: genetic-algorithm.exe --bench-evaluations [generations]
+	if (argc >= 2 && std::string(argv[1]) == "--bench-evaluations")
+	{
+		uint32_t num_generations = argc >= 3 ? (uint32_t)atoi(argv[2]) : 2000;
+		const char* crossover_names[3] = { "one-point", "two-point", "uniform" };
+		for (uint32_t crossover = 0; crossover < 3; ++crossover)
+		{
+			GANumOnes<100> num_ones(100, 0.01, 0.67);
+			GADejong1 dejong1(100, 0.01, 0.67);
+			GADejong2 dejong2(100, 0.01, 0.67);
+			GADejong3 dejong3(100, 0.01, 0.67);
+			GADejong4 dejong4(100, 0.01, 0.67);
+			num_ones.SetCrossover((BitCrossover)crossover);
+			dejong1.SetCrossover((BitCrossover)crossover);
+			dejong2.SetCrossover((BitCrossover)crossover);
+			dejong3.SetCrossover((BitCrossover)crossover);
+			dejong4.SetCrossover((BitCrossover)crossover);
+			printf("%s crossover\n", crossover_names[crossover]);
+			BenchmarkEvaluations("NumOnes", num_ones, num_generations);
+			BenchmarkEvaluations("DeJong1", dejong1, num_generations);
+			BenchmarkEvaluations("DeJong2", dejong2, num_generations);
+			BenchmarkEvaluations("DeJong3", dejong3, num_generations);
+			BenchmarkEvaluations("DeJong4", dejong4, num_generations);
+		}
+#ifdef CS776_HAVE_AVX2
+		printf("batch evaluation (AVX2)\n");
+#else
+		printf("batch evaluation (scalar)\n");
+#endif
+		GADejong1 dejong1(100, 0.01, 0.67);
+		GADejong2 dejong2(100, 0.01, 0.67);
+		GADejong3 dejong3(100, 0.01, 0.67);
+		GADejong4 dejong4(100, 0.01, 0.67);
+		GARastrigin rastrigin(100, 0.01, 0.67);
+		GASchwefel schwefel(100, 0.01, 0.67);
+		GAGriewank griewank(100, 0.01, 0.67);
+		BenchmarkEvaluateMembers("DeJong1", dejong1, num_generations * 10);
+		BenchmarkEvaluateMembers("DeJong2", dejong2, num_generations * 10);
+		BenchmarkEvaluateMembers("DeJong3", dejong3, num_generations * 10);
+		BenchmarkEvaluateMembers("DeJong4", dejong4, num_generations);
+		BenchmarkEvaluateMembers("Rastrigin", rastrigin, num_generations);
+		BenchmarkEvaluateMembers("Schwefel", schwefel, num_generations);
+		BenchmarkEvaluateMembers("Griewank", griewank, num_generations);
+		return 0;
+	}
+	//Usage: genetic-algorithm.exe --convert-stats in.stats out.csv
+	if (argc >= 2 && std::string(argv[1]) == "--convert-stats")
+	{
+		if (argc < 4)
+		{
+			LOGFATAL("Usage: --convert-stats in.stats out.csv");
+		}
+		return ConvertStatistics(argv[2], argv[3]) ? 0 : 1;
+	}
+	//Usage: genetic-algorithm.exe [--selection fitness|rank|sus|tournament] [--tournament-size k] [--crossover one-point|two-point|uniform] [--seed n] [--threads n] [--stats-format csv|binary] [--function dj1|dj2|dj3|dj4|rastrigin|schwefel|griewank[,...]] [--sweep grid|random|lhs] [--samples n] [--fitness-cache entries]
+	CommandLine command_line(argc, argv);
+	ga_options_t options;
+	if (!ParentSelector::ParseMethod(command_line.GetString("selection", "fitness"), &options.selection))
+	{
+		LOGFATAL("Unknown selection method %s", command_line.GetString("selection", "").c_str());
+	}
+	int64_t tournament_size = command_line.GetInt("tournament-size", 2);
+	if (tournament_size < 1)
+	{
+		LOGFATAL("--tournament-size must be at least 1, not %s", command_line.GetString("tournament-size", "").c_str());
+	}
+	options.tournament_size = (uint32_t)std::min(tournament_size, (int64_t)UINT32_MAX);
+	if (!ParseBitCrossover(command_line.GetString("crossover", "one-point"), &options.crossover))
+	{
+		LOGFATAL("Unknown crossover operator %s", command_line.GetString("crossover", "").c_str());
+	}
+	options.seed = (uint64_t)command_line.GetInt("seed", (int64_t)time(NULL));
+	options.num_threads = (uint32_t)command_line.GetInt("threads", 0);
+	options.fitness_cache_size = (uint32_t)command_line.GetInt("fitness-cache", 0);
+	if (!StatisticsWriter::ParseFormat(command_line.GetString("stats-format", "csv"), &options.stats_format))
+	{
+		LOGFATAL("Unknown statistics format %s", command_line.GetString("stats-format", "").c_str());
+	}
+	LOGINFO("Using seed %llu, rerun with --seed %llu to reproduce this run", (unsigned long long)options.seed, (unsigned long long)options.seed);
+	std::vector<uint32_t> functions;
+	if (!ParseFunctions(command_line.GetString("function", "dj4"), &functions))
+	{
+		LOGFATAL("Bad function list %s", command_line.GetString("function", "").c_str());
+	}
+	ParameterSweep::Method sweep_method;
+	if (!ParameterSweep::ParseMethod(command_line.GetString("sweep", "grid"), &sweep_method))
+	{
+		LOGFATAL("Unknown sweep method %s", command_line.GetString("sweep", "").c_str());
+	}
+	//population, mutation rate, crossover rate
+	std::vector<std::vector<double>> points;
+	if (sweep_method == ParameterSweep::GRID)
+	{
+		points = ParameterSweep::Grid({ { 50, 100, 150 }, { 0.0001, 0.001, 0.01 }, { 0.2, 0.67, 0.99 } });
+	} else
+	{
+		uint32_t num_samples = (uint32_t)command_line.GetInt("samples", 27);
+		std::vector<ParameterSweep::Range> ranges = { { 50, 151, false }, { 0.0001, 0.01, true }, { 0.2, 0.99, false } };
+		points = sweep_method == ParameterSweep::RANDOM ? ParameterSweep::Random(ranges, num_samples, options.seed) : ParameterSweep::LatinHypercube(ranges, num_samples, options.seed);
+	}
+	std::vector<ga_configuration_t> configurations;
+	for (std::vector<uint32_t>::iterator function_it = functions.begin(); function_it != functions.end(); ++function_it)
+	{
+		for (std::vector<std::vector<double>>::iterator point_it = points.begin(); point_it != points.end(); ++point_it)
+		{
+			ga_configuration_t configuration;
+			configuration.function = *function_it;
+			configuration.population_size = (uint32_t)(*point_it)[0];
+			configuration.mutation_rate = (*point_it)[1];
+			configuration.crossover_rate = (*point_it)[2];
+			configurations.push_back(std::move(configuration));
+		}
+	}
+	for (std::vector<ga_configuration_t>::const_iterator configuration_it = configurations.begin(); configuration_it != configurations.end(); ++configuration_it)
+	{
+		if (options.tournament_size > configuration_it->population_size)
+		{
+			LOGFATAL("--tournament-size %u is more than the population size %u of the sweep", options.tournament_size, configuration_it->population_size);
 		}
 	}
+	LogSweepReport(ExecuteSweep(configurations, options));
 	return 0;
 }
\ No newline at end of file
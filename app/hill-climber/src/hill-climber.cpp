@@ -2,6 +2,8 @@
 #include <float.h>
 #include <string.h>
 #include <time.h>
+#include <stdlib.h>
+#include "random.h"
 using namespace std;
 
 double eval(int *pj);
@@ -10,13 +12,7 @@ double eval(int *pj);
 void mutate(int vec[VECTOR_LENGTH])
 {
 	//select a random bit to flip
-	int random_value = rand();
-	//clamp the value to the range [0,100)
-	if (random_value < 0)
-	{
-		random_value *= -1;
-	}
-	random_value %= VECTOR_LENGTH;
+	uint64_t random_value = rng::randull(0, VECTOR_LENGTH - 1);
 	//flip that bit
 	vec[random_value] = 1 - vec[random_value];
 }
@@ -27,10 +23,13 @@ int main(int argc, char* argv[])
 	int vec[VECTOR_LENGTH];
 
 	int i;
-	srand((uint32_t)time(NULL));
+	//Usage: hill-climber [seed], the seed defaults to the time
+	uint64_t seed = (argc > 1) ? strtoull(argv[1], NULL, 10) : (uint64_t)time(NULL);
+	cout << "Using seed " << seed << endl;
+	rng::Seed(seed);
 	for (i = 0; i < VECTOR_LENGTH; i++)
 	{
-		best_vec[i] = abs(rand() % 2);
+		best_vec[i] = (int)rng::randull(0, 1);
 	}
 
 	double fitness = eval(best_vec);
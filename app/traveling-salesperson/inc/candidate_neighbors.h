@@ -0,0 +1,331 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_CANDIDATE_NEIGHBORS_H_
+#define CS776_CANDIDATE_NEIGHBORS_H_
+#include "ionlib\log.h"
+#include "ionlib\geometry.h"
+#include "distance_oracle.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+/*
+SpatialGrid buckets the cities into a uniform grid of square cells so that
+"which cities are close to this point" can be answered by only looking at
+the cells around that point instead of every city.
+
+The grid is sized so that each cell holds about two cities on average.
+
+Instances without planar coordinates (GEO and EXPLICIT) are built with
+BuildFromWeights instead. Then there are no cells, and each query scans
+every city ranking them by the oracle's weights, so it is O(n).
+
+Once built the grid is only read, so one grid can be shared by every GA
+(and thread) solving the instance. The queries collect their candidates in
+a vector the caller keeps; reserving GetNumCities() entries in it once
+means the queries never allocate.
+*/
+class SpatialGrid
+{
+public:
+	//A candidate city and its score under whatever metric the query used
+	typedef std::pair<double, uint32_t> Candidate;
+
+	SpatialGrid()
+	{
+		cells_per_side_ = 0;
+		cell_size_ = 1.0;
+		oracle_ = NULL;
+	}
+	void Build(const std::vector<ion::Point2<double>>& cities)
+	{
+		oracle_ = NULL;
+		cities_ = cities;
+		cells_per_side_ = (int32_t)std::ceil(std::sqrt(cities.size() / 2.0));
+		if (cells_per_side_ < 1)
+		{
+			cells_per_side_ = 1;
+		}
+		min_x_ = max_x_ = cities.empty() ? 0.0 : cities[0].x1_;
+		min_y_ = max_y_ = cities.empty() ? 0.0 : cities[0].x2_;
+		for (std::vector<ion::Point2<double>>::const_iterator city_it = cities.begin(); city_it != cities.end(); ++city_it)
+		{
+			min_x_ = std::min(min_x_, city_it->x1_);
+			max_x_ = std::max(max_x_, city_it->x1_);
+			min_y_ = std::min(min_y_, city_it->x2_);
+			max_y_ = std::max(max_y_, city_it->x2_);
+		}
+		cell_size_ = std::max(max_x_ - min_x_, max_y_ - min_y_) / cells_per_side_;
+		if (cell_size_ <= 0.0)
+		{
+			cell_size_ = 1.0;
+		}
+		//bucket the cities with a counting sort so each cell is a contiguous range of cell_cities_
+		size_t num_cells = (size_t)cells_per_side_ * cells_per_side_;
+		cell_start_.assign(num_cells + 1, 0);
+		for (std::vector<ion::Point2<double>>::const_iterator city_it = cities.begin(); city_it != cities.end(); ++city_it)
+		{
+			cell_start_[CellIndex(CellX(city_it->x1_), CellY(city_it->x2_)) + 1]++;
+		}
+		for (size_t cell_index = 0; cell_index < num_cells; ++cell_index)
+		{
+			cell_start_[cell_index + 1] += cell_start_[cell_index];
+		}
+		cell_cities_.resize(cities.size());
+		std::vector<uint32_t> fill = cell_start_;
+		for (uint32_t city_index = 0; city_index < cities.size(); ++city_index)
+		{
+			size_t cell = CellIndex(CellX(cities[city_index].x1_), CellY(cities[city_index].x2_));
+			cell_cities_[fill[cell]++] = city_index;
+		}
+	}
+	//answers the queries from oracle's weights, which must outlive the grid
+	void BuildFromWeights(const DistanceOracle& oracle)
+	{
+		oracle_ = &oracle;
+		cities_.clear();
+		cell_start_.clear();
+		cell_cities_.clear();
+	}
+	size_t GetNumCities() const
+	{
+		return oracle_ != NULL ? oracle_->GetNumCities() : cities_.size();
+	}
+	/*
+	  Returns the nth (0-based) closest city to the pair (left, right), where
+	  "distance" is d(left, city) + d(right, city), ignoring city 0, left and
+	  right. This is exactly the ranking the midpoint mutation used to build a
+	  multimap of every city for, ties are broken by city index.
+
+	  The search looks at rings of cells around the midpoint of left and right.
+	  After ring r every city within R = r * cell_size of the midpoint has been
+	  seen, and any city outside that radius has a score of at least 2R, so
+	  once n+1 of the seen cities score at most 2R the answer is among them.
+
+	  Returns false if fewer than n+1 cities are eligible. candidates is
+	  scratch space, see the class comment.
+	*/
+	bool NthClosestToPair(uint32_t left, uint32_t right, size_t n, std::vector<Candidate>& candidates, uint32_t* result) const
+	{
+		candidates.clear();
+		if (oracle_ != NULL)
+		{
+			for (uint32_t city_index = 1; city_index < oracle_->GetNumCities(); ++city_index)
+			{
+				if (city_index != left && city_index != right)
+				{
+					candidates.push_back(Candidate((double)oracle_->Distance(left, city_index) + oracle_->Distance(right, city_index), city_index));
+				}
+			}
+			return SelectNth(n, candidates, result);
+		}
+		const ion::Point2<double>& left_location = cities_[left];
+		const ion::Point2<double>& right_location = cities_[right];
+		ion::Point2<double> midpoint((left_location.x1_ + right_location.x1_) / 2.0, (left_location.x2_ + right_location.x2_) / 2.0);
+		int32_t center_x = CellX(midpoint.x1_);
+		int32_t center_y = CellY(midpoint.x2_);
+		for (int32_t ring = 0; ring <= cells_per_side_; ++ring)
+		{
+			VisitRing(center_x, center_y, ring, [&](uint32_t city_index)
+			{
+				if (city_index == 0 || city_index == left || city_index == right)
+				{
+					return;
+				}
+				double score = left_location.distance(cities_[city_index]) + right_location.distance(cities_[city_index]);
+				candidates.push_back(Candidate(score, city_index));
+			});
+			//count how many of the candidates are guaranteed to be ranked correctly
+			double bound = 2.0 * ring * cell_size_;
+			size_t num_settled = 0;
+			for (std::vector<Candidate>::const_iterator candidate_it = candidates.begin(); candidate_it != candidates.end(); ++candidate_it)
+			{
+				if (candidate_it->first <= bound)
+				{
+					num_settled++;
+				}
+			}
+			if (num_settled > n)
+			{
+				break;
+			}
+		}
+		return SelectNth(n, candidates, result);
+	}
+	/*
+	  Fills neighbors with the k closest cities to city_index (not including
+	  itself), closest first. Uses the same ring expansion as NthClosestToPair
+	  but with plain euclidean distance, so the bound after ring r is just R.
+	*/
+	void KNearest(uint32_t city_index, size_t k, std::vector<Candidate>& candidates, std::vector<uint32_t>& neighbors) const
+	{
+		candidates.clear();
+		if (oracle_ != NULL)
+		{
+			k = std::min(k, oracle_->GetNumCities() - 1);
+			for (uint32_t other_index = 0; other_index < oracle_->GetNumCities(); ++other_index)
+			{
+				if (other_index != city_index)
+				{
+					candidates.push_back(Candidate((double)oracle_->Distance(city_index, other_index), other_index));
+				}
+			}
+		} else
+		{
+			k = std::min(k, cities_.size() - 1);
+			RingCandidates(city_index, k, candidates);
+		}
+		std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+		neighbors.resize(k);
+		for (size_t neighbor_index = 0; neighbor_index < k; ++neighbor_index)
+		{
+			neighbors[neighbor_index] = candidates[neighbor_index].second;
+		}
+	}
+private:
+	//collects the cities around city_index ring by ring until the k closest of them are certainly among the candidates
+	void RingCandidates(uint32_t city_index, size_t k, std::vector<Candidate>& candidates) const
+	{
+		const ion::Point2<double>& location = cities_[city_index];
+		int32_t center_x = CellX(location.x1_);
+		int32_t center_y = CellY(location.x2_);
+		for (int32_t ring = 0; ring <= cells_per_side_; ++ring)
+		{
+			VisitRing(center_x, center_y, ring, [&](uint32_t other_index)
+			{
+				if (other_index != city_index)
+				{
+					candidates.push_back(Candidate(location.distance(cities_[other_index]), other_index));
+				}
+			});
+			double bound = ring * cell_size_;
+			size_t num_settled = 0;
+			for (std::vector<Candidate>::const_iterator candidate_it = candidates.begin(); candidate_it != candidates.end(); ++candidate_it)
+			{
+				if (candidate_it->first <= bound)
+				{
+					num_settled++;
+				}
+			}
+			if (num_settled >= k)
+			{
+				break;
+			}
+		}
+	}
+	//the nth lowest scoring candidate, ties broken by city index
+	static bool SelectNth(size_t n, std::vector<Candidate>& candidates, uint32_t* result)
+	{
+		if (candidates.size() <= n)
+		{
+			return false;
+		}
+		std::nth_element(candidates.begin(), candidates.begin() + n, candidates.end());
+		*result = candidates[n].second;
+		return true;
+	}
+	inline int32_t CellX(double x) const
+	{
+		return std::min(std::max((int32_t)((x - min_x_) / cell_size_), 0), cells_per_side_ - 1);
+	}
+	inline int32_t CellY(double y) const
+	{
+		return std::min(std::max((int32_t)((y - min_y_) / cell_size_), 0), cells_per_side_ - 1);
+	}
+	inline size_t CellIndex(int32_t cell_x, int32_t cell_y) const
+	{
+		return (size_t)cell_y * cells_per_side_ + cell_x;
+	}
+	//calls visitor on every city in the cells exactly ring cells away (in x or y) from the center cell
+	template<typename Visitor>
+	void VisitRing(int32_t center_x, int32_t center_y, int32_t ring, Visitor visitor) const
+	{
+		for (int32_t cell_y = center_y - ring; cell_y <= center_y + ring; ++cell_y)
+		{
+			if (cell_y < 0 || cell_y >= cells_per_side_)
+			{
+				continue;
+			}
+			//on the top and bottom rows of the ring visit every cell, otherwise just the two ends
+			bool full_row = (cell_y == center_y - ring || cell_y == center_y + ring);
+			int32_t step = (full_row || ring == 0) ? 1 : 2 * ring;
+			for (int32_t cell_x = center_x - ring; cell_x <= center_x + ring; cell_x += step)
+			{
+				if (cell_x < 0 || cell_x >= cells_per_side_)
+				{
+					continue;
+				}
+				size_t cell = CellIndex(cell_x, cell_y);
+				for (uint32_t slot = cell_start_[cell]; slot < cell_start_[cell + 1]; ++slot)
+				{
+					visitor(cell_cities_[slot]);
+				}
+			}
+		}
+	}
+	std::vector<ion::Point2<double>> cities_;
+	int32_t cells_per_side_;
+	double cell_size_;
+	double min_x_, max_x_, min_y_, max_y_;
+	//cell_cities_[cell_start_[c] .. cell_start_[c+1]) are the cities in cell c
+	std::vector<uint32_t> cell_start_;
+	std::vector<uint32_t> cell_cities_;
+	//set by BuildFromWeights, the grid is unused then
+	const DistanceOracle* oracle_;
+};
+
+/*
+CandidateNeighbors holds the k nearest cities of every city, closest first.
+These are the only cities worth considering as new neighbors when improving
+a tour, which is what makes neighbor-list based operators independent of the
+number of cities.
+*/
+class CandidateNeighbors
+{
+public:
+	CandidateNeighbors()
+	{
+		k_ = 0;
+	}
+	void Build(const SpatialGrid& grid, size_t num_cities, size_t k)
+	{
+		k_ = std::min(k, num_cities - 1);
+		neighbors_.resize(num_cities * k_);
+		std::vector<SpatialGrid::Candidate> candidates;
+		candidates.reserve(grid.GetNumCities());
+		std::vector<uint32_t> city_neighbors;
+		for (uint32_t city_index = 0; city_index < num_cities; ++city_index)
+		{
+			grid.KNearest(city_index, k_, candidates, city_neighbors);
+			std::copy(city_neighbors.begin(), city_neighbors.end(), neighbors_.begin() + city_index * k_);
+		}
+	}
+	inline const uint32_t* GetNeighbors(uint32_t city_index) const
+	{
+		return neighbors_.data() + city_index * k_;
+	}
+	inline size_t GetK() const
+	{
+		return k_;
+	}
+private:
+	size_t k_;
+	std::vector<uint32_t> neighbors_;
+};
+#endif //CS776_CANDIDATE_NEIGHBORS_H_
@@ -0,0 +1,280 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_CROSSOVER_H_
+#define CS776_CROSSOVER_H_
+#include "ionlib\log.h"
+#include "random.h"
+#include <vector>
+#include <algorithm>
+
+/*
+PermutationCrossover recombines two routes (permutations of the cities
+1..n-1, city 0 is the fixed start) without ever searching a route for a city.
+
+Every route is paired with a position index where position[city] is the
+index of city in the route. The children are expected to start out as copies
+of their parents and are crossed over in place, so the caller can keep them
+in preallocated buffers. All scratch space is owned by this class and sized
+once, so crossing over does not allocate.
+
+The operators are:
+  * PARTIALLY_MAPPED: for each index in [begin, end] the city the other
+    parent has there is swapped into place. With the position index each
+    step is O(1), so the whole crossover is O(end - begin)
+  * ORDER: each child keeps [begin, end] of its own parent and fills the
+    rest with the other parent's cities in the order they appear after end
+  * EDGE_RECOMBINATION: builds each child from the union of both parents'
+    edges, always moving to the neighbor with the fewest remaining
+    neighbors. begin and end are ignored
+*/
+class PermutationCrossover
+{
+public:
+	enum Operator
+	{
+		PARTIALLY_MAPPED,
+		ORDER,
+		EDGE_RECOMBINATION
+	};
+	PermutationCrossover()
+	{
+		operator_ = PARTIALLY_MAPPED;
+		route_length_ = 0;
+	}
+	PermutationCrossover(Operator crossover_operator, size_t route_length)
+	{
+		Init(crossover_operator, route_length);
+	}
+	void Init(Operator crossover_operator, size_t route_length)
+	{
+		operator_ = crossover_operator;
+		route_length_ = route_length;
+		//cities are numbered 0..route_length
+		size_t num_cities = route_length + 1;
+		parent1_.resize(route_length);
+		parent2_.resize(route_length);
+		in_segment_.resize(num_cities);
+		adjacency_.resize(num_cities * kMaxEdges);
+		num_adjacent_.resize(num_cities);
+		unused_.resize(num_cities);
+		unused_position_.resize(num_cities);
+	}
+	Operator GetOperator() const
+	{
+		return operator_;
+	}
+	void Cross(uint32_t* child1, uint32_t* position1, uint32_t* child2, uint32_t* position2, size_t begin, size_t end)
+	{
+		switch (operator_)
+		{
+		case PARTIALLY_MAPPED:
+			PartiallyMapped(child1, position1, child2, position2, begin, end);
+			break;
+		case ORDER:
+			Order(child1, position1, child2, position2, begin, end);
+			break;
+		case EDGE_RECOMBINATION:
+			EdgeRecombination(child1, position1, child2, position2);
+			break;
+		}
+	}
+	void PartiallyMapped(uint32_t* child1, uint32_t* position1, uint32_t* child2, uint32_t* position2, size_t begin, size_t end)
+	{
+		for (size_t crossover_index = begin; crossover_index <= end; ++crossover_index)
+		{
+			//to update child1, we check what child2 has in this position, find that item in child1, and swap it into this position. Similarly for the other child
+			uint32_t city_in_child1 = child1[crossover_index];
+			uint32_t city_in_child2 = child2[crossover_index];
+			uint32_t child2_city_in_child1 = position1[city_in_child2];
+			uint32_t child1_city_in_child2 = position2[city_in_child1];
+			std::swap(child1[crossover_index], child1[child2_city_in_child1]);
+			std::swap(position1[city_in_child1], position1[city_in_child2]);
+			std::swap(child2[crossover_index], child2[child1_city_in_child2]);
+			std::swap(position2[city_in_child1], position2[city_in_child2]);
+		}
+	}
+	void Order(uint32_t* child1, uint32_t* position1, uint32_t* child2, uint32_t* position2, size_t begin, size_t end)
+	{
+		std::copy(child1, child1 + route_length_, parent1_.begin());
+		std::copy(child2, child2 + route_length_, parent2_.begin());
+		OrderChild(parent1_.data(), parent2_.data(), child1, position1, begin, end);
+		OrderChild(parent2_.data(), parent1_.data(), child2, position2, begin, end);
+	}
+	void EdgeRecombination(uint32_t* child1, uint32_t* position1, uint32_t* child2, uint32_t* position2)
+	{
+		std::copy(child1, child1 + route_length_, parent1_.begin());
+		std::copy(child2, child2 + route_length_, parent2_.begin());
+		BuildEdgeMap(parent1_.data(), parent2_.data());
+		EdgeRecombinationChild(child1, position1);
+		EdgeRecombinationChild(child2, position2);
+	}
+private:
+	//each city has two neighbors in each parent
+	static const size_t kMaxEdges = 4;
+	void OrderChild(const uint32_t* parent, const uint32_t* other_parent, uint32_t* child, uint32_t* position, size_t begin, size_t end)
+	{
+		std::fill(in_segment_.begin(), in_segment_.end(), 0);
+		for (size_t index = begin; index <= end; ++index)
+		{
+			child[index] = parent[index];
+			in_segment_[parent[index]] = 1;
+		}
+		//fill the positions after end (wrapping around) with other_parent's cities in the order they appear after end
+		size_t write_index = end + 1;
+		size_t read_index = end + 1;
+		for (size_t offset = 0; offset < route_length_; ++offset, ++read_index)
+		{
+			if (read_index == route_length_)
+			{
+				read_index = 0;
+			}
+			uint32_t city = other_parent[read_index];
+			if (in_segment_[city])
+			{
+				continue;
+			}
+			if (write_index == route_length_)
+			{
+				write_index = 0;
+			}
+			child[write_index++] = city;
+		}
+		for (uint32_t index = 0; index < route_length_; ++index)
+		{
+			position[child[index]] = index;
+		}
+	}
+	void AddEdge(uint32_t from, uint32_t to)
+	{
+		uint32_t* edges = &adjacency_[from * kMaxEdges];
+		for (uint8_t edge_index = 0; edge_index < num_adjacent_[from]; ++edge_index)
+		{
+			if (edges[edge_index] == to)
+			{
+				return;
+			}
+		}
+		edges[num_adjacent_[from]++] = to;
+	}
+	//the edge map is over the closed tours, which both start and end at city 0
+	void BuildEdgeMap(const uint32_t* parent1, const uint32_t* parent2)
+	{
+		std::fill(num_adjacent_.begin(), num_adjacent_.end(), 0);
+		const uint32_t* parents[2] = { parent1, parent2 };
+		for (uint32_t parent_index = 0; parent_index < 2; ++parent_index)
+		{
+			uint32_t last_city = 0;
+			for (size_t index = 0; index < route_length_; ++index)
+			{
+				AddEdge(last_city, parents[parent_index][index]);
+				AddEdge(parents[parent_index][index], last_city);
+				last_city = parents[parent_index][index];
+			}
+			AddEdge(last_city, 0);
+			AddEdge(0, last_city);
+		}
+	}
+	void EdgeRecombinationChild(uint32_t* child, uint32_t* position)
+	{
+		//unused_ holds the cities not yet placed, unused_position_ is its position index so cities can be removed in O(1)
+		size_t num_unused = route_length_;
+		for (uint32_t city = 1; city <= route_length_; ++city)
+		{
+			unused_[city - 1] = city;
+			unused_position_[city] = city - 1;
+		}
+		//city 0 is used since every tour starts there
+		unused_position_[0] = (uint32_t)route_length_;
+		uint32_t current_city = 0;
+		for (size_t index = 0; index < route_length_; ++index)
+		{
+			//move to the unused neighbor which has the fewest unused neighbors itself, breaking ties randomly
+			uint32_t next_city = 0;
+			size_t fewest_neighbors = kMaxEdges + 1;
+			uint32_t num_ties = 0;
+			const uint32_t* edges = &adjacency_[current_city * kMaxEdges];
+			for (uint8_t edge_index = 0; edge_index < num_adjacent_[current_city]; ++edge_index)
+			{
+				uint32_t neighbor = edges[edge_index];
+				if (!IsUnused(neighbor, num_unused))
+				{
+					continue;
+				}
+				size_t num_neighbors = CountUnusedNeighbors(neighbor, num_unused);
+				if (num_neighbors < fewest_neighbors)
+				{
+					fewest_neighbors = num_neighbors;
+					next_city = neighbor;
+					num_ties = 1;
+				} else if (num_neighbors == fewest_neighbors)
+				{
+					//reservoir sample among the tied neighbors
+					num_ties++;
+					if (rng::randull(0, num_ties - 1) == 0)
+					{
+						next_city = neighbor;
+					}
+				}
+			}
+			if (num_ties == 0)
+			{
+				//dead end, jump to a random unused city
+				next_city = unused_[rng::randull(0, num_unused - 1)];
+			}
+			//remove next_city from the unused list by swapping the last unused city into its slot
+			uint32_t slot = unused_position_[next_city];
+			uint32_t last_unused = unused_[num_unused - 1];
+			unused_[slot] = last_unused;
+			unused_position_[last_unused] = slot;
+			unused_[num_unused - 1] = next_city;
+			unused_position_[next_city] = (uint32_t)(num_unused - 1);
+			num_unused--;
+			child[index] = next_city;
+			position[next_city] = (uint32_t)index;
+			current_city = next_city;
+		}
+	}
+	inline bool IsUnused(uint32_t city, size_t num_unused) const
+	{
+		return unused_position_[city] < num_unused;
+	}
+	inline size_t CountUnusedNeighbors(uint32_t city, size_t num_unused) const
+	{
+		size_t count = 0;
+		const uint32_t* edges = &adjacency_[city * kMaxEdges];
+		for (uint8_t edge_index = 0; edge_index < num_adjacent_[city]; ++edge_index)
+		{
+			if (IsUnused(edges[edge_index], num_unused))
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+	Operator operator_;
+	size_t route_length_;
+	//scratch copies of the parents for the operators which can't work in place
+	std::vector<uint32_t> parent1_;
+	std::vector<uint32_t> parent2_;
+	std::vector<uint8_t> in_segment_;
+	std::vector<uint32_t> adjacency_;
+	std::vector<uint8_t> num_adjacent_;
+	std::vector<uint32_t> unused_;
+	std::vector<uint32_t> unused_position_;
+};
+#endif //CS776_CROSSOVER_H_
@@ -0,0 +1,259 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_DISTANCE_ORACLE_H_
+#define CS776_DISTANCE_ORACLE_H_
+#include "ionlib\log.h"
+#include "ionlib\geometry.h"
+#include <vector>
+#include <cmath>
+
+/*
+DistanceOracle answers "how far is it from city a to city b" using the TSPLIB
+rounded integer edge weights. The weights come from one of the TSPLIB metrics
+(see Metric) applied to the coordinates, or from an explicit matrix.
+
+The weights are computed once when the oracle is built so the GA never has to
+call sqrt in its inner loop. How they are stored depends on how much memory
+the caller is willing to spend:
+  * DENSE_MATRIX stores all n*n weights, which is the fastest lookup
+  * TRIANGULAR_MATRIX stores only the n*(n-1)/2 weights below the diagonal,
+    since the distances are symmetric this halves the memory
+  * ON_THE_FLY stores nothing and computes the weight from the coordinates on
+    every lookup, which is only used when neither matrix fits in the budget.
+    Explicit weights can't be recomputed, so they are always kept in a matrix
+*/
+class DistanceOracle
+{
+public:
+	enum StorageMode
+	{
+		DENSE_MATRIX,
+		TRIANGULAR_MATRIX,
+		ON_THE_FLY
+	};
+	//the TSPLIB EDGE_WEIGHT_TYPEs which are supported
+	enum Metric
+	{
+		EUC_2D,
+		CEIL_2D,
+		ATT,
+		GEO,
+		EXPLICIT
+	};
+	//128 MB is enough for a dense 5792 city matrix or a triangular 8192 city matrix
+	static const size_t kDefaultMemoryBudget = 128 * 1024 * 1024;
+
+	DistanceOracle()
+	{
+		mode_ = ON_THE_FLY;
+		metric_ = EUC_2D;
+		num_cities_ = 0;
+	}
+	DistanceOracle(const std::vector<ion::Point2<double>>& cities, size_t memory_budget = kDefaultMemoryBudget)
+	{
+		Build(cities, memory_budget);
+	}
+	void Build(const std::vector<ion::Point2<double>>& cities, size_t memory_budget = kDefaultMemoryBudget)
+	{
+		Build(cities, EUC_2D, memory_budget);
+	}
+	void Build(const std::vector<ion::Point2<double>>& cities, Metric metric, size_t memory_budget = kDefaultMemoryBudget)
+	{
+		LOGASSERT(metric != EXPLICIT);
+		cities_ = cities;
+		metric_ = metric;
+		num_cities_ = cities.size();
+		weights_.clear();
+		geo_.clear();
+		if (metric == GEO)
+		{
+			//the trig of each city's latitude and longitude is done once rather than for every pair
+			geo_.resize(num_cities_);
+			for (size_t city = 0; city < num_cities_; ++city)
+			{
+				geo_[city].x1_ = GeoRadians(cities[city].x1_);
+				geo_[city].x2_ = GeoRadians(cities[city].x2_);
+			}
+		}
+		size_t dense_bytes = num_cities_ * num_cities_ * sizeof(int32_t);
+		size_t triangular_bytes = (num_cities_ * (num_cities_ - 1) / 2) * sizeof(int32_t);
+		if (dense_bytes <= memory_budget)
+		{
+			mode_ = DENSE_MATRIX;
+			weights_.resize(num_cities_ * num_cities_);
+			for (size_t from = 0; from < num_cities_; ++from)
+			{
+				weights_[from * num_cities_ + from] = 0;
+				for (size_t to = 0; to < from; ++to)
+				{
+					int32_t weight = ComputeWeight((uint32_t)from, (uint32_t)to);
+					weights_[from * num_cities_ + to] = weight;
+					weights_[to * num_cities_ + from] = weight;
+				}
+			}
+		} else if (triangular_bytes <= memory_budget)
+		{
+			mode_ = TRIANGULAR_MATRIX;
+			weights_.resize(num_cities_ * (num_cities_ - 1) / 2);
+			for (size_t from = 1; from < num_cities_; ++from)
+			{
+				for (size_t to = 0; to < from; ++to)
+				{
+					weights_[TriangularIndex(from, to)] = ComputeWeight((uint32_t)from, (uint32_t)to);
+				}
+			}
+		} else
+		{
+			mode_ = ON_THE_FLY;
+			LOGINFO("Distance matrix for %zu cities exceeds the %zu byte budget, computing distances on the fly", num_cities_, memory_budget);
+		}
+	}
+	/*
+	  Builds the oracle from an explicit row major num_cities x num_cities
+	  matrix, e.g. a TSPLIB EDGE_WEIGHT_SECTION. The matrix must be symmetric.
+	*/
+	void BuildExplicit(const std::vector<int32_t>& weights, size_t num_cities)
+	{
+		LOGASSERT(weights.size() == num_cities * num_cities);
+		cities_.clear();
+		geo_.clear();
+		metric_ = EXPLICIT;
+		mode_ = DENSE_MATRIX;
+		num_cities_ = num_cities;
+		weights_ = weights;
+	}
+	//The weight between two cities under the TSPLIB definition of the metric
+	inline int32_t ComputeWeight(uint32_t from, uint32_t to) const
+	{
+		switch (metric_)
+		{
+		case EUC_2D:
+			//euclidean distance rounded to the nearest integer
+			return (int32_t)std::round(cities_[from].distance(cities_[to]));
+		case CEIL_2D:
+			return (int32_t)std::ceil(cities_[from].distance(cities_[to]));
+		case ATT:
+		{
+			//pseudo-euclidean, the distance over sqrt(10) rounded up
+			double dx = cities_[from].x1_ - cities_[to].x1_;
+			double dy = cities_[from].x2_ - cities_[to].x2_;
+			double distance = std::sqrt((dx * dx + dy * dy) / 10.0);
+			int32_t rounded = (int32_t)std::round(distance);
+			return rounded < distance ? rounded + 1 : rounded;
+		}
+		case GEO:
+		{
+			//great circle distance in km on the TSPLIB idealized earth
+			const double kEarthRadius = 6378.388;
+			double q1 = std::cos(geo_[from].x2_ - geo_[to].x2_);
+			double q2 = std::cos(geo_[from].x1_ - geo_[to].x1_);
+			double q3 = std::cos(geo_[from].x1_ + geo_[to].x1_);
+			return (int32_t)(kEarthRadius * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+		}
+		default:
+			return weights_[from * num_cities_ + to];
+		}
+	}
+	inline int32_t Distance(uint32_t from, uint32_t to) const
+	{
+		switch (mode_)
+		{
+		case DENSE_MATRIX:
+			return weights_[from * num_cities_ + to];
+		case TRIANGULAR_MATRIX:
+			if (from == to)
+			{
+				return 0;
+			}
+			return from > to ? weights_[TriangularIndex(from, to)] : weights_[TriangularIndex(to, from)];
+		default:
+			return ComputeWeight(from, to);
+		}
+	}
+	/*
+	  Computes the length of the closed tour which starts at depot, visits
+	  [first, last) in order, and returns to depot.
+
+	  The storage mode is checked once up front instead of once per edge so the
+	  dense case compiles down to a tight loop of loads and adds.
+	*/
+	template<typename CityIterator>
+	int64_t ClosedTourLength(uint32_t depot, CityIterator first, CityIterator last) const
+	{
+		int64_t tour_length = 0;
+		uint32_t last_city = depot;
+		if (mode_ == DENSE_MATRIX)
+		{
+			const int32_t* weights = weights_.data();
+			for (CityIterator city_it = first; city_it != last; ++city_it)
+			{
+				tour_length += weights[last_city * num_cities_ + *city_it];
+				last_city = *city_it;
+			}
+			tour_length += weights[last_city * num_cities_ + depot];
+		} else
+		{
+			for (CityIterator city_it = first; city_it != last; ++city_it)
+			{
+				tour_length += Distance(last_city, *city_it);
+				last_city = *city_it;
+			}
+			tour_length += Distance(last_city, depot);
+		}
+		return tour_length;
+	}
+	StorageMode GetMode() const
+	{
+		return mode_;
+	}
+	Metric GetMetric() const
+	{
+		return metric_;
+	}
+	size_t GetNumCities() const
+	{
+		return num_cities_;
+	}
+	const std::vector<ion::Point2<double>>& GetCities() const
+	{
+		return cities_;
+	}
+private:
+	//index of (from, to) in the packed lower triangle, requires from > to
+	static inline size_t TriangularIndex(size_t from, size_t to)
+	{
+		return from * (from - 1) / 2 + to;
+	}
+	//TSPLIB GEO coordinates are DDD.MM, degrees then minutes
+	static double GeoRadians(double coordinate)
+	{
+		//TSPLIB uses this value of pi, using a more precise one changes some of the published optimal lengths
+		const double kPi = 3.141592;
+		double degrees = (double)(int64_t)coordinate;
+		double minutes = coordinate - degrees;
+		return kPi * (degrees + 5.0 * minutes / 3.0) / 180.0;
+	}
+	StorageMode mode_;
+	Metric metric_;
+	size_t num_cities_;
+	std::vector<ion::Point2<double>> cities_;
+	//latitude (x1_) and longitude (x2_) in radians for the GEO metric
+	std::vector<ion::Point2<double>> geo_;
+	std::vector<int32_t> weights_;
+};
+#endif //CS776_DISTANCE_ORACLE_H_
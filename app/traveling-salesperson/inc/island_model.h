@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_ISLAND_MODEL_H_
+#define CS776_ISLAND_MODEL_H_
+#include "ionlib\log.h"
+#include "random.h"
+#include "spsc_queue.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+//What one island did during IslandModel::Run
+typedef struct island_report_s
+{
+	uint32_t generations;
+	double best_length;
+	//wall time from the start of the run until best_length was first found
+	double seconds_to_best;
+	uint64_t num_immigrants;
+	//emigrants which were thrown away because the destination's queue was full
+	uint64_t num_dropped_emigrants;
+	std::vector<uint32_t> best_route;
+} island_report_t;
+
+/*
+IslandModel evolves several TSP populations at once, one per thread, and
+every migration_interval generations sends each island's elite route to its
+neighbors. An arriving route replaces the least fit member of the receiving
+island.
+
+The neighbors are given by the topology:
+  * RING: island i sends to island i+1, wrapping around at the end
+  * TORUS: the islands are laid out on the most square rows x columns grid
+    that holds them, and each island sends to the island to its right and
+    the island below it, wrapping around at the edges
+
+Every directed edge of the topology has its own SpscQueue, so migration is
+lock-free and no island ever waits for another. Since the islands don't
+synchronize, when a migrant arrives depends on how the threads are
+scheduled, so unlike single population trials a run can't be reproduced
+exactly from its seed.
+
+IslandGA must provide NextGeneration, GetMaxFitness (1/route length),
+CopyEliteMember(route) and ImportMember(route).
+*/
+template<typename IslandGA>
+class IslandModel
+{
+public:
+	typedef std::vector<uint32_t> Route;
+	enum Topology
+	{
+		RING,
+		TORUS
+	};
+	static bool ParseTopology(const std::string& name, Topology* topology)
+	{
+		if (name == "ring")
+		{
+			*topology = RING;
+		} else if (name == "torus")
+		{
+			*topology = TORUS;
+		} else
+		{
+			return false;
+		}
+		return true;
+	}
+	IslandModel(uint32_t num_islands, Topology topology, uint32_t migration_interval, size_t route_length)
+	{
+		LOGASSERT(num_islands > 0);
+		num_islands_ = num_islands;
+		migration_interval_ = std::max(1u, migration_interval);
+		route_length_ = route_length;
+		inbound_.resize(num_islands);
+		outbound_.resize(num_islands);
+		if (topology == RING)
+		{
+			for (uint32_t island = 0; island < num_islands; ++island)
+			{
+				AddEdge(island, (island + 1) % num_islands);
+			}
+		} else
+		{
+			//use the largest number of rows which evenly divides the islands and isn't more than the columns
+			uint32_t rows = (uint32_t)std::sqrt((double)num_islands);
+			while (num_islands % rows != 0)
+			{
+				rows--;
+			}
+			uint32_t columns = num_islands / rows;
+			for (uint32_t row = 0; row < rows; ++row)
+			{
+				for (uint32_t column = 0; column < columns; ++column)
+				{
+					uint32_t island = row * columns + column;
+					AddEdge(island, row * columns + (column + 1) % columns);
+					AddEdge(island, ((row + 1) % rows) * columns + column);
+				}
+			}
+		}
+		reports_.resize(num_islands);
+	}
+	/*
+	  Runs every island on its own thread until one of them finds a route of
+	  at most target_length (0 to never stop early) or each has run
+	  max_generations generations.
+
+	  make_island(island) must return a std::unique_ptr<IslandGA>. It is called
+	  on the island's thread after that thread's rng stream has been seeded
+	  with rng::StreamSeed(seed, island), so the initial populations are
+	  reproducible even though the migrations aren't.
+	*/
+	template<typename MakeIsland>
+	void Run(uint64_t seed, uint32_t max_generations, double target_length, MakeIsland make_island)
+	{
+		stop_ = false;
+		seconds_to_target_ = -1.0;
+		start_ = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (uint32_t island = 0; island < num_islands_; ++island)
+		{
+			threads.push_back(std::thread([&, island]()
+			{
+				rng::Seed(rng::StreamSeed(seed, island));
+				std::unique_ptr<IslandGA> ga = make_island(island);
+				RunIsland(island, *ga, max_generations, target_length);
+			}));
+		}
+		for (std::vector<std::thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); ++thread_it)
+		{
+			thread_it->join();
+		}
+		elapsed_seconds_ = Elapsed();
+		//the first island to reach the target stops the rest, so the earliest of their times is the run's time to target
+		for (std::vector<island_report_t>::const_iterator report_it = reports_.begin(); report_it != reports_.end(); ++report_it)
+		{
+			if (target_length > 0.0 && report_it->best_length <= target_length && (seconds_to_target_ < 0.0 || report_it->seconds_to_best < seconds_to_target_))
+			{
+				seconds_to_target_ = report_it->seconds_to_best;
+			}
+		}
+	}
+	const std::vector<island_report_t>& GetIslandReports() const
+	{
+		return reports_;
+	}
+	//the report of the island which found the shortest route
+	const island_report_t& GetGlobalBest() const
+	{
+		size_t best_island = 0;
+		for (size_t island = 1; island < reports_.size(); ++island)
+		{
+			if (reports_[island].best_length < reports_[best_island].best_length)
+			{
+				best_island = island;
+			}
+		}
+		return reports_[best_island];
+	}
+	//seconds from the start of the run until the target was reached, or a negative number if it never was
+	double GetSecondsToTarget() const
+	{
+		return seconds_to_target_;
+	}
+	double GetElapsedSeconds() const
+	{
+		return elapsed_seconds_;
+	}
+	uint32_t GetNumIslands() const
+	{
+		return num_islands_;
+	}
+	size_t GetNumEdges() const
+	{
+		return queues_.size();
+	}
+private:
+	//how many emigrants an edge can hold before new ones are dropped
+	static const size_t kQueueCapacity = 4;
+	void AddEdge(uint32_t from, uint32_t to)
+	{
+		if (from == to)
+		{
+			return;
+		}
+		//small grids (e.g. a torus with two rows) can produce the same edge twice
+		for (std::vector<size_t>::const_iterator edge_it = outbound_[from].begin(); edge_it != outbound_[from].end(); ++edge_it)
+		{
+			if (destination_[*edge_it] == to)
+			{
+				return;
+			}
+		}
+		size_t edge = queues_.size();
+		queues_.push_back(std::unique_ptr<SpscQueue<Route>>(new SpscQueue<Route>(kQueueCapacity, Route(route_length_))));
+		destination_.push_back(to);
+		outbound_[from].push_back(edge);
+		inbound_[to].push_back(edge);
+	}
+	void RunIsland(uint32_t island, IslandGA& ga, uint32_t max_generations, double target_length)
+	{
+		island_report_t& report = reports_[island];
+		report.generations = 0;
+		report.best_length = std::numeric_limits<double>::max();
+		report.seconds_to_best = 0.0;
+		report.num_immigrants = 0;
+		report.num_dropped_emigrants = 0;
+		//these are sized once, so migrating doesn't allocate
+		Route emigrant(route_length_);
+		Route immigrant(route_length_);
+		report.best_route.resize(route_length_);
+		for (uint32_t generation = 1; generation <= max_generations && !stop_.load(std::memory_order_relaxed); ++generation)
+		{
+			ga.NextGeneration();
+			report.generations = generation;
+			double length = 1.0 / ga.GetMaxFitness();
+			if (length < report.best_length)
+			{
+				report.best_length = length;
+				report.seconds_to_best = Elapsed();
+				ga.CopyEliteMember(&report.best_route);
+				if (length <= target_length)
+				{
+					LOGINFO("Island %u found a route of length %lf after %u generations", island, length, generation);
+					stop_ = true;
+					break;
+				}
+			}
+			if (generation % migration_interval_ != 0)
+			{
+				continue;
+			}
+			if (!outbound_[island].empty())
+			{
+				ga.CopyEliteMember(&emigrant);
+			}
+			for (std::vector<size_t>::const_iterator edge_it = outbound_[island].begin(); edge_it != outbound_[island].end(); ++edge_it)
+			{
+				if (!queues_[*edge_it]->TryPush(emigrant))
+				{
+					report.num_dropped_emigrants++;
+				}
+			}
+			for (std::vector<size_t>::const_iterator edge_it = inbound_[island].begin(); edge_it != inbound_[island].end(); ++edge_it)
+			{
+				while (queues_[*edge_it]->TryPop(immigrant))
+				{
+					ga.ImportMember(immigrant);
+					report.num_immigrants++;
+				}
+			}
+		}
+	}
+	double Elapsed() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	}
+	uint32_t num_islands_;
+	uint32_t migration_interval_;
+	size_t route_length_;
+	//one queue per directed edge of the topology, destination_[e] is the island edge e sends to
+	std::vector<std::unique_ptr<SpscQueue<Route>>> queues_;
+	std::vector<uint32_t> destination_;
+	//the edges leaving and entering each island
+	std::vector<std::vector<size_t>> outbound_;
+	std::vector<std::vector<size_t>> inbound_;
+	std::vector<island_report_t> reports_;
+	//set by the first island to reach the target so the others stop too
+	std::atomic<bool> stop_;
+	std::chrono::steady_clock::time_point start_;
+	double elapsed_seconds_;
+	double seconds_to_target_;
+};
+#endif //CS776_ISLAND_MODEL_H_
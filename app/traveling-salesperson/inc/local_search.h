@@ -0,0 +1,375 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_LOCAL_SEARCH_H_
+#define CS776_LOCAL_SEARCH_H_
+#include "ionlib\log.h"
+#include "distance_oracle.h"
+#include "candidate_neighbors.h"
+#include <vector>
+#include <algorithm>
+
+/*
+LocalSearch improves a single route with 2-opt and Or-opt moves.
+
+Only moves which create an edge from a city to one of its candidate
+neighbors are considered, and the neighbors are sorted closest first, so the
+scan for a city stops as soon as the new edge would be longer than the edge
+it replaces. Each city has a don't-look bit: a city is only looked at again
+once one of the edges next to it has changed, which is tracked by keeping
+the cities whose bit is clear in a queue.
+
+The moves are:
+  * 2-opt: remove two edges and reconnect the two paths the other way,
+    which reverses one of them. The shorter of the two is reversed
+  * Or-opt: move a segment of 1 to 3 cities to between two other adjacent
+    cities, in either orientation
+
+The search works on a copy of the closed tour (city 0 included) which is
+rotated back so that it starts at city 0 when it is written out. All scratch
+space is sized in Init, so improving a route doesn't allocate.
+*/
+class LocalSearch
+{
+public:
+	LocalSearch()
+	{
+		oracle_ = NULL;
+		neighbors_ = NULL;
+		num_cities_ = 0;
+		queue_head_ = 0;
+		queue_size_ = 0;
+	}
+	void Init(const DistanceOracle* oracle, const CandidateNeighbors* neighbors)
+	{
+		oracle_ = oracle;
+		neighbors_ = neighbors;
+		num_cities_ = (uint32_t)oracle->GetNumCities();
+		tour_.resize(num_cities_);
+		position_.resize(num_cities_);
+		queue_.resize(num_cities_);
+		in_queue_.resize(num_cities_);
+	}
+	/*
+	  Improves route (the route_length cities visited after city 0) in place
+	  until no improving move is left or max_moves moves have been made.
+	  route_position is the route's position index and is kept in sync.
+
+	  Returns the change in the route's length, which is never positive, and
+	  adds the number of moves made to *num_moves.
+	*/
+	int64_t Improve(uint32_t* route, uint32_t* route_position, size_t max_moves, size_t* num_moves)
+	{
+		if (num_cities_ < 5)
+		{
+			return 0;
+		}
+		tour_[0] = 0;
+		position_[0] = 0;
+		for (uint32_t index = 1; index < num_cities_; ++index)
+		{
+			tour_[index] = route[index - 1];
+			position_[route[index - 1]] = index;
+		}
+		queue_head_ = 0;
+		queue_size_ = 0;
+		std::fill(in_queue_.begin(), in_queue_.end(), 0);
+		for (uint32_t index = 0; index < num_cities_; ++index)
+		{
+			Push(tour_[index]);
+		}
+		int64_t delta = 0;
+		size_t moves = 0;
+		while (queue_size_ > 0 && moves < max_moves)
+		{
+			uint32_t city = Pop();
+			int64_t gain = TwoOpt(city);
+			if (gain == 0)
+			{
+				gain = OrOpt(city);
+			}
+			if (gain > 0)
+			{
+				delta -= gain;
+				moves++;
+				//the move may have opened up another one around this city
+				Push(city);
+			}
+		}
+		//write the tour back starting after city 0
+		uint32_t start = position_[0];
+		for (uint32_t index = 0; index + 1 < num_cities_; ++index)
+		{
+			uint32_t city = tour_[Wrap(start + 1 + index)];
+			route[index] = city;
+			route_position[city] = index;
+		}
+		*num_moves += moves;
+		return delta;
+	}
+private:
+	inline int32_t Distance(uint32_t from, uint32_t to) const
+	{
+		return oracle_->Distance(from, to);
+	}
+	inline uint32_t Wrap(uint32_t index) const
+	{
+		return index >= num_cities_ ? index - num_cities_ : index;
+	}
+	inline uint32_t Next(uint32_t city) const
+	{
+		return tour_[Wrap(position_[city] + 1)];
+	}
+	inline uint32_t Prev(uint32_t city) const
+	{
+		return tour_[Wrap(position_[city] + num_cities_ - 1)];
+	}
+	//true if city is one of the length cities starting at first going forward
+	inline bool InSegment(uint32_t city, uint32_t first, uint32_t length) const
+	{
+		return Wrap(position_[city] + num_cities_ - position_[first]) < length;
+	}
+	inline void Push(uint32_t city)
+	{
+		if (in_queue_[city])
+		{
+			return;
+		}
+		in_queue_[city] = 1;
+		queue_[Wrap(queue_head_ + queue_size_)] = city;
+		queue_size_++;
+	}
+	inline uint32_t Pop()
+	{
+		uint32_t city = queue_[queue_head_];
+		queue_head_ = Wrap(queue_head_ + 1);
+		queue_size_--;
+		in_queue_[city] = 0;
+		return city;
+	}
+	/*
+	  Tries the 2-opt moves which add the edge (a, c) for a candidate neighbor
+	  c, removing the edge from a to its successor (or predecessor) and the
+	  matching edge at c. Makes the first improving move found and returns its
+	  gain, or 0 if there is none.
+	*/
+	int64_t TwoOpt(uint32_t a)
+	{
+		const uint32_t* neighbors = neighbors_->GetNeighbors(a);
+		for (uint32_t direction = 0; direction < 2; ++direction)
+		{
+			uint32_t b = (direction == 0) ? Next(a) : Prev(a);
+			int32_t removed_ab = Distance(a, b);
+			for (size_t neighbor_index = 0; neighbor_index < neighbors_->GetK(); ++neighbor_index)
+			{
+				uint32_t c = neighbors[neighbor_index];
+				int32_t added_ac = Distance(a, c);
+				if (added_ac >= removed_ab)
+				{
+					break;
+				}
+				uint32_t d = (direction == 0) ? Next(c) : Prev(c);
+				if (c == b || d == a)
+				{
+					continue;
+				}
+				int64_t gain = (int64_t)removed_ab + Distance(c, d) - added_ac - Distance(b, d);
+				if (gain <= 0)
+				{
+					continue;
+				}
+				//forwards the tour is a b .. c d (or b a .. d c), reversing the inner path gives a c .. b d
+				if (direction == 0)
+				{
+					ReversePath(b, c);
+				} else
+				{
+					ReversePath(a, d);
+				}
+				Push(a);
+				Push(b);
+				Push(c);
+				Push(d);
+				return gain;
+			}
+		}
+		return 0;
+	}
+	/*
+	  Tries to move the segments of 1 to 3 cities starting at first to next to
+	  one of the candidate neighbors of either end of the segment. Makes the
+	  first improving move found and returns its gain, or 0 if there is none.
+	*/
+	int64_t OrOpt(uint32_t first)
+	{
+		const uint32_t kMaxSegmentLength = 3;
+		uint32_t last = first;
+		for (uint32_t length = 1; length <= kMaxSegmentLength && length + 3 <= num_cities_; ++length)
+		{
+			if (length > 1)
+			{
+				last = Next(last);
+			}
+			uint32_t before = Prev(first);
+			uint32_t after = Next(last);
+			int64_t removal_gain = (int64_t)Distance(before, first) + Distance(last, after) - Distance(before, after);
+			if (removal_gain <= 0)
+			{
+				continue;
+			}
+			uint32_t ends[2] = { first, last };
+			for (uint32_t end_index = 0; end_index < 2; ++end_index)
+			{
+				uint32_t end = ends[end_index];
+				uint32_t other_end = ends[1 - end_index];
+				const uint32_t* neighbors = neighbors_->GetNeighbors(end);
+				for (size_t neighbor_index = 0; neighbor_index < neighbors_->GetK(); ++neighbor_index)
+				{
+					uint32_t c = neighbors[neighbor_index];
+					int32_t added_c_end = Distance(c, end);
+					if (added_c_end >= removal_gain)
+					{
+						break;
+					}
+					if (InSegment(c, first, length))
+					{
+						continue;
+					}
+					//insert between c and either of its neighbors, with end next to c
+					uint32_t sides[2] = { Next(c), Prev(c) };
+					for (uint32_t side_index = 0; side_index < 2; ++side_index)
+					{
+						uint32_t y = sides[side_index];
+						if (InSegment(y, first, length))
+						{
+							continue;
+						}
+						int64_t gain = removal_gain - ((int64_t)added_c_end + Distance(other_end, y) - Distance(c, y));
+						if (gain <= 0)
+						{
+							continue;
+						}
+						MoveSegment(first, length, c, y, end);
+						Push(before);
+						Push(after);
+						Push(first);
+						Push(last);
+						Push(c);
+						Push(y);
+						return gain;
+					}
+				}
+			}
+		}
+		return 0;
+	}
+	/*
+	  Reverses the path which goes forward from city u to city v. If that path
+	  is more than half the tour the rest of the tour is reversed instead,
+	  which gives the same cycle traversed the other way around.
+	*/
+	void ReversePath(uint32_t u, uint32_t v)
+	{
+		uint32_t left = position_[u];
+		uint32_t right = position_[v];
+		uint32_t length = Wrap(right + num_cities_ - left) + 1;
+		if (2 * length > num_cities_)
+		{
+			left = Wrap(right + 1);
+			right = Wrap(position_[u] + num_cities_ - 1);
+			length = num_cities_ - length;
+		}
+		for (uint32_t swap_index = 0; swap_index < length / 2; ++swap_index)
+		{
+			uint32_t left_city = tour_[left];
+			uint32_t right_city = tour_[right];
+			tour_[left] = right_city;
+			position_[right_city] = left;
+			tour_[right] = left_city;
+			position_[left_city] = right;
+			left = Wrap(left + 1);
+			right = Wrap(right + num_cities_ - 1);
+		}
+	}
+	/*
+	  Moves the length cities starting at first to between the adjacent cities
+	  c and y, so that end (one end of the segment) is next to c. The cities
+	  between the segment and its destination are shifted over by length,
+	  going whichever way around the tour has fewer of them.
+	*/
+	void MoveSegment(uint32_t first, uint32_t length, uint32_t c, uint32_t y, uint32_t end)
+	{
+		uint32_t segment[3];
+		for (uint32_t index = 0; index < length; ++index)
+		{
+			segment[index] = tour_[Wrap(position_[first] + index)];
+		}
+		//x and z are the new neighbors of the segment in forward order
+		uint32_t x = (Next(c) == y) ? c : y;
+		uint32_t z = (x == c) ? y : c;
+		bool reverse = (x == c) ? (end != first) : (end == first);
+		uint32_t segment_start = position_[first];
+		uint32_t after_position = Wrap(segment_start + length);
+		//cities from the one after the segment forward to x, and from z forward to the one before the segment
+		uint32_t num_forward = Wrap(position_[x] + num_cities_ - after_position) + 1;
+		uint32_t num_backward = num_cities_ - length - num_forward;
+		uint32_t write_position;
+		if (num_forward <= num_backward)
+		{
+			//shift the forward cities back over the segment, then put the segment after them
+			for (uint32_t index = 0; index < num_forward; ++index)
+			{
+				uint32_t city = tour_[Wrap(after_position + index)];
+				uint32_t new_position = Wrap(segment_start + index);
+				tour_[new_position] = city;
+				position_[city] = new_position;
+			}
+			write_position = Wrap(segment_start + num_forward);
+		} else
+		{
+			//shift the backward cities forward over the segment, then put the segment before them
+			uint32_t z_position = position_[z];
+			for (uint32_t index = num_backward; index > 0; --index)
+			{
+				uint32_t city = tour_[Wrap(z_position + index - 1)];
+				uint32_t new_position = Wrap(z_position + index - 1 + length);
+				tour_[new_position] = city;
+				position_[city] = new_position;
+			}
+			write_position = z_position;
+		}
+		for (uint32_t index = 0; index < length; ++index)
+		{
+			uint32_t city = reverse ? segment[length - 1 - index] : segment[index];
+			uint32_t new_position = Wrap(write_position + index);
+			tour_[new_position] = city;
+			position_[city] = new_position;
+		}
+	}
+	const DistanceOracle* oracle_;
+	const CandidateNeighbors* neighbors_;
+	uint32_t num_cities_;
+	//the closed tour being improved and its position index
+	std::vector<uint32_t> tour_;
+	std::vector<uint32_t> position_;
+	//ring buffer of the cities whose don't-look bit is clear, in_queue_[c] is set while c is in it
+	std::vector<uint32_t> queue_;
+	std::vector<uint8_t> in_queue_;
+	uint32_t queue_head_;
+	uint32_t queue_size_;
+};
+#endif //CS776_LOCAL_SEARCH_H_
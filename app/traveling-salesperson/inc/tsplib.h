@@ -0,0 +1,520 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_TSPLIB_H_
+#define CS776_TSPLIB_H_
+#include "ionlib\log.h"
+#include "ionlib\geometry.h"
+#include "distance_oracle.h"
+#include "mapped_file.h"
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <cmath>
+
+//A symmetric TSP instance as described by a TSPLIB file
+typedef struct tsplib_instance_s
+{
+	std::string name;
+	size_t dimension;
+	DistanceOracle::Metric metric;
+	//from NODE_COORD_SECTION, or DISPLAY_DATA_SECTION if there is no NODE_COORD_SECTION. Empty if there is neither
+	std::vector<ion::Point2<double>> cities;
+	//the full row major dimension x dimension matrix of EXPLICIT instances
+	std::vector<int32_t> weights;
+} tsplib_instance_t;
+
+/*
+TsplibScanner reads the tokens of a TSPLIB file straight out of memory. The
+numbers are converted by hand since that is where almost all of the time
+goes on large instances, and unlike strtod they don't depend on the locale
+or need a terminated string.
+*/
+class TsplibScanner
+{
+public:
+	TsplibScanner(const char* begin, const char* end)
+	{
+		current_ = begin;
+		end_ = end;
+	}
+	//skips whitespace, including line breaks, and returns true if there is nothing left
+	bool AtEnd()
+	{
+		SkipSpace();
+		return current_ == end_;
+	}
+	/*
+	  Reads a header keyword such as "DIMENSION" and, unless it names a
+	  section, the value after it, e.g. "DIMENSION : 51" or "NAME: eil51".
+	  The value is the rest of the line with surrounding blanks removed.
+	*/
+	bool ReadKeyword(std::string* keyword, std::string* value)
+	{
+		SkipSpace();
+		const char* begin = current_;
+		while (current_ != end_ && (IsAlphanumeric(*current_) || *current_ == '_'))
+		{
+			current_++;
+		}
+		if (current_ == begin)
+		{
+			return false;
+		}
+		keyword->assign(begin, current_);
+		value->clear();
+		if (keyword->size() > 8 && keyword->compare(keyword->size() - 8, 8, "_SECTION") == 0)
+		{
+			return true;
+		}
+		SkipBlanks();
+		if (current_ != end_ && *current_ == ':')
+		{
+			current_++;
+			SkipBlanks();
+		}
+		begin = current_;
+		while (current_ != end_ && *current_ != '\n' && *current_ != '\r')
+		{
+			current_++;
+		}
+		const char* value_end = current_;
+		while (value_end != begin && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+		{
+			value_end--;
+		}
+		value->assign(begin, value_end);
+		return true;
+	}
+	//reads a whole number, fails without consuming anything if the next token isn't one
+	bool ReadInt(int64_t* value)
+	{
+		SkipSpace();
+		const char* cursor = current_;
+		bool negative = false;
+		if (cursor != end_ && (*cursor == '-' || *cursor == '+'))
+		{
+			negative = *cursor == '-';
+			cursor++;
+		}
+		const char* digits = cursor;
+		int64_t result = 0;
+		while (cursor != end_ && IsDigit(*cursor))
+		{
+			result = result * 10 + (*cursor - '0');
+			cursor++;
+		}
+		if (cursor == digits || (cursor != end_ && !IsSpace(*cursor)))
+		{
+			return false;
+		}
+		current_ = cursor;
+		*value = negative ? -result : result;
+		return true;
+	}
+	/*
+	  Reads a decimal number such as 12, -0.5 or 6.734e+03, failing without
+	  consuming anything if the next token isn't one. The first 19
+	  significant digits are accumulated exactly and scaled by a power of ten
+	  once, which is exact for the coordinates TSPLIB files contain.
+	*/
+	bool ReadDouble(double* value)
+	{
+		SkipSpace();
+		const char* cursor = current_;
+		bool negative = false;
+		if (cursor != end_ && (*cursor == '-' || *cursor == '+'))
+		{
+			negative = *cursor == '-';
+			cursor++;
+		}
+		uint64_t mantissa = 0;
+		int32_t exponent = 0;
+		int32_t significant_digits = 0;
+		bool any_digits = false;
+		while (cursor != end_ && IsDigit(*cursor))
+		{
+			AddDigit(*cursor - '0', &mantissa, &significant_digits, &exponent);
+			any_digits = true;
+			cursor++;
+		}
+		if (cursor != end_ && *cursor == '.')
+		{
+			cursor++;
+			while (cursor != end_ && IsDigit(*cursor))
+			{
+				if (AddDigit(*cursor - '0', &mantissa, &significant_digits, &exponent))
+				{
+					exponent--;
+				}
+				any_digits = true;
+				cursor++;
+			}
+		}
+		if (!any_digits)
+		{
+			return false;
+		}
+		if (cursor != end_ && (*cursor == 'e' || *cursor == 'E'))
+		{
+			cursor++;
+			bool negative_exponent = false;
+			if (cursor != end_ && (*cursor == '-' || *cursor == '+'))
+			{
+				negative_exponent = *cursor == '-';
+				cursor++;
+			}
+			if (cursor == end_ || !IsDigit(*cursor))
+			{
+				return false;
+			}
+			int32_t written_exponent = 0;
+			while (cursor != end_ && IsDigit(*cursor))
+			{
+				if (written_exponent < 10000)
+				{
+					written_exponent = written_exponent * 10 + (*cursor - '0');
+				}
+				cursor++;
+			}
+			exponent += negative_exponent ? -written_exponent : written_exponent;
+		}
+		if (cursor != end_ && !IsSpace(*cursor))
+		{
+			return false;
+		}
+		current_ = cursor;
+		double result = (double)mantissa;
+		if (exponent < 0)
+		{
+			result /= PowerOfTen(-exponent);
+		} else if (exponent > 0)
+		{
+			result *= PowerOfTen(exponent);
+		}
+		*value = negative ? -result : result;
+		return true;
+	}
+private:
+	static inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+	static inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+	}
+	static inline bool IsAlphanumeric(char c)
+	{
+		return IsDigit(c) || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+	}
+	//adds digit to the mantissa if it is one of the first 19 significant digits, otherwise scales the exponent instead
+	static inline bool AddDigit(int32_t digit, uint64_t* mantissa, int32_t* significant_digits, int32_t* exponent)
+	{
+		if (*significant_digits < 19)
+		{
+			*mantissa = *mantissa * 10 + digit;
+			if (*mantissa != 0)
+			{
+				(*significant_digits)++;
+			}
+			return true;
+		}
+		(*exponent)++;
+		return false;
+	}
+	static double PowerOfTen(int32_t exponent)
+	{
+		//every power up to 1e22 is exactly representable, so dividing or multiplying by one rounds only once
+		static const double kPowers[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		return exponent <= 22 ? kPowers[exponent] : std::pow(10.0, (double)exponent);
+	}
+	inline void SkipSpace()
+	{
+		while (current_ != end_ && IsSpace(*current_))
+		{
+			current_++;
+		}
+	}
+	inline void SkipBlanks()
+	{
+		while (current_ != end_ && (*current_ == ' ' || *current_ == '\t'))
+		{
+			current_++;
+		}
+	}
+	const char* current_;
+	const char* end_;
+};
+
+//reads the "id x y" lines of a NODE_COORD_SECTION or DISPLAY_DATA_SECTION into cities, which is sized to the dimension
+inline bool ReadTsplibCoordinates(TsplibScanner& scanner, const std::string& filename, std::vector<ion::Point2<double>>& cities)
+{
+	for (size_t line = 0; line < cities.size(); ++line)
+	{
+		int64_t id;
+		double x;
+		double y;
+		if (!scanner.ReadInt(&id) || !scanner.ReadDouble(&x) || !scanner.ReadDouble(&y))
+		{
+			LOGERROR("%s: coordinate %zu of %zu is missing or malformed", filename.c_str(), line + 1, cities.size());
+			return false;
+		}
+		if (id < 1 || (size_t)id > cities.size())
+		{
+			LOGERROR("%s: node %lld is outside of the dimension %zu", filename.c_str(), (long long)id, cities.size());
+			return false;
+		}
+		cities[id - 1] = ion::Point2<double>(x, y);
+	}
+	return true;
+}
+
+/*
+  Reads an EDGE_WEIGHT_SECTION in the given EDGE_WEIGHT_FORMAT into the full
+  symmetric matrix weights. Since the matrix is symmetric each *_COL format
+  lists the weights in the same order as the opposite *_ROW format.
+*/
+inline bool ReadTsplibWeights(TsplibScanner& scanner, const std::string& filename, const std::string& format, size_t dimension, std::vector<int32_t>& weights)
+{
+	bool full = format == "FULL_MATRIX";
+	bool upper = format == "UPPER_ROW" || format == "UPPER_DIAG_ROW" || format == "LOWER_COL" || format == "LOWER_DIAG_COL";
+	bool lower = format == "LOWER_ROW" || format == "LOWER_DIAG_ROW" || format == "UPPER_COL" || format == "UPPER_DIAG_COL";
+	bool diagonal = format.find("DIAG") != std::string::npos;
+	if (!full && !upper && !lower)
+	{
+		LOGERROR("%s: unsupported EDGE_WEIGHT_FORMAT %s", filename.c_str(), format.c_str());
+		return false;
+	}
+	weights.assign(dimension * dimension, 0);
+	for (size_t row = 0; row < dimension; ++row)
+	{
+		size_t first_column = 0;
+		size_t end_column = dimension;
+		if (upper)
+		{
+			first_column = diagonal ? row : row + 1;
+		} else if (lower)
+		{
+			end_column = diagonal ? row + 1 : row;
+		}
+		for (size_t column = first_column; column < end_column; ++column)
+		{
+			double weight;
+			if (!scanner.ReadDouble(&weight))
+			{
+				LOGERROR("%s: the edge weight of %zu to %zu is missing or malformed", filename.c_str(), row + 1, column + 1);
+				return false;
+			}
+			weights[row * dimension + column] = (int32_t)std::round(weight);
+			if (!full)
+			{
+				weights[column * dimension + row] = (int32_t)std::round(weight);
+			}
+		}
+	}
+	return true;
+}
+
+/*
+  Loads a symmetric TSPLIB instance. The header must give the DIMENSION
+  before any section so the sections can be read into preallocated storage.
+  The EDGE_WEIGHT_TYPE may be EUC_2D (the default), CEIL_2D, ATT, GEO or
+  EXPLICIT, in which case the EDGE_WEIGHT_SECTION is read in any of the
+  TSPLIB matrix formats.
+
+  Returns false (having logged why) if the file can't be read or describes
+  something other than a symmetric TSP this program can solve.
+*/
+inline bool LoadTsplibInstance(const std::string& filename, tsplib_instance_t* instance)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		LOGERROR("Couldn't open %s", filename.c_str());
+		return false;
+	}
+	TsplibScanner scanner(file.Data(), file.Data() + file.Size());
+	instance->name.clear();
+	instance->dimension = 0;
+	instance->metric = DistanceOracle::EUC_2D;
+	instance->cities.clear();
+	instance->weights.clear();
+	std::string edge_weight_format;
+	std::vector<ion::Point2<double>> display_cities;
+	std::string keyword;
+	std::string value;
+	while (!scanner.AtEnd())
+	{
+		if (!scanner.ReadKeyword(&keyword, &value))
+		{
+			LOGERROR("%s: expected a keyword", filename.c_str());
+			return false;
+		}
+		if (keyword == "EOF")
+		{
+			break;
+		} else if (keyword == "NAME")
+		{
+			instance->name = value;
+		} else if (keyword == "TYPE")
+		{
+			if (value != "TSP")
+			{
+				LOGERROR("%s: only symmetric TSP instances are supported, this is a %s", filename.c_str(), value.c_str());
+				return false;
+			}
+		} else if (keyword == "DIMENSION")
+		{
+			instance->dimension = (size_t)atoll(value.c_str());
+		} else if (keyword == "EDGE_WEIGHT_TYPE")
+		{
+			if (value == "EUC_2D")
+			{
+				instance->metric = DistanceOracle::EUC_2D;
+			} else if (value == "CEIL_2D")
+			{
+				instance->metric = DistanceOracle::CEIL_2D;
+			} else if (value == "ATT")
+			{
+				instance->metric = DistanceOracle::ATT;
+			} else if (value == "GEO")
+			{
+				instance->metric = DistanceOracle::GEO;
+			} else if (value == "EXPLICIT")
+			{
+				instance->metric = DistanceOracle::EXPLICIT;
+			} else
+			{
+				LOGERROR("%s: unsupported EDGE_WEIGHT_TYPE %s", filename.c_str(), value.c_str());
+				return false;
+			}
+		} else if (keyword == "EDGE_WEIGHT_FORMAT")
+		{
+			edge_weight_format = value;
+		} else if (keyword == "NODE_COORD_TYPE")
+		{
+			if (value != "TWOD_COORDS")
+			{
+				LOGERROR("%s: unsupported NODE_COORD_TYPE %s", filename.c_str(), value.c_str());
+				return false;
+			}
+		} else if (keyword == "NODE_COORD_SECTION" || keyword == "DISPLAY_DATA_SECTION" || keyword == "EDGE_WEIGHT_SECTION")
+		{
+			if (instance->dimension == 0)
+			{
+				LOGERROR("%s: %s comes before the DIMENSION", filename.c_str(), keyword.c_str());
+				return false;
+			}
+			if (keyword == "NODE_COORD_SECTION")
+			{
+				instance->cities.resize(instance->dimension);
+				if (!ReadTsplibCoordinates(scanner, filename, instance->cities))
+				{
+					return false;
+				}
+			} else if (keyword == "DISPLAY_DATA_SECTION")
+			{
+				display_cities.resize(instance->dimension);
+				if (!ReadTsplibCoordinates(scanner, filename, display_cities))
+				{
+					return false;
+				}
+			} else if (!ReadTsplibWeights(scanner, filename, edge_weight_format, instance->dimension, instance->weights))
+			{
+				return false;
+			}
+		} else if (keyword.size() > 8 && keyword.compare(keyword.size() - 8, 8, "_SECTION") == 0)
+		{
+			LOGERROR("%s: unsupported section %s", filename.c_str(), keyword.c_str());
+			return false;
+		}
+		//anything else (COMMENT, DISPLAY_DATA_TYPE, ...) doesn't affect the distances
+	}
+	if (instance->dimension == 0)
+	{
+		LOGERROR("%s has no DIMENSION", filename.c_str());
+		return false;
+	}
+	if (instance->metric == DistanceOracle::EXPLICIT)
+	{
+		if (instance->weights.empty())
+		{
+			LOGERROR("%s has an EXPLICIT EDGE_WEIGHT_TYPE but no EDGE_WEIGHT_SECTION", filename.c_str());
+			return false;
+		}
+		if (instance->cities.empty())
+		{
+			instance->cities.swap(display_cities);
+		}
+	} else if (instance->cities.empty())
+	{
+		LOGERROR("%s has no NODE_COORD_SECTION", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*
+  Loads the TOUR_SECTION of a TSPLIB tour (e.g. .opt.tour) file, converting
+  the 1-indexed node ids to 0-indexed cities. The section ends at -1, EOF or
+  the end of the file.
+*/
+inline bool LoadTsplibTour(const std::string& filename, std::vector<uint32_t>* tour)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		LOGERROR("Couldn't open %s", filename.c_str());
+		return false;
+	}
+	TsplibScanner scanner(file.Data(), file.Data() + file.Size());
+	tour->clear();
+	std::string keyword;
+	std::string value;
+	while (!scanner.AtEnd())
+	{
+		if (!scanner.ReadKeyword(&keyword, &value))
+		{
+			LOGERROR("%s: expected a keyword", filename.c_str());
+			return false;
+		}
+		if (keyword == "DIMENSION")
+		{
+			tour->reserve((size_t)atoll(value.c_str()));
+		} else if (keyword == "TOUR_SECTION")
+		{
+			int64_t id;
+			while (scanner.ReadInt(&id) && id != -1)
+			{
+				if (id < 1)
+				{
+					LOGERROR("%s: %lld isn't a node", filename.c_str(), (long long)id);
+					return false;
+				}
+				tour->push_back((uint32_t)(id - 1));
+			}
+			return true;
+		} else if (keyword == "EOF")
+		{
+			break;
+		}
+	}
+	LOGERROR("%s has no TOUR_SECTION", filename.c_str());
+	return false;
+}
+#endif //CS776_TSPLIB_H_
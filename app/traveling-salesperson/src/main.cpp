@@ -1,6 +1,19 @@
 #include "ionlib\log.h"
 #include "ionlib\genetic_algorithm.h"
 #include "ionlib\geometry.h"
+#include "distance_oracle.h"
+#include "tsplib.h"
+#include "candidate_neighbors.h"
+#include "crossover.h"
+#include "local_search.h"
+#include "selection.h"
+#include "command_line.h"
+#include "random.h"
+#include "trial_runner.h"
+#include "checkpoint.h"
+#include "statistics_writer.h"
+#include "island_model.h"
+#include "flat_population.h"
 #include <vector>
 #include <istream>
 #include <iostream>
@@ -9,11 +22,15 @@
 #include <set>
 #include <sstream>
 #include <map>
+#include <chrono>
+#include <limits>
 #include <time.h>
 #include <signal.h>
 #define MIDPOINT_MUTATION
-//#define RANK_PROPORTIONAL_SELECTION
-#define FITNESS_PROPORTIONAL_SELECTION
+//when defined every cached route length is checked against a full evaluation each generation
+//#define VERIFY_DELTA_EVALUATION
+//the CheckAllocations configuration defines COUNT_ALLOCATIONS, which counts every heap allocation for --check-allocations
+#include "allocation_counter.h"
 typedef std::vector<uint32_t> route_t;
 
 void SignalHandler(int signal)
@@ -24,39 +41,117 @@ void SignalHandler(int signal)
 typedef struct tsp_s
 {
 	std::string name;
+	size_t num_cities;
+	DistanceOracle::Metric metric;
+	//empty for EXPLICIT instances which don't have display coordinates
 	std::vector<ion::Point2<double>> cities;
+	//the row major num_cities x num_cities weights of EXPLICIT instances
+	std::vector<int32_t> weights;
 	route_t optimal_route;
 } tsp_t;
 
+void BuildDistanceOracle(const tsp_t& tsp, DistanceOracle& oracle, size_t memory_budget = DistanceOracle::kDefaultMemoryBudget)
+{
+	if (tsp.metric == DistanceOracle::EXPLICIT)
+	{
+		oracle.BuildExplicit(tsp.weights, tsp.num_cities);
+	} else
+	{
+		oracle.Build(tsp.cities, tsp.metric, memory_budget);
+	}
+}
+
+//true if the metric is the euclidean distance between the coordinates (up to scaling and rounding), so SpatialGrid can search them
+bool HasPlanarCoordinates(const tsp_t& tsp)
+{
+	return tsp.metric == DistanceOracle::EUC_2D || tsp.metric == DistanceOracle::CEIL_2D || tsp.metric == DistanceOracle::ATT;
+}
+
+//builds the grid the midpoint mutation and the candidate neighbors search, oracle must be tsp's and outlive the grid
+void BuildCityGrid(const tsp_t& tsp, const DistanceOracle& oracle, SpatialGrid& city_grid)
+{
+	if (HasPlanarCoordinates(tsp))
+	{
+		city_grid.Build(tsp.cities);
+	} else
+	{
+		city_grid.BuildFromWeights(oracle);
+	}
+}
+
+//Settings which aren't part of the problem or the classic GA parameters, set from the command line
+typedef struct tsp_options_s
+{
+	ParentSelector::Method selection;
+	uint32_t tournament_size;
+	PermutationCrossover::Operator crossover;
+	//trial n is seeded with rng::StreamSeed(seed, n)
+	uint64_t seed;
+	//0 means one thread per hardware thread
+	uint32_t num_threads;
+	//more than one island runs the island model instead of independent trials
+	uint32_t num_islands;
+	uint32_t migration_interval;
+	std::string topology;
+	//memetic mode: improve the elite and/or this fraction of the other members with local search every generation
+	bool local_search_elite;
+	double local_search_fraction;
+	//improving moves allowed per generation across all of the members searched
+	uint32_t local_search_moves;
+	uint32_t local_search_neighbors;
+	StatisticsWriter::Format stats_format;
+	//seconds between checkpoints of ExecuteGa, 0 disables checkpointing
+	double checkpoint_interval;
+	bool resume;
+} tsp_options_t;
+
+/*
+  The GA only reads the instance, its DistanceOracle and its SpatialGrid, so
+  they are built once (see BuildDistanceOracle and BuildCityGrid) and shared
+  by every trial and island solving the instance. All three must outlive
+  the GA.
+*/
 class TravelingSalespersonGA : public ion::GeneticAlgorithm<route_t>
 {
 public:
-	TravelingSalespersonGA(size_t num_members, size_t num_citites, double mutation_probability, double crossover_probability, tsp_t tsp) : ion::GeneticAlgorithm<route_t>(num_members, 1, mutation_probability, crossover_probability)
+	TravelingSalespersonGA(size_t num_members, size_t num_citites, double mutation_probability, double crossover_probability, const tsp_t& tsp, const DistanceOracle& oracle, const SpatialGrid& city_grid) : ion::GeneticAlgorithm<route_t>(num_members, 1, mutation_probability, crossover_probability)
 	{
 		//according to the problem definition, the salesperson must start at city 1, thus note that all of this class ignores city one except for computing distance
-		tsp_ = tsp;
+		tsp_ = &tsp;
+		oracle_ = &oracle;
+		city_grid_ = &city_grid;
+		grid_candidates_.reserve(city_grid.GetNumCities());
+		local_search_elite_ = false;
+		local_search_fraction_ = 0.0;
+		local_search_moves_ = 0;
 		optimal_length_ = 0.0;
 		optimal_fitness_ = 1.0;
 		//setup the members
-		if (num_citites > RAND_MAX || num_members > RAND_MAX)
+		//the members live in routes_, not the library's population_, so that all of them (and the next generation)
+		//are in one buffer which is allocated once. Subtract 1 because city 1 is the start
+		routes_.Resize(num_members, num_citites - 1);
+		//the position index has a slot for city 1 too, see BuildPositionIndex
+		positions_.Resize(num_members, num_citites);
+		for (size_t member_index = 0; member_index < routes_.NumMembers(); ++member_index)
 		{
-			LOGFATAL("Your chromosome or population size is greater than RAND_MAX, so the random number generator will never select some members");
-		}
-		for (std::vector<route_t>::iterator member_it = population_.begin(); member_it != population_.end(); ++member_it)
-		{
-			//subtract 1 because city 1 is the start
-			member_it->resize(num_citites - 1);
-			for (route_t::iterator city_it = member_it->begin(); city_it != member_it->end(); ++city_it)
+			MemberView<uint32_t> member = routes_.Member(member_index);
+			for (uint32_t* city_it = member.begin(); city_it != member.end(); ++city_it)
 			{
-				(*city_it)= (uint32_t)((city_it - member_it->begin()) + 1);
+				(*city_it)= (uint32_t)((city_it - member.begin()) + 1);
 			}
 			//make several swaps of the cities
-			for (route_t::iterator city_it = member_it->begin(); city_it != member_it->end(); ++city_it)
+			for (uint32_t* city_it = member.begin(); city_it != member.end(); ++city_it)
 			{
-				size_t city_to_swap = ion::randull(0, member_it->size() - 1);
-				std::iter_swap(city_it, member_it->begin() + city_to_swap);
+				size_t city_to_swap = rng::randull(0, member.size() - 1);
+				std::iter_swap(city_it, member.begin() + city_to_swap);
 			}
+			BuildPositionIndex(member, positions_.Member(member_index));
 		}
+		//none of the lengths are known yet, so this evaluates everything
+		route_length_.resize(num_members, kUnknownRouteLength);
+		offspring_route_length_.resize(num_members, kUnknownRouteLength);
+		route_seen_.resize(num_citites);
+		crossover_.Init(PermutationCrossover::PARTIALLY_MAPPED, num_citites - 1);
 		EvaluateMembers();
 		if (tsp.optimal_route.size() > 0)
 		{
@@ -67,85 +162,66 @@ public:
 	virtual void Mutate()
 	{
 		//randomly select cities to permute
-		//we start with the second element because we are doing elite selection
-		for (std::vector<route_t>::iterator member_it = population_.begin() + 1; member_it != population_.end(); ++member_it)
+		//the cities of every member but the first (we are doing elite selection) are numbered consecutively, and
+		//instead of drawing a number for every city to decide if it mutates we skip straight to the next one which does
+		size_t route_length = routes_.MemberLength();
+		uint64_t num_cities = (uint64_t)(routes_.NumMembers() - 1) * route_length;
+		rng::SkipSampler skip(mutation_probability_);
+		for (uint64_t city_index = skip.Next(); city_index < num_cities; city_index = skip.Advance(city_index, num_cities))
 		{
+			size_t member_index = 1 + (size_t)(city_index / route_length);
+			MemberView<uint32_t> member = routes_.Member(member_index);
+			uint32_t* city_it = member.begin() + (size_t)(city_index % route_length);
 			//mutate by swapping cities
-			for (route_t::iterator city_it = member_it->begin(); city_it != member_it->end(); ++city_it)
-			{
-				//note this line consumes about 66% of the CPU time, I could optimize it to make the program run much faster
-				double random_number = ion::randlf(0.0, 1.0);
-				if (random_number < mutation_probability_)
-				{
 #ifndef MIDPOINT_MUTATION
-					size_t city_to_swap = ion::randull(0, member_it->size() - 1);
-					std::iter_swap(city_it, member_it->begin() + city_to_swap);
+			size_t city_to_swap = rng::randull(0, member.size() - 1);
+			SwapCities(member_index, city_it - member.begin(), city_to_swap);
 #elif defined(MIDPOINT_MUTATION)
-					//find the city closest to the midpoint between these neighbors
-					uint32_t neighbor_left, neighbor_right;
-					neighbor_left = *city_it;
-					if (member_it->end() - city_it == 1)
-					{
-						neighbor_right = 0;
-					} else
-					{
-						neighbor_right = *(city_it + 1);
-					}
-					//instead of blindly selecting the closest city to the midpoint, probabilistically select a nearby city by partitioning the space in half repeatedly
-					random_number = ion::randlf(0.0, 1.0);
-					//subdivide the space until that number is found
-					double partition = 0.5;
-					size_t partition_iteration = 0;
-					random_number -= partition;
-					//don't allow the city to stay the same
-					while (random_number > 0 && partition_iteration < (member_it->size()-3))
-					{
-						partition = partition / 2.0;
-						random_number -= partition;
-						partition_iteration++;
-					}
-					//now find the partition_iteration'th closest city
-					ion::Point2<double> left_location, right_location;
-					left_location = tsp_.cities[neighbor_left];
-					right_location = tsp_.cities[neighbor_right];
-
-
-					std::multimap<double, uint64_t> city_distance;
-					for(uint32_t city_index = 1; city_index < member_it->size(); ++city_index) {
-						if (city_index == neighbor_left || city_index == neighbor_right)
-						{
-							continue;
-						}
-						//compute the distance between these cities
-						double distance = left_location.distance(tsp_.cities[city_index]) + right_location.distance(tsp_.cities[city_index]);
-						city_distance.insert(std::pair<double, uint64_t>(distance, city_index));
-					}
-					//get the n'th element
-					std::map<double, uint64_t>::iterator nearby_city = city_distance.begin();
-					while (partition_iteration != 0)
-					{
-						partition_iteration--;
-						nearby_city++;
-					}
-					//find this city in the route
-					route_t::iterator city_to_swap_1 = std::find(member_it->begin(), member_it->end(), nearby_city->second);
-					route_t::iterator city_to_swap_2;
-					//swap the left city with this city, unless this is the last city
-					if (neighbor_right == 0)
-					{
-						city_to_swap_2 = city_it;
-					} else
-					{
-						city_to_swap_2 = city_it + 1;
-					}
-					std::iter_swap(city_to_swap_1, city_to_swap_2);
-
-
+			//find the city closest to the midpoint between these neighbors
+			uint32_t neighbor_left, neighbor_right;
+			neighbor_left = *city_it;
+			if (member.end() - city_it == 1)
+			{
+				neighbor_right = 0;
+			} else
+			{
+				neighbor_right = *(city_it + 1);
+			}
+			//instead of blindly selecting the closest city to the midpoint, probabilistically select a nearby city by partitioning the space in half repeatedly
+			double random_number = rng::randlf(0.0, 1.0);
+			//subdivide the space until that number is found
+			double partition = 0.5;
+			size_t partition_iteration = 0;
+			random_number -= partition;
+			//don't allow the city to stay the same
+			while (random_number > 0 && partition_iteration < (member.size()-3))
+			{
+				partition = partition / 2.0;
+				random_number -= partition;
+				partition_iteration++;
+			}
+			//now find the partition_iteration'th closest city
+			uint32_t nearby_city;
+			if (!city_grid_->NthClosestToPair(neighbor_left, neighbor_right, partition_iteration, grid_candidates_, &nearby_city))
+			{
+				LOGERROR("Could not find the %zu'th closest city to %u and %u", partition_iteration, neighbor_left, neighbor_right);
+				continue;
+			}
+			//find this city in the route
+			size_t city_to_swap_1 = positions_.Member(member_index)[nearby_city];
+			size_t city_to_swap_2;
+			//swap the left city with this city, unless this is the last city
+			if (neighbor_right == 0)
+			{
+				city_to_swap_2 = city_it - member.begin();
+			} else
+			{
+				city_to_swap_2 = (city_it + 1) - member.begin();
+			}
+			SwapCities(member_index, city_to_swap_1, city_to_swap_2);
 #else
 #error No mutation method selected
 #endif
-				}
-			}
 		}
 	}
 	virtual void Select()
@@ -153,169 +229,387 @@ public:
 		//This implements the PMX selection
 
 		//note that the fitnesses must already be set
-		//get the total fitness
-#if defined(FITNESS_PROPORTIONAL_SELECTION)
-		double fitness_sum = std::accumulate(fitness_.begin(), fitness_.end(), 0.0);
-#elif defined(RANK_PROPORTIONAL_SELECTION)
-		//compute the maximum rank sum
-		size_t rank_sum = 0;
-		size_t num_cities = population_[0].size();
-		size_t index = num_cities;
-		while (index != 0)
+		//pick all of the parents up front, the elite member takes the first slot so we need one fewer
+		selector_.Prepare(fitness_);
+		selector_.Select(routes_.NumMembers() - 1, parents_);
+		//the next generation is written into the offspring half of routes_ and positions_, so copying a parent
+		//doesn't allocate. The cached route lengths and position indexes follow their members into the new population
+		//since we are using elite selection, copy the elite member
+		size_t elite_index = std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin();
+		CopyMember(elite_index, 0);
+		for (uint32_t member_index = 1; member_index < routes_.NumMembers(); ++member_index)
 		{
-			rank_sum += index/**index*/;
-			index--;
-		}
-		//make a map of fitnesses (maps are ordered)
-		std::multimap<double, uint32_t> fitness_map;
-		for (std::vector<double>::iterator fitness_it = fitness_.begin(); fitness_it != fitness_.end(); ++fitness_it)
-		{
-			fitness_map.insert(std::pair<double,uint32_t>(*fitness_it, (uint32_t)(fitness_it - fitness_.begin())));
-		}
-#else
-#error No selection method enabled
-#endif
-		//create a temporary population
-		std::vector<route_t> temp_population;
-		temp_population.reserve(population_.size());
-		//since we are using elite selection, push the elite member
-		temp_population.push_back(GetEliteMember());
-		//start selecting elements by treating the fitness as cumulative density function
-		for (uint32_t member_index = 1; member_index < population_.size(); ++member_index)
-		{
-#if defined(FITNESS_PROPORTIONAL_SELECTION)
-			//get a number between 0 and fitness_sum
-			double selected_individual = ion::randlf(0.0, fitness_sum);
-			//traverse the CDF until selected_individual is found
-			std::vector<double>::iterator parent_it;
-			uint32_t parent_index = 0;
-			for (parent_it = fitness_.begin(); parent_it != fitness_.end(); ++parent_it, ++parent_index)
+			uint32_t parent_index = parents_[member_index - 1];
+			//this is the member that is getting propogated to the next generation
+			CopyMember(parent_index, member_index);
+			//children are paired up as (1,2), (3,4), ... so the elite member is never crossed over. Once the second
+			//child of a pair has been copied attempt crossover on these two members
+			if (member_index % 2 == 0)
 			{
-				selected_individual -= *parent_it;
-				if (selected_individual < 0.0000000001)
+				double random_number = rng::randlf(0.0, 1.0);
+				if (random_number < crossover_probability_)
 				{
-					break;
+					//we will do crossover
+
+					//select two points in the route to crossover at
+					size_t route_length = routes_.MemberLength();
+					size_t crossover_begin = rng::randull(0, route_length - 2);
+					size_t crossover_end = rng::randull(crossover_begin + 1, route_length - 1);
+					size_t mate1 = member_index;
+					size_t mate2 = member_index - 1;
+					crossover_.Cross(routes_.Offspring(mate1).data(), positions_.Offspring(mate1).data(), routes_.Offspring(mate2).data(), positions_.Offspring(mate2).data(), crossover_begin, crossover_end);
+					//crossover can change any number of edges, so the children need a full evaluation
+					offspring_route_length_[mate1] = kUnknownRouteLength;
+					offspring_route_length_[mate2] = kUnknownRouteLength;
 				}
 			}
-			LOGASSERT(selected_individual <= 0.0000000001);
-#elif defined(RANK_PROPORTIONAL_SELECTION)
-			int32_t selected_offset = (int32_t)ion::randull(1, rank_sum);
-			//LOGDEBUG("Selected offset: %d", selected_offset);
-			size_t rank_index = 0;
-			std::multimap<double, uint32_t>::reverse_iterator selected_pair = fitness_map.rbegin();
-			while (selected_offset > 1)
-			{
-				selected_offset -= (int32_t)((num_cities - rank_index)/**(num_cities - rank_index)*/);
-				rank_index++;
-				selected_pair++;
-			}
-			//hack because I can't figure out why it sometimes gets to the rend element
-			uint32_t parent_index;
-			if (selected_pair == fitness_map.rend())
-			{
-				LOGERROR("Using defualt parent due to rend bug");
-				parent_index = 0;
-			} else
+		}
+		routes_.SwapGenerations();
+		positions_.SwapGenerations();
+		route_length_.swap(offspring_route_length_);
+	}
+	//copies member from of the current generation into slot to of the next generation
+	void CopyMember(size_t from, size_t to)
+	{
+		routes_.CopyToOffspring(from, to);
+		positions_.CopyToOffspring(from, to);
+		offspring_route_length_[to] = route_length_[from];
+	}
+	//hides the library's version since the members aren't in population_
+	route_t GetEliteMember()
+	{
+		MemberView<uint32_t> elite = routes_.Member(std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin());
+		return route_t(elite.begin(), elite.end());
+	}
+	//copies the elite member into route, which must already be MemberLength() long, so it doesn't allocate
+	void CopyEliteMember(route_t* route) const
+	{
+		MemberView<const uint32_t> elite = routes_.Member(std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin());
+		std::copy(elite.begin(), elite.end(), route->begin());
+	}
+	//replaces the least fit member other than the first (which Select made the elite) with route, used for migration
+	void ImportMember(const route_t& route)
+	{
+		if (routes_.NumMembers() < 2)
+		{
+			return;
+		}
+		size_t worst_index = std::min_element(fitness_.begin() + 1, fitness_.end()) - fitness_.begin();
+		MemberView<uint32_t> worst = routes_.Member(worst_index);
+		std::copy(route.begin(), route.end(), worst.begin());
+		BuildPositionIndex(worst, positions_.Member(worst_index));
+		//the member is evaluated right away since Select will look at its fitness before EvaluateMembers runs again
+		route_length_[worst_index] = GetRouteLength(worst);
+		fitness_[worst_index] = 1.0 / route_length_[worst_index];
+		num_evaluations_++;
+	}
+	/*
+	  Saves everything a generation leaves behind which the constructor
+	  doesn't rebuild: the routes, their cached lengths and fitnesses, and the
+	  evaluation count. A GA constructed with the same settings continues
+	  exactly where this one was after LoadState, provided the calling
+	  thread's rng stream is restored too.
+	*/
+	void SaveState(ByteWriter& writer) const
+	{
+		writer.Write((uint64_t)routes_.NumMembers());
+		writer.Write((uint64_t)routes_.MemberLength());
+		for (size_t member_index = 0; member_index < routes_.NumMembers(); ++member_index)
+		{
+			writer.WriteArray(routes_.Member(member_index).data(), routes_.MemberLength());
+		}
+		writer.WriteVector(route_length_);
+		writer.WriteVector(fitness_);
+		writer.Write((uint64_t)num_evaluations_);
+	}
+	bool LoadState(ByteReader& reader)
+	{
+		uint64_t num_members;
+		uint64_t member_length;
+		if (!reader.Read(&num_members) || !reader.Read(&member_length) || num_members != routes_.NumMembers() || member_length != routes_.MemberLength())
+		{
+			return false;
+		}
+		for (size_t member_index = 0; member_index < routes_.NumMembers(); ++member_index)
+		{
+			MemberView<uint32_t> member = routes_.Member(member_index);
+			if (!reader.ReadArray(member.data(), member.size()))
 			{
-				//now selected_pair has the city to select
-				parent_index = selected_pair->second;
+				return false;
 			}
-#else
-#error No selection method enabled
-#endif
-			//now parent_it is the member that is getting propogated to the next generation
-			temp_population.push_back(*(population_.begin() + parent_index));
-			//if this iteration is an odd number (that is, we have pushed an even number of elements onto the queue) attempt crossover on these two members
-			if (member_index % 1 == 1)
+			for (uint32_t* city_it = member.begin(); city_it != member.end(); ++city_it)
 			{
-				double random_number = ion::randlf(0.0, 1.0);
-				if (random_number < crossover_probability_)
+				if (*city_it == 0 || *city_it >= tsp_->num_cities)
 				{
-					//we will do crossover
-
-					//select two points to crossover at
-					uint32_t crossover_begin = (uint32_t)ion::randull(0, (uint32_t)(population_.size()) - 1);
-					uint32_t crossover_end   = (uint32_t)ion::randull(crossover_begin + 1, population_.size() - 1);
-					//get the last two members pushed onto the temp vector
-					std::vector<route_t>::reverse_iterator mate1 = temp_population.rbegin();
-					std::vector<route_t>::reverse_iterator mate2 = mate1 + 1;
-					//these are the members we will do PMX on
-					for (uint32_t crossover_index = crossover_begin; crossover_index <= crossover_end; ++crossover_index)
-					{
-						//to update mate1, we check what mate 2 has in this position, find that item in mate1, and replace it with what mate1 had there. Similarly for the other mate
-						uint32_t city_in_mate2 = (*mate2)[crossover_index]; //2
-						uint32_t city_in_mate1 = (*mate1)[crossover_index];
-						route_t::iterator mate2_city_in_mate1_it = std::find(mate1->begin(), mate1->end(), city_in_mate2); //[8] ==2
-						route_t::iterator mate1_city_in_mate2_it = std::find(mate2->begin(), mate2->end(), city_in_mate1);
-						*mate2_city_in_mate1_it = (*mate1)[crossover_index]; //[8] = 5
-						*mate1_city_in_mate2_it = (*mate2)[crossover_index];
-						(*mate1)[crossover_index] = city_in_mate2; //[3] = 2
-						(*mate2)[crossover_index] = city_in_mate1;
-					}
+					return false;
 				}
 			}
+			BuildPositionIndex(member, positions_.Member(member_index));
 		}
-		//hack sometimes temp population doesn't have enough items in it, so add more
-		while (temp_population.size() < population_.size())
+		uint64_t num_evaluations;
+		if (!reader.ReadVector(&route_length_) || !reader.ReadVector(&fitness_) || !reader.Read(&num_evaluations))
 		{
-			LOGERROR("Apply population missize hack");
-			temp_population.push_back(*(temp_population.begin()));
+			return false;
 		}
-		population_.swap(temp_population);
-		
+		num_evaluations_ = (decltype(num_evaluations_))num_evaluations;
+		return route_length_.size() == routes_.NumMembers() && fitness_.size() == routes_.NumMembers();
 	}
-	double GetRouteLength(route_t member)
+	/*
+	  Turns on the memetic mode: after every evaluation the elite (if
+	  improve_elite) and each other member with probability fraction are
+	  improved with 2-opt and Or-opt, until moves_per_generation improving
+	  moves have been made.
+	*/
+	void SetLocalSearch(bool improve_elite, double fraction, size_t moves_per_generation, size_t num_neighbors)
+	{
+		local_search_elite_ = improve_elite;
+		local_search_fraction_ = fraction;
+		local_search_moves_ = moves_per_generation;
+		if (LocalSearchEnabled())
+		{
+			neighbors_.Build(*city_grid_, tsp_->num_cities, num_neighbors);
+			local_search_.Init(oracle_, &neighbors_);
+		}
+	}
+	bool LocalSearchEnabled() const
+	{
+		return (local_search_elite_ || local_search_fraction_ > 0.0) && local_search_moves_ > 0;
+	}
+	void SetSelectionMethod(ParentSelector::Method method, uint32_t tournament_size)
+	{
+		selector_.SetMethod(method, tournament_size);
+	}
+	void SetCrossoverOperator(PermutationCrossover::Operator crossover_operator)
+	{
+		crossover_.Init(crossover_operator, routes_.MemberLength());
+	}
+	//Route is anything with begin() and end() over the cities, e.g. a route_t or a MemberView
+	template<typename Route>
+	double GetRouteLength(const Route& member)
 	{
 #ifdef _DEBUG
 		//first, as a debug step, validate all members
-		//convert the vector to a set (i.e. container with unique members) and if the lenghts differ there was an issue
-		std::set<uint32_t> set(member.begin(), member.end());
-		LOGASSERT(set.size() == member.size());
+		//every city must be in range and appear only once
+		std::fill(route_seen_.begin(), route_seen_.end(), 0);
+		for (size_t index = 0; index < member.size(); ++index)
+		{
+			uint32_t city = member[index];
+			LOGASSERT(city < tsp_->num_cities && !route_seen_[city]);
+			route_seen_[city] = 1;
+		}
 #endif
-		ion::Point2<double> last_city = tsp_.cities[0];
-		//evaluate their lengths
-		double tour_length = 0.0;
-		for (route_t::iterator city_it = member.begin(); city_it != member.end(); ++city_it)
+		//the tour starts and ends at city 1
+		return (double)oracle_->ClosedTourLength(0, member.begin(), member.end());
+	}
+	/*
+	  Swaps the cities at two positions of a member and updates its cached
+	  route length. Since the tour is a cycle, swapping two cities can only
+	  change the (at most) four edges entering and leaving those positions, so
+	  the new length is found by subtracting those edges before the swap and
+	  adding them back after it.
+
+	  Returns the change in route length.
+	*/
+	int64_t SwapCities(size_t member_index, size_t first, size_t second)
+	{
+		MemberView<uint32_t> member = routes_.Member(member_index);
+		if (first == second)
 		{
-			if (*city_it > tsp_.cities.size())
-			{
-				//hack because I can't figure this out
-				LOGERROR("Injecting bad fitness");
-				return 999999999.0;
-			}
-			ion::Point2<double> city_coord = tsp_.cities[*city_it];
-			tour_length += std::round(last_city.distance(city_coord));
-			last_city = city_coord;
+			return 0;
+		}
+		if (first > second)
+		{
+			std::swap(first, second);
+		}
+		//keep the city to position index in sync
+		MemberView<uint32_t> position = positions_.Member(member_index);
+		std::swap(position[member[first]], position[member[second]]);
+		if (route_length_[member_index] == kUnknownRouteLength)
+		{
+			//this member will be fully evaluated anyway, so don't bother with the delta
+			std::swap(member[first], member[second]);
+			return 0;
+		}
+		//edge e connects position e-1 to position e, so these are the edges touching first and second.
+		//if the positions are adjacent they share an edge which must only be counted once
+		size_t edges[4] = { first, first + 1, second, second + 1 };
+		size_t num_edges = 4;
+		if (second == first + 1)
+		{
+			edges[2] = second + 1;
+			num_edges = 3;
+		}
+		int64_t delta = 0;
+		for (size_t edge_index = 0; edge_index < num_edges; ++edge_index)
+		{
+			delta -= GetEdgeLength(member, edges[edge_index]);
+		}
+		std::swap(member[first], member[second]);
+		for (size_t edge_index = 0; edge_index < num_edges; ++edge_index)
+		{
+			delta += GetEdgeLength(member, edges[edge_index]);
 		}
-		//the tour ends at city 1
-		tour_length += std::round(last_city.distance(tsp_.cities[0]));
-		return tour_length;
+		route_length_[member_index] += (double)delta;
+		return delta;
+	}
+	//position[city] is set to the index of city in member. position[0] is unused since city 1 is never in a member
+	static void BuildPositionIndex(MemberView<uint32_t> member, MemberView<uint32_t> position)
+	{
+		for (uint32_t city_index = 0; city_index < member.size(); ++city_index)
+		{
+			position[member[city_index]] = city_index;
+		}
+	}
+	//edge e of a route is the edge entering position e, where position -1 and position size() are both city 1
+	inline int32_t GetEdgeLength(MemberView<uint32_t> member, size_t edge) const
+	{
+		uint32_t from = (edge == 0) ? 0 : member[edge - 1];
+		uint32_t to = (edge == member.size()) ? 0 : member[edge];
+		return oracle_->Distance(from, to);
 	}
 	virtual void EvaluateMembers()
 	{
-		for (std::vector<route_t>::iterator member_it = population_.begin(); member_it < population_.end(); ++member_it)
+		for (size_t member_index = 0; member_index < routes_.NumMembers(); ++member_index)
 		{
-			double tour_length = GetRouteLength(*member_it);
+			//only members whose length is unknown (initial members and PMX children) need a full evaluation,
+			//everything else was kept up to date by SwapCities
+			if (route_length_[member_index] == kUnknownRouteLength)
+			{
+				route_length_[member_index] = GetRouteLength(routes_.Member(member_index));
+			}
+#ifdef VERIFY_DELTA_EVALUATION
+			double full_length = GetRouteLength(routes_.Member(member_index));
+			if (full_length != route_length_[member_index])
+			{
+				LOGFATAL("Member %zu has a cached length of %lf but its real length is %lf", member_index, route_length_[member_index], full_length);
+			}
+#endif
 
 			//I use the 1/distance method to compute fitness knowing that the tour length will never be 0
-			fitness_[member_it - population_.begin()] = 1.0 / tour_length;
+			fitness_[member_index] = 1.0 / route_length_[member_index];
 		}
-
+		if (LocalSearchEnabled())
+		{
+			ImproveMembers();
+		}
+	}
+	//the local search step of the memetic mode, see SetLocalSearch
+	void ImproveMembers()
+	{
+		size_t moves_left = local_search_moves_;
+		size_t elite_index = std::max_element(fitness_.begin(), fitness_.end()) - fitness_.begin();
+		if (local_search_elite_)
+		{
+			ImproveMember(elite_index, moves_left);
+		}
+		if (local_search_fraction_ > 0.0)
+		{
+			for (size_t member_index = 0; member_index < routes_.NumMembers() && moves_left > 0; ++member_index)
+			{
+				if (member_index != elite_index && rng::randlf(0.0, 1.0) < local_search_fraction_)
+				{
+					ImproveMember(member_index, moves_left);
+				}
+			}
+		}
+	}
+	void ImproveMember(size_t member_index, size_t& moves_left)
+	{
+		size_t num_moves = 0;
+		int64_t delta = local_search_.Improve(routes_.Member(member_index).data(), positions_.Member(member_index).data(), moves_left, &num_moves);
+		moves_left -= num_moves;
+		route_length_[member_index] += (double)delta;
+		fitness_[member_index] = 1.0 / route_length_[member_index];
 	}
 	double optimal_length_;
 	double optimal_fitness_;
 private:
-	tsp_t tsp_;
+	static const double kUnknownRouteLength;
+	//shared with every other GA solving the instance, see the class comment
+	const tsp_t* tsp_;
+	const DistanceOracle* oracle_;
+	//the members, and the next generation which Select builds in the offspring half
+	FlatPopulation<uint32_t> routes_;
+	//positions_.Member(m)[c] is the index of city c in member m, so the mutation can find a city without searching
+	FlatPopulation<uint32_t> positions_;
+	//the length of each member, or kUnknownRouteLength if it must be recomputed
+	std::vector<double> route_length_;
+	std::vector<double> offspring_route_length_;
+	//scratch space for the debug check in GetRouteLength
+	std::vector<uint8_t> route_seen_;
+	PermutationCrossover crossover_;
+	ParentSelector selector_;
+	//the parents selected for the next generation
+	std::vector<uint32_t> parents_;
+	//used by the midpoint mutation to find cities near the midpoint of two cities without looking at every city
+	const SpatialGrid* city_grid_;
+	//this GA's scratch space for the city_grid_ queries
+	std::vector<SpatialGrid::Candidate> grid_candidates_;
+	//the memetic mode, see SetLocalSearch
+	bool local_search_elite_;
+	double local_search_fraction_;
+	size_t local_search_moves_;
+	CandidateNeighbors neighbors_;
+	LocalSearch local_search_;
 };
 
+const double TravelingSalespersonGA::kUnknownRouteLength = -1.0;
+
+/*
+  Loads a TSPLIB instance and, if optimal_filename isn't empty, its optimal
+  tour. Logs why and returns an instance with no cities if either can't be
+  loaded.
+*/
 tsp_t ReadTspInput(std::string tsp_filename, std::string optimal_filename)
 {
-	std::ifstream fin;
 	tsp_t tsp;
+	tsp.num_cities = 0;
+	tsp.metric = DistanceOracle::EUC_2D;
+	tsplib_instance_t instance;
+	if (!LoadTsplibInstance(tsp_filename, &instance))
+	{
+		return tsp;
+	}
+	if (optimal_filename != "" && !LoadTsplibTour(optimal_filename, &tsp.optimal_route))
+	{
+		return tsp;
+	}
+	if (optimal_filename != "")
+	{
+		//the route is indexed straight into the distance matrix, so it has to visit exactly this instance's cities
+		std::vector<bool> visited(instance.dimension, false);
+		bool is_permutation = tsp.optimal_route.size() == instance.dimension;
+		for (std::vector<uint32_t>::const_iterator city_it = tsp.optimal_route.begin(); is_permutation && city_it != tsp.optimal_route.end(); ++city_it)
+		{
+			is_permutation = *city_it < instance.dimension && !visited[*city_it];
+			if (is_permutation)
+			{
+				visited[*city_it] = true;
+			}
+		}
+		if (!is_permutation)
+		{
+			LOGERROR("%s isn't a tour of the %zu cities of %s", optimal_filename.c_str(), instance.dimension, tsp_filename.c_str());
+			tsp.optimal_route.clear();
+			return tsp;
+		}
+	}
+	tsp.name = instance.name;
+	tsp.num_cities = instance.dimension;
+	tsp.metric = instance.metric;
+	tsp.cities.swap(instance.cities);
+	tsp.weights.swap(instance.weights);
+	return tsp;
+}
+
+//This is how ReadTspInput parsed files before tsplib.h existed. It only
+//understands NODE_COORD_SECTION and is only kept for BenchmarkParsing
+std::vector<ion::Point2<double>> ReadCitiesWithStreams(const std::string& tsp_filename)
+{
+	std::ifstream fin;
+	std::vector<ion::Point2<double>> cities;
 	fin.open(tsp_filename);
-	//read the header
 	std::string dummy;
-	fin >> dummy >> tsp.name;
 	while (fin.good())
 	{
 		fin >> dummy;
@@ -324,83 +618,222 @@ tsp_t ReadTspInput(std::string tsp_filename, std::string optimal_filename)
 			break;
 		}
 	}
-	//now we are in the node section
 	while (fin.good())
 	{
 		ion::Point2<double> point;
-		//read id
 		fin >> dummy;
-		//note the text "EOF" is literally at the end of the file, not to be confused with the EOF character which will come right after that
 		if (dummy == "EOF")
 		{
 			break;
 		}
 		fin >> point.x1_;
 		fin >> point.x2_;
-		tsp.cities.push_back(point);
+		cities.push_back(point);
 	}
-	fin.close();
-	if (optimal_filename != "")
+	return cities;
+}
+
+//The results of one trial of ExecuteGa
+typedef struct tsp_trial_result_s
+{
+	TrialStatistics statistics;
+	uint32_t generations;
+	double shortest_path;
+	std::string path;
+	//wall time until the optimal length was found, or a negative number if it wasn't
+	double seconds_to_optimal;
+} tsp_trial_result_t;
+
+//applies the command line settings which every TravelingSalespersonGA gets
+void ConfigureGa(TravelingSalespersonGA& ga, const tsp_options_t& options)
+{
+	ga.SetSelectionMethod(options.selection, options.tournament_size);
+	ga.SetCrossoverOperator(options.crossover);
+	ga.SetLocalSearch(options.local_search_elite, options.local_search_fraction, options.local_search_moves, options.local_search_neighbors);
+}
+
+//what a trial's checkpoint slot holds, the first byte of the slot
+enum TrialCheckpoint
+{
+	TRIAL_NOT_STARTED,
+	TRIAL_RUNNING,
+	TRIAL_FINISHED,
+	TRIAL_MERGED
+};
+
+void SaveTrialResult(ByteWriter& writer, const tsp_trial_result_t& result)
+{
+	result.statistics.Save(writer);
+	writer.Write(result.generations);
+	writer.Write(result.shortest_path);
+	writer.WriteString(result.path);
+	writer.Write(result.seconds_to_optimal);
+}
+
+bool LoadTrialResult(ByteReader& reader, tsp_trial_result_t* result)
+{
+	return result->statistics.Load(reader) && reader.Read(&result->generations) && reader.Read(&result->shortest_path) && reader.ReadString(&result->path) && reader.Read(&result->seconds_to_optimal);
+}
+
+//everything which changes the results of ExecuteGa, a checkpoint is only resumed by a run with the same settings
+std::string CheckpointSettings(const tsp_t& tsp, size_t population_size, double mutation_rate, double crossover_rate, const tsp_options_t& options)
+{
+	std::stringstream settings;
+	settings.precision(17);
+	settings << tsp.name << " cities " << tsp.num_cities << " pop " << population_size << " mut " << mutation_rate << " xover " << crossover_rate << " seed " << options.seed
+		<< " selection " << options.selection << " tournament " << options.tournament_size << " crossover " << options.crossover
+		<< " local search " << options.local_search_elite << " " << options.local_search_fraction << " " << options.local_search_moves << " " << options.local_search_neighbors;
+	return settings.str();
+}
+
+/*
+  Runs kNumTrials trials and writes their statistics. With a checkpoint
+  interval the run's progress is saved to <statistics file base>.ckpt in the
+  background, and --resume continues from that file with the same results an
+  uninterrupted run would have written (apart from the wall clock times).
+
+  Slot 0 of the checkpoint holds what has been merged so far: the summary,
+  the notes already written and the optimal counts. Slot 1 + t holds trial
+  t: its generation, rng stream, statistics and population while it runs,
+  its result once it finishes, and nothing once it has been merged. A trial
+  slot is only cleared after slot 0 includes it, so whichever versions of
+  the two a snapshot catches, no trial is lost or merged twice.
+*/
+void ExecuteGa(const tsp_t& tsp, size_t population_size, double mutation_rate, double crossover_rate, const tsp_options_t& options)
+{
+	const uint32_t kNumTrials = 30;
+	const uint32_t kMaxGenerations = 50000;
+	//how often (in generations) a trial checks whether its checkpoint is due
+	const uint32_t kCheckpointPollGenerations = 64;
+	//every trial's GA shares these
+	DistanceOracle oracle;
+	BuildDistanceOracle(tsp, oracle);
+	SpatialGrid city_grid;
+	BuildCityGrid(tsp, oracle, city_grid);
+	std::stringstream run_name;
+	run_name << "TSP_" << tsp.name << "_pop" << population_size << "_mut" << mutation_rate << "_xover" << crossover_rate;
+	std::vector<std::string> columns = { "Generation", "Min", "Max", "Mean", "Evals" };
+	StatisticsWriter writer(run_name.str() + StatisticsWriter::Extension(options.stats_format), options.stats_format, columns);
+
+	//every trial writes only to its own result, so the trials can run in parallel
+	std::vector<tsp_trial_result_t> results(kNumTrials);
+	GenerationSummary summary;
+	summary.Reserve(kMaxGenerations);
+	double total_seconds_to_optimal = 0.0;
+	uint32_t num_optimal = 0;
+	uint32_t num_merged = 0;
+	//every note written so far, a resumed run writes them again before continuing
+	std::vector<std::string> notes;
+	std::string settings = CheckpointSettings(tsp, population_size, mutation_rate, crossover_rate, options);
+	std::string checkpoint_filename = run_name.str() + ".ckpt";
+	std::vector<std::string> resumed(kNumTrials + 1);
+	if (options.resume)
 	{
-		fin.open(optimal_filename);
-		while (fin.good())
+		if (!CheckpointWriter::Load(checkpoint_filename, &resumed) || resumed.size() != kNumTrials + 1)
 		{
-			fin >> dummy;
-			if (dummy == "TOUR_SECTION")
-			{
-				break;
-			}
+			LOGFATAL("Couldn't resume from %s", checkpoint_filename.c_str());
+		}
+		ByteReader reader(resumed[0]);
+		std::string saved_settings;
+		uint64_t num_notes;
+		if (!reader.ReadString(&saved_settings))
+		{
+			LOGFATAL("%s is corrupt", checkpoint_filename.c_str());
 		}
-		while (fin.good())
+		if (saved_settings != settings)
 		{
-			int64_t city_id;
-			fin >> city_id;
-			if (city_id == -1)
+			LOGFATAL("%s was written with different settings (%s), resume with the same arguments and --seed", checkpoint_filename.c_str(), saved_settings.c_str());
+		}
+		if (!reader.Read(&num_merged) || !reader.Read(&num_optimal) || !reader.Read(&total_seconds_to_optimal) || !summary.Load(reader) || !reader.Read(&num_notes) || num_notes > reader.Remaining())
+		{
+			LOGFATAL("%s is corrupt", checkpoint_filename.c_str());
+		}
+		notes.resize((size_t)num_notes);
+		for (std::vector<std::string>::iterator note_it = notes.begin(); note_it != notes.end(); ++note_it)
+		{
+			if (!reader.ReadString(&(*note_it)))
 			{
-				break;
+				LOGFATAL("%s is corrupt", checkpoint_filename.c_str());
 			}
-			//my cities are 0-indexed
-			tsp.optimal_route.push_back((uint32_t)city_id-1);
+			writer.AddNote(*note_it);
 		}
+		LOGINFO("Resuming from %s, %u trials were already merged", checkpoint_filename.c_str(), num_merged);
 	}
-	return tsp;
-}
-
-void ExecuteGa(tsp_t tsp, size_t population_size, double mutation_rate, double crossover_rate)
-{
-	std::ofstream fout;
-	uint32_t generation = 0;
-	static double max_fitness[500000] = { 0 };
-	static double min_fitness[500000] = { 0 };
-	static double avg_fitness[500000] = { 0 };
-	static double num_evals[500000] = { 0 };
-	static double num_hits[500000] = { 0 };
-	std::stringstream filename;
-	filename << "TSP_" << tsp.name << "_pop" << population_size << "_mut" << mutation_rate << "_xover" << crossover_rate << ".csv";
-	fout.open(filename.str());
-	fout << "Generation,Min,Max,Mean,Evals" << std::endl;
+	const uint32_t num_resumed_merged = num_merged;
+	std::unique_ptr<CheckpointWriter> checkpoint;
+	if (options.checkpoint_interval > 0.0)
+	{
+		checkpoint.reset(new CheckpointWriter(checkpoint_filename, kNumTrials + 1, options.checkpoint_interval));
+		//carry the resumed state over until it is replaced, so an early snapshot doesn't lose it
+		for (size_t slot = 0; slot < resumed.size(); ++slot)
+		{
+			std::string state = resumed[slot];
+			checkpoint->Update(slot, state);
+		}
+	}
+	std::chrono::duration<double> checkpoint_interval(options.checkpoint_interval);
+	auto add_note = [&](const std::string& note)
+	{
+		notes.push_back(note);
+		writer.AddNote(note);
+	};
 
-	for (uint32_t trial = 0; trial < 30; ++trial)
+	RunTrials(kNumTrials, options.seed, options.num_threads, [&](uint32_t trial)
 	{
-		LOGINFO("Starting trial %u", trial);
-		TravelingSalespersonGA ga(population_size, tsp.cities.size(), mutation_rate, crossover_rate, tsp);
-		LOGINFO("The optimal fitness is %lf, the optimal length is %lf", ga.optimal_fitness_, ga.optimal_length_);
-		max_fitness[generation] += ga.GetMaxFitness();
-		min_fitness[generation] += ga.GetMinFitness();
-		avg_fitness[generation] += ga.GetAverageFitness();
-		num_evals[generation] += ga.GetNumEvals();
-		num_hits[generation]++;
-		for (generation = 1; ga.GetMaxFitness() < ga.optimal_fitness_ && generation < 50000; ++generation)
+		tsp_trial_result_t& result = results[trial];
+		if (trial < num_resumed_merged)
+		{
+			return;
+		}
+		ByteReader reader(resumed[trial + 1]);
+		uint8_t status = TRIAL_NOT_STARTED;
+		if (reader.Remaining() > 0)
+		{
+			reader.Read(&status);
+		}
+		if (status == TRIAL_FINISHED)
+		{
+			if (!LoadTrialResult(reader, &result))
+			{
+				LOGFATAL("Trial %u's checkpoint is corrupt", trial);
+			}
+			return;
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		TravelingSalespersonGA ga(population_size, tsp.num_cities, mutation_rate, crossover_rate, tsp, oracle, city_grid);
+		ConfigureGa(ga, options);
+		uint32_t generation = 1;
+		if (status == TRIAL_RUNNING)
+		{
+			uint32_t completed_generation;
+			double elapsed_seconds;
+			uint64_t rng_state[4];
+			if (!reader.Read(&completed_generation) || !reader.Read(&elapsed_seconds) || !reader.ReadArray(rng_state, 4) || !result.statistics.Load(reader) || !ga.LoadState(reader))
+			{
+				LOGFATAL("Trial %u's checkpoint is corrupt", trial);
+			}
+			rng::ThreadEngine().SetState(rng_state);
+			generation = completed_generation + 1;
+			start -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(elapsed_seconds));
+			result.statistics.Reserve(kMaxGenerations);
+			LOGINFO("Resuming trial %u after generation %u", trial, completed_generation);
+		} else
+		{
+			LOGINFO("Starting trial %u", trial);
+			LOGINFO("The optimal fitness is %lf, the optimal length is %lf", ga.optimal_fitness_, ga.optimal_length_);
+			result.statistics.Reserve(kMaxGenerations);
+			result.statistics.Record(ga);
+		}
+		//reused for every snapshot of this trial, Update hands back the previous one's buffer
+		ByteWriter trial_state;
+		std::chrono::steady_clock::time_point last_checkpoint = std::chrono::steady_clock::now();
+		for (; ga.GetMaxFitness() < ga.optimal_fitness_ && generation < kMaxGenerations; ++generation)
 		{
 			ga.NextGeneration();
-			max_fitness[generation] += ga.GetMaxFitness();
-			min_fitness[generation] += ga.GetMinFitness();
-			avg_fitness[generation] += ga.GetAverageFitness();
-			num_evals[generation] += ga.GetNumEvals();
-			num_hits[generation]++;
+			result.statistics.Record(ga);
 			if (generation % 2000 == 0)
 			{
-				LOGINFO("Generation %u, shortest path: %lf", generation, 1.0 / ga.GetMaxFitness());
+				LOGINFO("Trial %u generation %u, shortest path: %lf", trial, generation, 1.0 / ga.GetMaxFitness());
 				std::stringstream path;
 				path << "Shortest path: ";
 				route_t elite_member = ga.GetEliteMember();
@@ -411,8 +844,31 @@ void ExecuteGa(tsp_t tsp, size_t population_size, double mutation_rate, double c
 				}
 				LOGDEBUG("%s", path.str().c_str());
 			}
+			if (checkpoint && generation % kCheckpointPollGenerations == 0)
+			{
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if (now - last_checkpoint >= checkpoint_interval)
+				{
+					uint64_t rng_state[4];
+					rng::ThreadEngine().GetState(rng_state);
+					trial_state.Clear();
+					trial_state.Write((uint8_t)TRIAL_RUNNING);
+					trial_state.Write(generation);
+					trial_state.Write(std::chrono::duration<double>(now - start).count());
+					trial_state.WriteArray(rng_state, 4);
+					result.statistics.Save(trial_state);
+					ga.SaveState(trial_state);
+					checkpoint->Update(trial + 1, trial_state.Buffer());
+					last_checkpoint = now;
+				}
+			}
+		}
+		result.seconds_to_optimal = -1.0;
+		if (ga.optimal_length_ > 0.0 && ga.GetMaxFitness() >= ga.optimal_fitness_)
+		{
+			result.seconds_to_optimal = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 		}
-		LOGINFO("Final result: after %u generations the shortest path is: %lf", generation, 1.0 / ga.GetMaxFitness());
+		LOGINFO("Final result: trial %u after %u generations the shortest path is: %lf", trial, generation, 1.0 / ga.GetMaxFitness());
 		std::stringstream path;
 		path << "Trial "<<trial<<" Shortest path: ";
 		route_t elite_member = ga.GetEliteMember();
@@ -422,36 +878,672 @@ void ExecuteGa(tsp_t tsp, size_t population_size, double mutation_rate, double c
 			path << (*city_it) + 1 << ", ";
 		}
 		LOGDEBUG("%s", path.str().c_str());
-		fout.flush();
-		fout << "Trial "<<trial << " final result: after " << generation << " generations the shortest path is: " << 1.0 / ga.GetMaxFitness() << std::endl;
-		fout.flush();
+		result.generations = generation;
+		result.shortest_path = 1.0 / ga.GetMaxFitness();
+		result.path = path.str();
+		if (checkpoint)
+		{
+			trial_state.Clear();
+			trial_state.Write((uint8_t)TRIAL_FINISHED);
+			SaveTrialResult(trial_state, result);
+			checkpoint->Update(trial + 1, trial_state.Buffer());
+		}
+	}, [&](uint32_t trial)
+	{
+		if (trial < num_resumed_merged)
+		{
+			return;
+		}
+		//merged in trial order so the output doesn't depend on which thread ran which trial
+		tsp_trial_result_t& result = results[trial];
+		summary.Add(result.statistics);
+		result.statistics.Release();
+		std::stringstream note;
+		note << "Trial " << trial << " final result: after " << result.generations << " generations the shortest path is: " << result.shortest_path;
+		add_note(note.str());
+		if (result.seconds_to_optimal >= 0.0)
+		{
+			note.str("");
+			note << "Trial " << trial << " seconds to optimal: " << result.seconds_to_optimal;
+			add_note(note.str());
+			total_seconds_to_optimal += result.seconds_to_optimal;
+			num_optimal++;
+		}
+		add_note(result.path);
+		num_merged = trial + 1;
+		if (checkpoint)
+		{
+			ByteWriter run_state;
+			run_state.WriteString(settings);
+			run_state.Write(num_merged);
+			run_state.Write(num_optimal);
+			run_state.Write(total_seconds_to_optimal);
+			summary.Save(run_state);
+			run_state.Write((uint64_t)notes.size());
+			for (std::vector<std::string>::iterator note_it = notes.begin(); note_it != notes.end(); ++note_it)
+			{
+				run_state.WriteString(*note_it);
+			}
+			checkpoint->Update(0, run_state.Buffer());
+			//only now that slot 0 includes the trial can its own slot be dropped
+			ByteWriter merged;
+			merged.Write((uint8_t)TRIAL_MERGED);
+			checkpoint->Update(trial + 1, merged.Buffer());
+		}
+	});
+
+	//the summary is the average over all of the trials, written once they have all finished
+	writer.AddNote("Begin summary section");
+	for (size_t generation_index = 0; generation_index < summary.NumGenerations(); ++generation_index)
+	{
+		const generation_summary_t& generation = summary[generation_index];
+		//the columns are route lengths, the reciprocal of the mean fitness
+		double row[5] = { (double)generation_index, 1.0 / generation.min_fitness.Mean(), 1.0 / generation.max_fitness.Mean(), 1.0 / generation.avg_fitness.Mean(), generation.num_evals.Mean() };
+		writer.AddRow(row);
+	}
+	writer.AddNote("End summary section");
+	std::stringstream note;
+	note << "Trials reaching optimal: " << num_optimal << " mean seconds to optimal: " << (num_optimal > 0 ? total_seconds_to_optimal / num_optimal : -1.0);
+	writer.AddNote(note.str());
+}
+
+/*
+  Runs 30 trials of the island model. Each trial runs options.num_islands
+  populations of population_size members at once, so unlike ExecuteGa the
+  trials themselves run one after another.
+
+  For every trial the CSV has a row per island with its best route length,
+  when it was found, and how many migrants it took in, followed by the
+  global best and the wall time to reach the optimal length (if known).
+*/
+void ExecuteIslandGa(const tsp_t& tsp, size_t population_size, double mutation_rate, double crossover_rate, const tsp_options_t& options)
+{
+	typedef IslandModel<TravelingSalespersonGA> TspIslandModel;
+	const uint32_t kNumTrials = 30;
+	const uint32_t kMaxGenerations = 50000;
+	TspIslandModel::Topology topology;
+	if (!TspIslandModel::ParseTopology(options.topology, &topology))
+	{
+		LOGFATAL("Unknown island topology %s", options.topology.c_str());
+	}
+	std::ofstream fout;
+	std::stringstream filename;
+	filename << "TSP_" << tsp.name << "_islands" << options.num_islands << "_" << options.topology << "_pop" << population_size << "_mut" << mutation_rate << "_xover" << crossover_rate << ".csv";
+	fout.open(filename.str());
+	fout << "Trial,Island,Generations,BestLength,SecondsToBest,Immigrants,DroppedEmigrants" << std::endl;
+	//every island's GA shares these
+	DistanceOracle oracle;
+	BuildDistanceOracle(tsp, oracle);
+	SpatialGrid city_grid;
+	BuildCityGrid(tsp, oracle, city_grid);
+	//the islands stop as soon as one of them finds the optimal route, if it is known
+	double optimal_length = 0.0;
+	if (tsp.optimal_route.size() > 0)
+	{
+		optimal_length = (double)oracle.ClosedTourLength(0, tsp.optimal_route.begin(), tsp.optimal_route.end());
+	}
+	LOGINFO("The optimal length is %lf", optimal_length);
+	double total_best_length = 0.0;
+	double total_seconds_to_optimal = 0.0;
+	uint32_t num_optimal = 0;
+	for (uint32_t trial = 0; trial < kNumTrials; ++trial)
+	{
+		TspIslandModel model(options.num_islands, topology, options.migration_interval, tsp.num_cities - 1);
+		LOGINFO("Starting trial %u with %u islands and %zu migration edges", trial, model.GetNumIslands(), model.GetNumEdges());
+		model.Run(rng::StreamSeed(options.seed, trial), kMaxGenerations, optimal_length, [&](uint32_t island)
+		{
+			std::unique_ptr<TravelingSalespersonGA> ga(new TravelingSalespersonGA(population_size, tsp.num_cities, mutation_rate, crossover_rate, tsp, oracle, city_grid));
+			ConfigureGa(*ga, options);
+			return ga;
+		});
+		const std::vector<island_report_t>& reports = model.GetIslandReports();
+		uint64_t total_generations = 0;
+		for (uint32_t island = 0; island < reports.size(); ++island)
+		{
+			const island_report_t& report = reports[island];
+			fout << trial << "," << island << "," << report.generations << "," << report.best_length << "," << report.seconds_to_best << "," << report.num_immigrants << "," << report.num_dropped_emigrants << std::endl;
+			LOGINFO("Trial %u island %u: best %lf after %lf seconds, %llu immigrants", trial, island, report.best_length, report.seconds_to_best, (unsigned long long)report.num_immigrants);
+			total_generations += report.generations;
+		}
+		const island_report_t& best = model.GetGlobalBest();
+		std::stringstream path;
+		path << "Trial " << trial << " Shortest path: ";
+		for (route_t::const_iterator city_it = best.best_route.begin(); city_it != best.best_route.end(); ++city_it)
+		{
+			//add one to the city ID because the files are 1-indexed
+			path << (*city_it) + 1 << ", ";
+		}
+		LOGDEBUG("%s", path.str().c_str());
+		double seconds_to_optimal = model.GetSecondsToTarget();
+		if (seconds_to_optimal >= 0.0)
+		{
+			total_seconds_to_optimal += seconds_to_optimal;
+			num_optimal++;
+		}
+		total_best_length += best.best_length;
+		LOGINFO("Final result: trial %u global best %lf, %lf seconds to optimal, %lf generations/sec", trial, best.best_length, seconds_to_optimal, total_generations / model.GetElapsedSeconds());
+		fout << "Trial " << trial << " global best: " << best.best_length << " seconds to optimal: " << seconds_to_optimal << " wall seconds: " << model.GetElapsedSeconds() << " generations/sec: " << total_generations / model.GetElapsedSeconds() << std::endl;
 		fout << path.str() << std::endl;
-		fout.flush();
-		fout << "Trial "<<trial<<" begin summary section" << std::endl;
-		//scale all of the computed values
-		for (uint32_t generation_index = 0; generation_index < 50000; ++generation_index)
+	}
+	fout << "Mean global best: " << total_best_length / kNumTrials << std::endl;
+	fout << "Trials reaching optimal: " << num_optimal << " mean seconds to optimal: " << (num_optimal > 0 ? total_seconds_to_optimal / num_optimal : -1.0) << std::endl;
+	fout.close();
+}
+
+//This is the route evaluation the GA used before DistanceOracle existed. It is
+//only kept so BenchmarkRouteEvaluation has a baseline to compare against
+double ComputeRouteLengthFromCoordinates(const tsp_t& tsp, route_t member)
+{
+	ion::Point2<double> last_city = tsp.cities[0];
+	double tour_length = 0.0;
+	for (route_t::iterator city_it = member.begin(); city_it != member.end(); ++city_it)
+	{
+		ion::Point2<double> city_coord = tsp.cities[*city_it];
+		tour_length += std::round(last_city.distance(city_coord));
+		last_city = city_coord;
+	}
+	tour_length += std::round(last_city.distance(tsp.cities[0]));
+	return tour_length;
+}
+
+/*
+  Measures route evaluations per second for the coordinate based evaluation
+  and for each DistanceOracle storage mode on the same set of random routes.
+
+  Each method is run repeatedly until at least min_seconds have elapsed so the
+  small instances get enough iterations to be measured meaningfully. The sum
+  of all lengths is checked against the baseline to make sure every method is
+  computing the same thing.
+*/
+void BenchmarkRouteEvaluation(const tsp_t& tsp, size_t num_routes, double min_seconds)
+{
+	std::vector<route_t> routes(num_routes);
+	for (std::vector<route_t>::iterator route_it = routes.begin(); route_it != routes.end(); ++route_it)
+	{
+		route_it->resize(tsp.num_cities - 1);
+		for (route_t::iterator city_it = route_it->begin(); city_it != route_it->end(); ++city_it)
+		{
+			(*city_it) = (uint32_t)((city_it - route_it->begin()) + 1);
+		}
+		for (route_t::iterator city_it = route_it->begin(); city_it != route_it->end(); ++city_it)
+		{
+			size_t city_to_swap = rng::randull(0, route_it->size() - 1);
+			std::iter_swap(city_it, route_it->begin() + city_to_swap);
+		}
+	}
+	typedef std::chrono::steady_clock clock;
+	//baseline
+	double baseline_sum = 0.0;
+	uint64_t baseline_evals = 0;
+	clock::time_point start = clock::now();
+	double elapsed = 0.0;
+	while (elapsed < min_seconds)
+	{
+		baseline_sum = 0.0;
+		for (std::vector<route_t>::const_iterator route_it = routes.begin(); route_it != routes.end(); ++route_it)
+		{
+			baseline_sum += ComputeRouteLengthFromCoordinates(tsp, *route_it);
+		}
+		baseline_evals += routes.size();
+		elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	}
+	double baseline_rate = baseline_evals / elapsed;
+	printf("%s (%zu cities)\n", tsp.name.c_str(), tsp.num_cities);
+	printf("  %-20s %14.0lf evals/sec\n", "coordinates", baseline_rate);
+	LOGINFO("%s coordinates: %lf evals/sec", tsp.name.c_str(), baseline_rate);
+
+	//force each storage mode by giving the oracle a budget that only fits that mode
+	size_t num_cities = tsp.num_cities;
+	size_t budgets[3] = { DistanceOracle::kDefaultMemoryBudget, num_cities * (num_cities - 1) / 2 * sizeof(int32_t), 0 };
+	const char* mode_names[3] = { "dense matrix", "triangular matrix", "on the fly" };
+	for (uint32_t mode_index = 0; mode_index < 3; ++mode_index)
+	{
+		DistanceOracle oracle(tsp.cities, budgets[mode_index]);
+		double oracle_sum = 0.0;
+		uint64_t oracle_evals = 0;
+		start = clock::now();
+		elapsed = 0.0;
+		while (elapsed < min_seconds)
 		{
-			if (num_hits[generation_index] == 0)
+			oracle_sum = 0.0;
+			for (std::vector<route_t>::const_iterator route_it = routes.begin(); route_it != routes.end(); ++route_it)
 			{
-				break;
+				oracle_sum += (double)oracle.ClosedTourLength(0, route_it->begin(), route_it->end());
 			}
-			max_fitness[generation_index] /= num_hits[generation_index];
-			min_fitness[generation_index] /= num_hits[generation_index];
-			avg_fitness[generation_index] /= num_hits[generation_index];
-			num_evals[generation_index] /= num_hits[generation_index];
-			fout.flush();
-			fout << generation_index << "," << 1.0/min_fitness[generation_index] << "," << 1.0/max_fitness[generation_index] << "," << 1.0/avg_fitness[generation_index] << "," << num_evals[generation_index] << std::endl;
-			fout.flush();
+			oracle_evals += routes.size();
+			elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+		double oracle_rate = oracle_evals / elapsed;
+		if (oracle_sum != baseline_sum)
+		{
+			LOGERROR("%s: %s computed a total length of %lf, expected %lf", tsp.name.c_str(), mode_names[mode_index], oracle_sum, baseline_sum);
 		}
-		fout << "End summary section" << std::endl;
+		printf("  %-20s %14.0lf evals/sec (%.2lfx)\n", mode_names[mode_index], oracle_rate, oracle_rate / baseline_rate);
+		LOGINFO("%s %s: %lf evals/sec (%lfx)", tsp.name.c_str(), mode_names[mode_index], oracle_rate, oracle_rate / baseline_rate);
 	}
+	fflush(stdout);
 }
 
+//writes a random EUC_2D instance with num_cities cities for BenchmarkParsing
+std::string WriteRandomInstance(size_t num_cities)
+{
+	std::stringstream filename;
+	filename << "TSP_bench_parse_" << num_cities << ".tsp";
+	FILE* file = fopen(filename.str().c_str(), "w");
+	if (file == NULL)
+	{
+		LOGFATAL("Couldn't create %s", filename.str().c_str());
+	}
+	fprintf(file, "NAME : random%zu\nTYPE : TSP\nDIMENSION : %zu\nEDGE_WEIGHT_TYPE : EUC_2D\nNODE_COORD_SECTION\n", num_cities, num_cities);
+	for (size_t city = 0; city < num_cities; ++city)
+	{
+		fprintf(file, "%zu %.4lf %.4lf\n", city + 1, rng::randlf(0.0, 1000000.0), rng::randlf(0.0, 1000000.0));
+	}
+	fprintf(file, "EOF\n");
+	fclose(file);
+	return filename.str();
+}
+
+/*
+  Measures how fast LoadTsplibInstance parses filename, and for instances
+  with coordinates compares it with the old stream based parser and checks
+  that both read the same coordinates. Each parser is run until at least
+  min_seconds have elapsed and the fastest load is reported.
+*/
+void BenchmarkParsing(const std::string& filename, double min_seconds)
+{
+	typedef std::chrono::steady_clock clock;
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		LOGERROR("Couldn't open %s", filename.c_str());
+		return;
+	}
+	double megabytes = file.Size() / (1024.0 * 1024.0);
+	file.Close();
+	tsplib_instance_t instance;
+	double fastest = std::numeric_limits<double>::max();
+	clock::time_point start = clock::now();
+	do
+	{
+		clock::time_point load_start = clock::now();
+		if (!LoadTsplibInstance(filename, &instance))
+		{
+			return;
+		}
+		fastest = std::min(fastest, std::chrono::duration<double>(clock::now() - load_start).count());
+	} while (std::chrono::duration<double>(clock::now() - start).count() < min_seconds);
+	printf("%s (%zu cities, %.2lf MB)\n", filename.c_str(), instance.dimension, megabytes);
+	printf("  %-10s %10.4lf sec %10.1lf MB/sec %14.0lf cities/sec\n", "tsplib", fastest, megabytes / fastest, instance.dimension / fastest);
+	LOGINFO("%s tsplib: %lf sec, %lf MB/sec", filename.c_str(), fastest, megabytes / fastest);
+	if (instance.metric == DistanceOracle::EXPLICIT)
+	{
+		fflush(stdout);
+		return;
+	}
+	std::vector<ion::Point2<double>> stream_cities;
+	double stream_fastest = std::numeric_limits<double>::max();
+	start = clock::now();
+	do
+	{
+		clock::time_point load_start = clock::now();
+		stream_cities = ReadCitiesWithStreams(filename);
+		stream_fastest = std::min(stream_fastest, std::chrono::duration<double>(clock::now() - load_start).count());
+	} while (std::chrono::duration<double>(clock::now() - start).count() < min_seconds);
+	printf("  %-10s %10.4lf sec %10.1lf MB/sec %14.0lf cities/sec (tsplib is %.1lfx faster)\n", "streams", stream_fastest, megabytes / stream_fastest, instance.dimension / stream_fastest, stream_fastest / fastest);
+	LOGINFO("%s streams: %lf sec, %lf MB/sec", filename.c_str(), stream_fastest, megabytes / stream_fastest);
+	size_t num_different = 0;
+	for (size_t city = 0; city < instance.cities.size() && city < stream_cities.size(); ++city)
+	{
+		if (instance.cities[city].x1_ != stream_cities[city].x1_ || instance.cities[city].x2_ != stream_cities[city].x2_)
+		{
+			num_different++;
+		}
+	}
+	if (num_different != 0 || instance.cities.size() != stream_cities.size())
+	{
+		LOGERROR("%s: the parsers disagree on %zu of the coordinates", filename.c_str(), num_different);
+	}
+	fflush(stdout);
+}
+
+//This is the PMX the GA used before PermutationCrossover existed, it searches
+//both mates with std::find for every index. Only kept for BenchmarkCrossover
+void PartiallyMappedCrossoverWithFind(route_t& mate1, route_t& mate2, size_t crossover_begin, size_t crossover_end)
+{
+	for (size_t crossover_index = crossover_begin; crossover_index <= crossover_end; ++crossover_index)
+	{
+		uint32_t city_in_mate2 = mate2[crossover_index];
+		uint32_t city_in_mate1 = mate1[crossover_index];
+		route_t::iterator mate2_city_in_mate1_it = std::find(mate1.begin(), mate1.end(), city_in_mate2);
+		route_t::iterator mate1_city_in_mate2_it = std::find(mate2.begin(), mate2.end(), city_in_mate1);
+		*mate2_city_in_mate1_it = mate1[crossover_index];
+		*mate1_city_in_mate2_it = mate2[crossover_index];
+		mate1[crossover_index] = city_in_mate2;
+		mate2[crossover_index] = city_in_mate1;
+	}
+}
+
+/*
+  Measures crossover pairs per second on random routes of num_cities cities
+  for the std::find based PMX and each PermutationCrossover operator.
+
+  Every iteration copies the two parents into the child buffers first, since
+  that is what Select does, so the copy is included in the timing.
+*/
+void BenchmarkCrossover(size_t num_cities, double min_seconds)
+{
+	size_t route_length = num_cities - 1;
+	route_t parents[2];
+	route_t parent_positions[2];
+	for (uint32_t parent_index = 0; parent_index < 2; ++parent_index)
+	{
+		parents[parent_index].resize(route_length);
+		for (uint32_t index = 0; index < route_length; ++index)
+		{
+			parents[parent_index][index] = index + 1;
+		}
+		for (size_t index = 0; index < route_length; ++index)
+		{
+			std::swap(parents[parent_index][index], parents[parent_index][rng::randull(0, route_length - 1)]);
+		}
+		parent_positions[parent_index].resize(num_cities);
+		for (uint32_t index = 0; index < route_length; ++index)
+		{
+			parent_positions[parent_index][parents[parent_index][index]] = index;
+		}
+	}
+	route_t children[2] = { parents[0], parents[1] };
+	route_t child_positions[2] = { parent_positions[0], parent_positions[1] };
+	//use the same crossover points for every method
+	const size_t kNumPoints = 64;
+	size_t crossover_begin[kNumPoints];
+	size_t crossover_end[kNumPoints];
+	for (size_t point_index = 0; point_index < kNumPoints; ++point_index)
+	{
+		crossover_begin[point_index] = rng::randull(0, route_length - 2);
+		crossover_end[point_index] = rng::randull(crossover_begin[point_index] + 1, route_length - 1);
+	}
+	typedef std::chrono::steady_clock clock;
+	printf("%zu cities\n", num_cities);
+	const char* method_names[4] = { "PMX with std::find", "PMX", "OX", "ERX" };
+	PermutationCrossover::Operator operators[4] = { PermutationCrossover::PARTIALLY_MAPPED, PermutationCrossover::PARTIALLY_MAPPED, PermutationCrossover::ORDER, PermutationCrossover::EDGE_RECOMBINATION };
+	double baseline_rate = 0.0;
+	for (uint32_t method_index = 0; method_index < 4; ++method_index)
+	{
+		PermutationCrossover crossover(operators[method_index], route_length);
+		uint64_t num_pairs = 0;
+		clock::time_point start = clock::now();
+		double elapsed = 0.0;
+		while (elapsed < min_seconds)
+		{
+			for (size_t point_index = 0; point_index < kNumPoints && (num_pairs == 0 || elapsed < min_seconds); ++point_index)
+			{
+				std::copy(parents[0].begin(), parents[0].end(), children[0].begin());
+				std::copy(parents[1].begin(), parents[1].end(), children[1].begin());
+				if (method_index == 0)
+				{
+					PartiallyMappedCrossoverWithFind(children[0], children[1], crossover_begin[point_index], crossover_end[point_index]);
+				} else
+				{
+					std::copy(parent_positions[0].begin(), parent_positions[0].end(), child_positions[0].begin());
+					std::copy(parent_positions[1].begin(), parent_positions[1].end(), child_positions[1].begin());
+					crossover.Cross(children[0].data(), child_positions[0].data(), children[1].data(), child_positions[1].data(), crossover_begin[point_index], crossover_end[point_index]);
+				}
+				num_pairs++;
+				elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			}
+		}
+		double rate = num_pairs / elapsed;
+		if (method_index == 0)
+		{
+			baseline_rate = rate;
+		}
+		printf("  %-20s %14.0lf pairs/sec (%.2lfx)\n", method_names[method_index], rate, rate / baseline_rate);
+		LOGINFO("%zu cities %s: %lf pairs/sec (%lfx)", num_cities, method_names[method_index], rate, rate / baseline_rate);
+	}
+	fflush(stdout);
+}
+
+/*
+  Measures how long the GA takes to find the optimal route of tsp with and
+  without the memetic mode. Each configuration is run num_trials times, and
+  a trial which hasn't found the optimum after max_seconds is counted as a
+  failure.
+*/
+void BenchmarkLocalSearch(const tsp_t& tsp, uint32_t num_trials, double max_seconds)
+{
+	typedef struct configuration_s
+	{
+		const char* name;
+		bool elite;
+		double fraction;
+	} configuration_t;
+	const configuration_t configurations[3] = { { "GA only", false, 0.0 }, { "local search on elite", true, 0.0 }, { "elite + 10% of members", true, 0.1 } };
+	tsp_options_t options;
+	options.selection = ParentSelector::FITNESS_PROPORTIONAL;
+	options.tournament_size = 2;
+	options.crossover = PermutationCrossover::PARTIALLY_MAPPED;
+	options.local_search_moves = 1000;
+	options.local_search_neighbors = 8;
+	DistanceOracle oracle;
+	BuildDistanceOracle(tsp, oracle);
+	SpatialGrid city_grid;
+	BuildCityGrid(tsp, oracle, city_grid);
+	printf("%s (%zu cities)\n", tsp.name.c_str(), tsp.num_cities);
+	for (uint32_t configuration_index = 0; configuration_index < 3; ++configuration_index)
+	{
+		const configuration_t& configuration = configurations[configuration_index];
+		options.local_search_elite = configuration.elite;
+		options.local_search_fraction = configuration.fraction;
+		uint32_t num_optimal = 0;
+		double total_seconds = 0.0;
+		double total_length = 0.0;
+		for (uint32_t trial = 0; trial < num_trials; ++trial)
+		{
+			rng::Seed(rng::StreamSeed(0, trial));
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			double elapsed = 0.0;
+			TravelingSalespersonGA ga(100, tsp.num_cities, 0.01, 0.67, tsp, oracle, city_grid);
+			ConfigureGa(ga, options);
+			while (ga.GetMaxFitness() < ga.optimal_fitness_ && elapsed < max_seconds)
+			{
+				ga.NextGeneration();
+				elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			if (ga.GetMaxFitness() >= ga.optimal_fitness_)
+			{
+				num_optimal++;
+				total_seconds += elapsed;
+			}
+			total_length += 1.0 / ga.GetMaxFitness();
+		}
+		double mean_seconds = num_optimal > 0 ? total_seconds / num_optimal : -1.0;
+		printf("  %-24s %u/%u optimal, mean %8.3lf seconds to optimal, mean best length %.1lf\n", configuration.name, num_optimal, num_trials, mean_seconds, total_length / num_trials);
+		LOGINFO("%s %s: %u/%u optimal, mean %lf seconds to optimal, mean best length %lf", tsp.name.c_str(), configuration.name, num_optimal, num_trials, mean_seconds, total_length / num_trials);
+	}
+	fflush(stdout);
+}
+
+#ifdef COUNT_ALLOCATIONS
+/*
+  Runs a GA on tsp with every feature which has per generation buffers
+  turned on (crossover, the midpoint mutation and the memetic mode), lets it
+  warm up so every buffer has reached its final size, then counts the heap
+  allocations made by the following generations. Returns the count, which
+  should be 0.
+*/
+uint64_t CheckAllocations(const tsp_t& tsp, uint32_t num_generations)
+{
+	const uint32_t kWarmupGenerations = 100;
+	tsp_options_t options;
+	options.tournament_size = 2;
+	options.local_search_elite = true;
+	options.local_search_fraction = 0.1;
+	options.local_search_moves = 100;
+	options.local_search_neighbors = 8;
+	const char* selection_names[4] = { "fitness", "rank", "sus", "tournament" };
+	const char* crossover_names[3] = { "pmx", "ox", "erx" };
+	DistanceOracle oracle;
+	BuildDistanceOracle(tsp, oracle);
+	SpatialGrid city_grid;
+	BuildCityGrid(tsp, oracle, city_grid);
+	uint64_t total_allocations = 0;
+	for (uint32_t selection_index = 0; selection_index < 4; ++selection_index)
+	{
+		for (uint32_t crossover_index = 0; crossover_index < 3; ++crossover_index)
+		{
+			options.selection = (ParentSelector::Method)selection_index;
+			options.crossover = (PermutationCrossover::Operator)crossover_index;
+			TravelingSalespersonGA ga(100, tsp.num_cities, 0.01, 0.67, tsp, oracle, city_grid);
+			ConfigureGa(ga, options);
+			for (uint32_t generation = 0; generation < kWarmupGenerations; ++generation)
+			{
+				ga.NextGeneration();
+			}
+			uint64_t allocations_before = NumAllocations();
+			for (uint32_t generation = 0; generation < num_generations; ++generation)
+			{
+				ga.NextGeneration();
+			}
+			uint64_t allocations = NumAllocations() - allocations_before;
+			total_allocations += allocations;
+			printf("  %-10s %-4s %llu allocations in %u generations\n", selection_names[selection_index], crossover_names[crossover_index], (unsigned long long)allocations, num_generations);
+			LOGINFO("%s %s %s: %llu allocations in %u generations", tsp.name.c_str(), selection_names[selection_index], crossover_names[crossover_index], (unsigned long long)allocations, num_generations);
+		}
+	}
+	fflush(stdout);
+	return total_allocations;
+}
+#endif
+
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	//Usage: traveling-salesperson.exe --bench-distance eil51.tsp lin105.tsp lin318.tsp
+	if (argc >= 3 && std::string(argv[1]) == "--bench-distance")
+	{
+		ion::LogInit("TSP_bench_distance.log");
+		for (int arg_index = 2; arg_index < argc; ++arg_index)
+		{
+			tsp_t tsp = ReadTspInput(argv[arg_index], "");
+			if (tsp.num_cities < 2)
+			{
+				LOGERROR("Failed to load TSP info from %s", argv[arg_index]);
+				continue;
+			}
+			if (tsp.metric != DistanceOracle::EUC_2D)
+			{
+				LOGERROR("%s isn't EUC_2D, the benchmark's baseline only computes EUC_2D distances", argv[arg_index]);
+				continue;
+			}
+			BenchmarkRouteEvaluation(tsp, 150, 2.0);
+		}
+		return 0;
+	}
+	//Usage: traveling-salesperson.exe --bench-parse [file.tsp | num_cities ...], a number parses a generated random instance of that size
+	if (argc >= 2 && std::string(argv[1]) == "--bench-parse")
+	{
+		ion::LogInit("TSP_bench_parse.log");
+		std::vector<std::string> filenames;
+		for (int arg_index = 2; arg_index < argc; ++arg_index)
+		{
+			size_t num_cities = (size_t)atoll(argv[arg_index]);
+			filenames.push_back(num_cities > 0 ? WriteRandomInstance(num_cities) : std::string(argv[arg_index]));
+		}
+		if (filenames.empty())
+		{
+			filenames.push_back(WriteRandomInstance(100000));
+		}
+		for (std::vector<std::string>::iterator filename_it = filenames.begin(); filename_it != filenames.end(); ++filename_it)
+		{
+			BenchmarkParsing(*filename_it, 1.0);
+		}
+		return 0;
+	}
+	//Usage: traveling-salesperson.exe --bench-crossover [num_cities ...]
+	if (argc >= 2 && std::string(argv[1]) == "--bench-crossover")
+	{
+		ion::LogInit("TSP_bench_crossover.log");
+		std::vector<size_t> city_counts;
+		for (int arg_index = 2; arg_index < argc; ++arg_index)
+		{
+			city_counts.push_back((size_t)atoi(argv[arg_index]));
+		}
+		if (city_counts.empty())
+		{
+			size_t default_counts[4] = { 1000, 2000, 5000, 10000 };
+			city_counts.assign(default_counts, default_counts + 4);
+		}
+		for (std::vector<size_t>::iterator count_it = city_counts.begin(); count_it != city_counts.end(); ++count_it)
+		{
+			BenchmarkCrossover(*count_it, 1.0);
+		}
+		return 0;
+	}
+	//Usage: traveling-salesperson.exe --bench-local-search eil51.tsp eil51.opt.tour [berlin52.tsp berlin52.opt.tour ...]
+	if (argc >= 4 && std::string(argv[1]) == "--bench-local-search")
 	{
-		printf("Usage: traveling-salesperson-win-x64-Debug.exe input_file.tsp optimal_file.tsp");
+		ion::LogInit("TSP_bench_local_search.log");
+		for (int arg_index = 2; arg_index + 1 < argc; arg_index += 2)
+		{
+			tsp_t tsp = ReadTspInput(argv[arg_index], argv[arg_index + 1]);
+			if (tsp.num_cities < 5 || tsp.optimal_route.empty())
+			{
+				LOGERROR("Failed to load TSP info from %s and %s", argv[arg_index], argv[arg_index + 1]);
+				continue;
+			}
+			BenchmarkLocalSearch(tsp, 5, 30.0);
+		}
+		return 0;
+	}
+#ifdef COUNT_ALLOCATIONS
+	//Usage: traveling-salesperson.exe --check-allocations eil51.tsp [generations]
+	if (argc >= 3 && std::string(argv[1]) == "--check-allocations")
+	{
+		ion::LogInit("TSP_check_allocations.log");
+		tsp_t tsp = ReadTspInput(argv[2], "");
+		if (tsp.num_cities < 5)
+		{
+			LOGFATAL("Failed to load TSP info from %s", argv[2]);
+		}
+		uint32_t num_generations = argc >= 4 ? (uint32_t)atoi(argv[3]) : 1000;
+		printf("%s (%zu cities)\n", tsp.name.c_str(), tsp.num_cities);
+		uint64_t allocations = CheckAllocations(tsp, num_generations);
+		if (allocations != 0)
+		{
+			LOGERROR("Steady state generations made %llu heap allocations", (unsigned long long)allocations);
+			return 1;
+		}
+		printf("No heap allocations in steady state generations\n");
+		return 0;
+	}
+#endif
+	//Usage: traveling-salesperson.exe --convert-stats in.stats out.csv
+	if (argc >= 4 && std::string(argv[1]) == "--convert-stats")
+	{
+		return ConvertStatistics(argv[2], argv[3]) ? 0 : 1;
+	}
+	const std::set<std::string> kFlags = {"local-search-elite", "resume"};
+	CommandLine command_line(argc, argv, kFlags);
+	if (command_line.NumPositional() < 4)
+	{
+		printf("Usage: traveling-salesperson-win-x64-Debug.exe input_file.tsp [optimal_file.tsp] population mutation crossover\n"
+			"  --selection fitness|rank|sus|tournament  parent selection method (default fitness)\n"
+			"  --tournament-size k                      members per tournament (default 2)\n"
+			"  --crossover pmx|ox|erx                   crossover operator (default pmx)\n"
+			"  --seed n                                 base random seed (default is the time)\n"
+			"  --threads n                              trials to run at once (default one per hardware thread)\n"
+			"  --islands n                              run n populations as an island model (default 1, no islands)\n"
+			"  --migration-interval k                   generations between island migrations (default 50)\n"
+			"  --topology ring|torus                    which islands exchange migrants (default ring)\n"
+			"  --local-search-elite                     improve the elite with 2-opt/Or-opt every generation\n"
+			"  --local-search-fraction f                also improve this fraction of the other members (default 0)\n"
+			"  --local-search-moves m                   improving moves per generation (default 1000)\n"
+			"  --local-search-neighbors k               candidate neighbors per city (default 8)\n"
+			"  --stats-format csv|binary                format of the statistics file (default csv)\n"
+			"  --checkpoint-interval s                  save progress every s seconds to resume after a crash (default 0, off)\n"
+			"  --resume                                 continue from the checkpoint of an interrupted run with the same arguments\n"
+			"Convert a binary statistics file: traveling-salesperson.exe --convert-stats in.stats out.csv\n");
 		fflush(stdout);
 		return -1;
 	}
@@ -459,21 +1551,46 @@ int main(int argc, char* argv[])
 	uint32_t population_choice;
 	double mutation_choice;
 	double crossover_choice;
-	if (argc == 6)
+	if (command_line.NumPositional() == 5)
 	{
-		optimal_filename = argv[2];
-		population_choice = atoi(argv[3]);
-		mutation_choice = atof(argv[4]);
-		crossover_choice = atof(argv[5]);
+		optimal_filename = command_line.GetPositional(1);
+		population_choice = atoi(command_line.GetPositional(2).c_str());
+		mutation_choice = atof(command_line.GetPositional(3).c_str());
+		crossover_choice = atof(command_line.GetPositional(4).c_str());
 	} else
 	{
-		population_choice = atoi(argv[2]);
-		mutation_choice = atof(argv[3]);
-		crossover_choice = atof(argv[4]);
+		population_choice = atoi(command_line.GetPositional(1).c_str());
+		mutation_choice = atof(command_line.GetPositional(2).c_str());
+		crossover_choice = atof(command_line.GetPositional(3).c_str());
+	}
+	tsp_options_t options;
+	if (!ParentSelector::ParseMethod(command_line.GetString("selection", "fitness"), &options.selection))
+	{
+		LOGFATAL("Unknown selection method %s", command_line.GetString("selection", "").c_str());
+	}
+	int64_t tournament_size = command_line.GetInt("tournament-size", 2);
+	if (tournament_size < 1 || tournament_size > (int64_t)population_choice)
+	{
+		LOGFATAL("--tournament-size must be between 1 and the population size %u, not %s", population_choice, command_line.GetString("tournament-size", "").c_str());
+	}
+	options.tournament_size = (uint32_t)tournament_size;
+	std::string crossover_name = command_line.GetString("crossover", "pmx");
+	if (crossover_name == "pmx")
+	{
+		options.crossover = PermutationCrossover::PARTIALLY_MAPPED;
+	} else if (crossover_name == "ox")
+	{
+		options.crossover = PermutationCrossover::ORDER;
+	} else if (crossover_name == "erx")
+	{
+		options.crossover = PermutationCrossover::EDGE_RECOMBINATION;
+	} else
+	{
+		LOGFATAL("Unknown crossover operator %s", crossover_name.c_str());
 	}
 
-	tsp_t tsp = ReadTspInput(argv[1], optimal_filename);
-	if (tsp.cities.size() == 0)
+	tsp_t tsp = ReadTspInput(command_line.GetPositional(0), optimal_filename);
+	if (tsp.num_cities == 0)
 	{
 		LOGFATAL("Failed to load TSP info");
 	}
@@ -486,7 +1603,27 @@ int main(int argc, char* argv[])
 	SignalHandlerPointer previousHandler;
 	previousHandler = signal(SIGSEGV, SignalHandler);
 	
-	std::srand((uint32_t)time(NULL)+1);
+	options.seed = (uint64_t)command_line.GetInt("seed", (int64_t)time(NULL) + 1);
+	options.num_threads = (uint32_t)command_line.GetInt("threads", 0);
+	options.num_islands = (uint32_t)command_line.GetInt("islands", 1);
+	options.migration_interval = (uint32_t)command_line.GetInt("migration-interval", 50);
+	options.topology = command_line.GetString("topology", "ring");
+	options.local_search_elite = command_line.Has("local-search-elite");
+	options.local_search_fraction = command_line.GetDouble("local-search-fraction", 0.0);
+	options.local_search_moves = (uint32_t)command_line.GetInt("local-search-moves", 1000);
+	options.local_search_neighbors = (uint32_t)command_line.GetInt("local-search-neighbors", 8);
+	if (!StatisticsWriter::ParseFormat(command_line.GetString("stats-format", "csv"), &options.stats_format))
+	{
+		LOGFATAL("Unknown statistics format %s", command_line.GetString("stats-format", "").c_str());
+	}
+	options.checkpoint_interval = command_line.GetDouble("checkpoint-interval", 0.0);
+	options.resume = command_line.Has("resume");
+	if (options.num_islands > 1 && (options.checkpoint_interval > 0.0 || options.resume))
+	{
+		LOGFATAL("Checkpoints aren't supported with --islands");
+	}
+	LOGINFO("Using seed %llu, rerun with --seed %llu to reproduce this run", (unsigned long long)options.seed, (unsigned long long)options.seed);
+	std::srand((uint32_t)options.seed);
 
 	uint32_t population_set[3] = { 50, 100, 150 };
 	double mutation_set[4] = { 0.0001, 0.001, 0.01 , 0.1};
@@ -497,7 +1634,13 @@ int main(int argc, char* argv[])
 	//	{
 	//		for (uint32_t crossover_choice = 0; crossover_choice < 3; ++crossover_choice)
 	//		{
-	ExecuteGa(tsp, population_choice, mutation_choice, crossover_choice);
+	if (options.num_islands > 1)
+	{
+		ExecuteIslandGa(tsp, population_choice, mutation_choice, crossover_choice, options);
+	} else
+	{
+		ExecuteGa(tsp, population_choice, mutation_choice, crossover_choice, options);
+	}
 	LOGINFO("Completed pop %d, mutation %d, crossover %d", population_choice, mutation_choice, crossover_choice);
 	//		}
 	//	}
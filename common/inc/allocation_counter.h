@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_ALLOCATION_COUNTER_H_
+#define CS776_ALLOCATION_COUNTER_H_
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+/*
+Counts every heap allocation made through operator new, so the apps can
+check that their steady state generations don't allocate.
+
+The count is only kept if COUNT_ALLOCATIONS is defined, in which case this
+header replaces every form of the global operator new and operator delete
+(array, nothrow and, with C++17, aligned) and must be included from exactly
+one source file. That costs an atomic increment on a shared counter per
+allocation, so only the CheckAllocations build configuration defines it;
+the Debug and Release builds keep the default allocator and
+NumAllocations always returns 0 in them.
+*/
+inline std::atomic<uint64_t>& AllocationCount()
+{
+	static std::atomic<uint64_t> count(0);
+	return count;
+}
+inline uint64_t NumAllocations()
+{
+	return AllocationCount().load(std::memory_order_relaxed);
+}
+inline bool CountingAllocations()
+{
+#ifdef COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef COUNT_ALLOCATIONS
+//counts and makes one allocation, NULL if there's no memory
+inline void* CountedAllocate(size_t size)
+{
+	AllocationCount().fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new(size_t size)
+{
+	void* memory = CountedAllocate(size);
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+#ifdef __cpp_aligned_new
+//counts and makes one allocation aligned to alignment, NULL if there's no memory
+inline void* CountedAllocateAligned(size_t size, std::align_val_t alignment)
+{
+	AllocationCount().fetch_add(1, std::memory_order_relaxed);
+	size_t align = (size_t)alignment;
+#ifdef _MSC_VER
+	return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+	//aligned_alloc wants a nonzero multiple of the alignment
+	size_t rounded = size == 0 ? align : (size + align - 1) / align * align;
+	return std::aligned_alloc(align, rounded);
+#endif
+}
+inline void FreeAligned(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* memory = CountedAllocateAligned(size, alignment);
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+#endif
+#endif
+#endif //CS776_ALLOCATION_COUNTER_H_
@@ -0,0 +1,289 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_BIT_CHROMOSOME_H_
+#define CS776_BIT_CHROMOSOME_H_
+#include "random.h"
+#include "simd.h"
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//the number of set bits in value
+inline uint32_t PopCount64(uint64_t value)
+{
+#ifdef _MSC_VER
+	return (uint32_t)__popcnt64(value);
+#else
+	return (uint32_t)__builtin_popcountll(value);
+#endif
+}
+
+//a word with the low num_bits bits set, num_bits in [0, 64]
+inline uint64_t LowBitsMask(size_t num_bits)
+{
+	return num_bits >= 64 ? ~0ull : (1ull << num_bits) - 1;
+}
+
+/*
+BitChromosome is a fixed length bit string packed 64 bits to a word. Bit i
+is bit i % 64 of word i / 64, and the bits past kNumBits in the last word
+are always 0, so whole words can be compared, counted and copied.
+
+Everything works a word at a time: mutation flips bits by XORing in a mask,
+crossover swaps the bits under a mask between two chromosomes, Count is a
+popcount per word and Field pulls a run of bits out with at most two shifts.
+It is trivially copyable so a FlatPopulation can hold it.
+*/
+template<size_t kNumBits>
+class BitChromosome
+{
+public:
+	static_assert(kNumBits > 0, "a chromosome needs at least one bit");
+	static const size_t kNumWords = (kNumBits + 63) / 64;
+	//the bits of the last word which are part of the chromosome
+	static const uint64_t kLastWordMask = (kNumBits % 64 == 0) ? ~0ull : ((1ull << (kNumBits % 64)) - 1);
+
+	//fills the chromosome with uniformly random bits from the calling thread's rng stream
+	void Randomize()
+	{
+		for (size_t word = 0; word < kNumWords; ++word)
+		{
+			words_[word] = rng::ThreadEngine()();
+		}
+		words_[kNumWords - 1] &= kLastWordMask;
+	}
+	inline bool Get(size_t bit) const
+	{
+		return ((words_[bit / 64] >> (bit % 64)) & 1) != 0;
+	}
+	inline void Flip(size_t bit)
+	{
+		words_[bit / 64] ^= 1ull << (bit % 64);
+	}
+	//flips the bits of word which are set in mask
+	inline void FlipMask(size_t word, uint64_t mask)
+	{
+		words_[word] ^= mask;
+	}
+	//the number of bits which are set
+	inline uint32_t Count() const
+	{
+		uint32_t count = 0;
+		for (size_t word = 0; word < kNumWords; ++word)
+		{
+			count += PopCount64(words_[word]);
+		}
+		return count;
+	}
+	//bits [first, first + width) as an unsigned number with bit first as its least significant bit, width <= 64
+	inline uint64_t Field(size_t first, size_t width) const
+	{
+		size_t word = first / 64;
+		size_t shift = first % 64;
+		uint64_t value = words_[word] >> shift;
+		if (shift + width > 64)
+		{
+			value |= words_[word + 1] << (64 - shift);
+		}
+		return value & LowBitsMask(width);
+	}
+	/*
+	  A sign and magnitude field: the first width - 1 bits are the magnitude
+	  (least significant first) and the last bit is the sign, set for
+	  negative. width <= 32.
+	*/
+	inline int32_t SignedField(size_t first, size_t width) const
+	{
+		uint64_t field = Field(first, width);
+		int32_t magnitude = (int32_t)(field & LowBitsMask(width - 1));
+		return (field >> (width - 1)) ? -magnitude : magnitude;
+	}
+	/*
+	  Where a field is, worked out once so decoding the same field of every
+	  member of a population is just the shifts and masks:
+
+		FieldLocation location = Chromosome::Locate(first, width);
+		for (...)
+		{
+			value = member.SignedField(location);
+		}
+	*/
+	typedef struct field_location_s
+	{
+		size_t word;
+		//the word the field continues into, or word itself if it doesn't
+		size_t next_word;
+		size_t shift;
+		uint64_t magnitude_mask;
+		size_t sign_shift;
+	} FieldLocation;
+	//the location of the sign and magnitude field [first, first + width), width in [2, 32]
+	static FieldLocation Locate(size_t first, size_t width)
+	{
+		FieldLocation location;
+		location.word = first / 64;
+		location.shift = first % 64;
+		location.next_word = location.shift + width > 64 ? location.word + 1 : location.word;
+		location.magnitude_mask = LowBitsMask(width - 1);
+		location.sign_shift = width - 1;
+		return location;
+	}
+	//branch free so the compiler can keep a loop over many members tight
+	inline int32_t SignedField(const FieldLocation& location) const
+	{
+		//the bits from next_word land above the field when it doesn't straddle, so the masks remove them.
+		//the shift is split in two so a shift of 0 doesn't become an undefined shift by 64
+		uint64_t field = (words_[location.word] >> location.shift) | ((words_[location.next_word] << 1) << (63 - location.shift));
+		int32_t magnitude = (int32_t)(field & location.magnitude_mask);
+		int32_t negative = (int32_t)((field >> location.sign_shift) & 1);
+		return (magnitude ^ -negative) + negative;
+	}
+	/*
+	  Decodes the field at location of count chromosomes, which are stride
+	  chromosomes apart starting at first (as in a FlatPopulation), into
+	  values[0, count) multiplied by scale. With AVX2 four chromosomes are
+	  decoded at once.
+	*/
+	static void DecodeSignedField(const BitChromosome* first, size_t stride, size_t count, const FieldLocation& location, double scale, double* values)
+	{
+		size_t index = 0;
+#ifdef CS776_HAVE_AVX2
+		const __m128i shift = _mm_cvtsi64_si128((long long)location.shift);
+		const __m128i next_shift = _mm_cvtsi64_si128((long long)(63 - location.shift));
+		const __m128i sign_shift = _mm_cvtsi64_si128((long long)location.sign_shift);
+		const __m256i magnitude_mask = _mm256_set1_epi64x((long long)location.magnitude_mask);
+		const __m256i one = _mm256_set1_epi64x(1);
+		//or'ing a magnitude below 2^52 into the mantissa of 2^52 makes the double 2^52 + magnitude
+		const __m256i exponent = _mm256_set1_epi64x(0x4330000000000000ll);
+		const __m256d two_to_52 = _mm256_set1_pd(4503599627370496.0);
+		const __m256d scales = _mm256_set1_pd(scale);
+		for (; index + 4 <= count; index += 4)
+		{
+			const BitChromosome* members = first + index * stride;
+			__m256i low = LoadWords(members, stride, location.word);
+			__m256i high = LoadWords(members, stride, location.next_word);
+			__m256i field = _mm256_or_si256(_mm256_srl_epi64(low, shift), _mm256_sll_epi64(_mm256_slli_epi64(high, 1), next_shift));
+			__m256i magnitude = _mm256_and_si256(field, magnitude_mask);
+			__m256i sign = _mm256_slli_epi64(_mm256_and_si256(_mm256_srl_epi64(field, sign_shift), one), 63);
+			__m256d value = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(magnitude, exponent)), two_to_52);
+			value = _mm256_or_pd(value, _mm256_castsi256_pd(sign));
+			_mm256_storeu_pd(values + index, _mm256_mul_pd(value, scales));
+		}
+#endif
+		for (; index < count; ++index)
+		{
+			values[index] = first[index * stride].SignedField(location) * scale;
+		}
+	}
+	inline uint64_t Word(size_t word) const
+	{
+		return words_[word];
+	}
+	/*
+	  A 64 bit hash of the bits, the XOR of every word's WordHash. Changing a
+	  word only changes its own term, so a hash can be kept up to date
+	  through a FlipMask without rehashing the other words:
+
+		hash ^= WordHash(word, old_value) ^ WordHash(word, new_value);
+	*/
+	uint64_t Hash() const
+	{
+		uint64_t hash = 0;
+		for (size_t word = 0; word < kNumWords; ++word)
+		{
+			hash ^= WordHash(word, words_[word]);
+		}
+		return hash;
+	}
+	//the splitmix64 finalizer of value offset by its position, so equal words in different positions don't cancel
+	static inline uint64_t WordHash(size_t word, uint64_t value)
+	{
+		uint64_t z = value + (word + 1) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	bool operator==(const BitChromosome& other) const
+	{
+		return std::equal(words_, words_ + kNumWords, other.words_);
+	}
+
+	//exchanges the bits of word which are set in mask between a and b
+	static inline void SwapMasked(BitChromosome& a, BitChromosome& b, size_t word, uint64_t mask)
+	{
+		uint64_t difference = (a.words_[word] ^ b.words_[word]) & mask;
+		a.words_[word] ^= difference;
+		b.words_[word] ^= difference;
+	}
+	//exchanges bits [first, last) between a and b, whole words are swapped and the partial words at the ends are masked
+	static void SwapRange(BitChromosome& a, BitChromosome& b, size_t first, size_t last)
+	{
+		if (first >= last)
+		{
+			return;
+		}
+		size_t first_word = first / 64;
+		size_t last_word = (last - 1) / 64;
+		uint64_t first_mask = ~LowBitsMask(first % 64);
+		uint64_t last_mask = LowBitsMask(last - last_word * 64);
+		if (first_word == last_word)
+		{
+			SwapMasked(a, b, first_word, first_mask & last_mask);
+			return;
+		}
+		SwapMasked(a, b, first_word, first_mask);
+		for (size_t word = first_word + 1; word < last_word; ++word)
+		{
+			std::swap(a.words_[word], b.words_[word]);
+		}
+		SwapMasked(a, b, last_word, last_mask);
+	}
+	//one point crossover: the bits before point are exchanged
+	static void OnePointCrossover(BitChromosome& a, BitChromosome& b, size_t point)
+	{
+		SwapRange(a, b, 0, point);
+	}
+	//two point crossover: the bits in [first, last) are exchanged
+	static void TwoPointCrossover(BitChromosome& a, BitChromosome& b, size_t first, size_t last)
+	{
+		SwapRange(a, b, first, last);
+	}
+	//uniform crossover: every bit is exchanged with probability 1/2, one random word decides 64 bits
+	static void UniformCrossover(BitChromosome& a, BitChromosome& b)
+	{
+		for (size_t word = 0; word < kNumWords; ++word)
+		{
+			SwapMasked(a, b, word, rng::ThreadEngine()() & (word == kNumWords - 1 ? kLastWordMask : ~0ull));
+		}
+	}
+private:
+#ifdef CS776_HAVE_AVX2
+	//word of 4 chromosomes stride apart, inserted lane by lane since gathers (and _mm256_set, which compilers tend to build on the stack) are slower
+	static inline __m256i LoadWords(const BitChromosome* members, size_t stride, size_t word)
+	{
+		__m128i low = _mm_insert_epi64(_mm_cvtsi64_si128((long long)members[0].words_[word]), (long long)members[stride].words_[word], 1);
+		__m128i high = _mm_insert_epi64(_mm_cvtsi64_si128((long long)members[2 * stride].words_[word]), (long long)members[3 * stride].words_[word], 1);
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	}
+#endif
+	uint64_t words_[kNumWords];
+};
+#endif //CS776_BIT_CHROMOSOME_H_
@@ -0,0 +1,295 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_CHECKPOINT_H_
+#define CS776_CHECKPOINT_H_
+#include "ionlib\log.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+/*
+ByteWriter appends trivially copyable values, vectors of them and strings to
+a buffer in native byte order. ByteReader reads them back in the same order,
+and fails instead of reading past the end so a truncated or mismatched
+snapshot is detected rather than loaded.
+*/
+class ByteWriter
+{
+public:
+	template<typename T>
+	void Write(const T& value)
+	{
+		buffer_.append((const char*)&value, sizeof(T));
+	}
+	template<typename T>
+	void WriteVector(const std::vector<T>& values)
+	{
+		Write((uint64_t)values.size());
+		WriteArray(values.data(), values.size());
+	}
+	template<typename T>
+	void WriteArray(const T* values, size_t count)
+	{
+		buffer_.append((const char*)values, count * sizeof(T));
+	}
+	void WriteString(const std::string& value)
+	{
+		Write((uint64_t)value.size());
+		buffer_.append(value);
+	}
+	std::string& Buffer()
+	{
+		return buffer_;
+	}
+	//empties the buffer but keeps its memory for the next snapshot
+	void Clear()
+	{
+		buffer_.clear();
+	}
+private:
+	std::string buffer_;
+};
+
+class ByteReader
+{
+public:
+	ByteReader(const std::string& buffer) : buffer_(buffer), offset_(0)
+	{
+	}
+	template<typename T>
+	bool Read(T* value)
+	{
+		return ReadArray(value, 1);
+	}
+	template<typename T>
+	bool ReadVector(std::vector<T>* values)
+	{
+		uint64_t size;
+		if (!Read(&size) || size > Remaining() / sizeof(T))
+		{
+			return false;
+		}
+		values->resize((size_t)size);
+		return ReadArray(values->data(), values->size());
+	}
+	template<typename T>
+	bool ReadArray(T* values, size_t count)
+	{
+		if (count > Remaining() / sizeof(T))
+		{
+			return false;
+		}
+		memcpy(values, buffer_.data() + offset_, count * sizeof(T));
+		offset_ += count * sizeof(T);
+		return true;
+	}
+	bool ReadString(std::string* value)
+	{
+		uint64_t size;
+		if (!Read(&size) || size > Remaining())
+		{
+			return false;
+		}
+		value->assign(buffer_.data() + offset_, (size_t)size);
+		offset_ += (size_t)size;
+		return true;
+	}
+	size_t Remaining() const
+	{
+		return buffer_.size() - offset_;
+	}
+private:
+	const std::string& buffer_;
+	size_t offset_;
+};
+
+/*
+CheckpointWriter keeps the latest serialized state of a fixed number of
+slots (e.g. one per trial plus one for the merged results) and writes all of
+them to a snapshot file on a background thread, at most once per interval.
+
+Update only swaps the caller's buffer in under a lock, so the threads doing
+the work never wait on the disk. Each snapshot is written to a temporary
+file which then replaces the previous snapshot, so a crash while writing
+leaves the last complete snapshot in place.
+
+Every slot is replaced whole, so a snapshot holds some version of each
+slot but the versions are only consistent with each other if the caller
+updates dependent slots in a safe order (see ExecuteGa in the TSP app).
+
+The file is the magic "CS776CK1", the uint64 number of slots, then each
+slot's uint64 length and bytes.
+*/
+class CheckpointWriter
+{
+public:
+	CheckpointWriter(const std::string& filename, size_t num_slots, double interval_seconds)
+	{
+		filename_ = filename;
+		slots_.resize(num_slots);
+		interval_ = std::chrono::duration<double>(interval_seconds);
+		dirty_ = false;
+		stop_ = false;
+		writer_ = std::thread(&CheckpointWriter::WriterThread, this);
+	}
+	//writes a final snapshot of whatever has changed since the last one
+	~CheckpointWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_one();
+		writer_.join();
+	}
+	//replaces the slot's state with state, which is left holding the slot's previous state so its memory is reused
+	void Update(size_t slot, std::string& state)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			slots_[slot].swap(state);
+			dirty_ = true;
+		}
+		wake_.notify_one();
+	}
+	//reads a snapshot written by a CheckpointWriter, returns false if there isn't a complete one at filename
+	static bool Load(const std::string& filename, std::vector<std::string>* slots)
+	{
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (file == NULL)
+		{
+			return false;
+		}
+		std::string contents;
+		char chunk[65536];
+		size_t num_read;
+		while ((num_read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		{
+			contents.append(chunk, num_read);
+		}
+		fclose(file);
+		ByteReader reader(contents);
+		char magic[8];
+		uint64_t num_slots;
+		if (!reader.ReadArray(magic, 8) || memcmp(magic, "CS776CK1", 8) != 0 || !reader.Read(&num_slots) || num_slots > reader.Remaining())
+		{
+			LOGERROR("%s isn't a checkpoint", filename.c_str());
+			return false;
+		}
+		slots->resize((size_t)num_slots);
+		for (size_t slot = 0; slot < slots->size(); ++slot)
+		{
+			if (!reader.ReadString(&(*slots)[slot]))
+			{
+				LOGERROR("%s is truncated", filename.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+private:
+	void WriterThread()
+	{
+		std::vector<std::string> snapshot(slots_.size());
+		std::chrono::steady_clock::time_point last_write = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;)
+		{
+			wake_.wait(lock, [&]()
+			{
+				return stop_ || dirty_;
+			});
+			if (!stop_)
+			{
+				//let updates collect until the interval has passed since the last snapshot
+				wake_.wait_until(lock, last_write + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval_), [&]()
+				{
+					return stop_;
+				});
+			}
+			if (dirty_)
+			{
+				for (size_t slot = 0; slot < slots_.size(); ++slot)
+				{
+					snapshot[slot] = slots_[slot];
+				}
+				dirty_ = false;
+				lock.unlock();
+				WriteSnapshot(snapshot);
+				last_write = std::chrono::steady_clock::now();
+				lock.lock();
+			}
+			if (stop_ && !dirty_)
+			{
+				return;
+			}
+		}
+	}
+	void WriteSnapshot(const std::vector<std::string>& snapshot)
+	{
+		std::string temporary = filename_ + ".tmp";
+		FILE* file = fopen(temporary.c_str(), "wb");
+		if (file == NULL)
+		{
+			LOGERROR("Couldn't write checkpoint %s", temporary.c_str());
+			return;
+		}
+		uint64_t num_slots = snapshot.size();
+		bool ok = fwrite("CS776CK1", 1, 8, file) == 8 && fwrite(&num_slots, sizeof(num_slots), 1, file) == 1;
+		for (size_t slot = 0; ok && slot < snapshot.size(); ++slot)
+		{
+			uint64_t length = snapshot[slot].size();
+			ok = fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(snapshot[slot].data(), 1, snapshot[slot].size(), file) == snapshot[slot].size();
+		}
+		ok = (fclose(file) == 0) && ok;
+		if (!ok)
+		{
+			LOGERROR("Couldn't write checkpoint %s", temporary.c_str());
+			return;
+		}
+#ifdef _WIN32
+		ok = MoveFileExA(temporary.c_str(), filename_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		ok = rename(temporary.c_str(), filename_.c_str()) == 0;
+#endif
+		if (!ok)
+		{
+			LOGERROR("Couldn't replace checkpoint %s", filename_.c_str());
+		}
+	}
+	std::string filename_;
+	std::chrono::duration<double> interval_;
+	std::vector<std::string> slots_;
+	bool dirty_;
+	bool stop_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::thread writer_;
+};
+#endif //CS776_CHECKPOINT_H_
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_COMMAND_LINE_H_
+#define CS776_COMMAND_LINE_H_
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdlib>
+#include <cstdint>
+
+/*
+CommandLine splits argv into positional arguments and "--name value" (or
+"--name=value") options so the apps can keep their existing positional usage
+and accept optional settings after it, for example:
+	traveling-salesperson.exe eil51.tsp eil51.opt.tour 100 0.01 0.67 --selection tournament
+
+The names in flags are options which never take a value (e.g. --resume), so
+an argument after one is positional. Every other option takes the argument
+after it as its value, unless it is written as --name=value; one followed
+by another option (or nothing) has an empty value.
+*/
+class CommandLine
+{
+public:
+	CommandLine(int argc, char* argv[], const std::set<std::string>& flags = std::set<std::string>())
+	{
+		for (int arg_index = 1; arg_index < argc; ++arg_index)
+		{
+			std::string arg = argv[arg_index];
+			if (arg.compare(0, 2, "--") == 0)
+			{
+				std::string name = arg.substr(2);
+				std::string value;
+				size_t equals = name.find('=');
+				if (equals != std::string::npos)
+				{
+					value = name.substr(equals + 1);
+					name.erase(equals);
+				} else if (flags.count(name) == 0 && arg_index + 1 < argc && std::string(argv[arg_index + 1]).compare(0, 2, "--") != 0)
+				{
+					value = argv[++arg_index];
+				}
+				options_[name] = value;
+			} else
+			{
+				positional_.push_back(arg);
+			}
+		}
+	}
+	size_t NumPositional() const
+	{
+		return positional_.size();
+	}
+	const std::string& GetPositional(size_t index) const
+	{
+		return positional_[index];
+	}
+	bool Has(const std::string& name) const
+	{
+		return options_.find(name) != options_.end();
+	}
+	std::string GetString(const std::string& name, const std::string& default_value) const
+	{
+		std::map<std::string, std::string>::const_iterator option_it = options_.find(name);
+		return option_it == options_.end() ? default_value : option_it->second;
+	}
+	double GetDouble(const std::string& name, double default_value) const
+	{
+		std::map<std::string, std::string>::const_iterator option_it = options_.find(name);
+		return option_it == options_.end() ? default_value : atof(option_it->second.c_str());
+	}
+	int64_t GetInt(const std::string& name, int64_t default_value) const
+	{
+		std::map<std::string, std::string>::const_iterator option_it = options_.find(name);
+		return option_it == options_.end() ? default_value : (int64_t)strtoll(option_it->second.c_str(), nullptr, 10);
+	}
+private:
+	std::vector<std::string> positional_;
+	std::map<std::string, std::string> options_;
+};
+#endif //CS776_COMMAND_LINE_H_
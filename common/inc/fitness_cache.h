@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_FITNESS_CACHE_H_
+#define CS776_FITNESS_CACHE_H_
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+FitnessCache memoizes a value (e.g. an objective function's result) per
+64 bit chromosome hash, so members which are copies of one another are
+only evaluated once. Once a population has converged most members are
+copies, which is when it pays off.
+
+It is a fixed size open addressing table: a hash lives within kMaxProbes
+slots of its home slot, and when those are all taken the home slot is
+overwritten, so the cache never grows or rehashes and old entries are
+dropped as the population moves on. Only the hash is stored, not the
+chromosome, so two chromosomes with the same 64 bit hash would share a
+value; with a well mixed hash that's vanishingly unlikely.
+
+Find counts hits and misses for reporting. A cache isn't shared between
+threads, every GA owns its own.
+*/
+class FitnessCache
+{
+public:
+	static const size_t kMaxProbes = 8;
+	FitnessCache() : mask_(0), hits_(0), misses_(0)
+	{
+	}
+	//capacity is rounded up to a power of two, 0 disables the cache. Empties the cache
+	void Resize(size_t capacity)
+	{
+		size_t num_slots = 0;
+		if (capacity > 0)
+		{
+			num_slots = kMaxProbes;
+			while (num_slots < capacity)
+			{
+				num_slots *= 2;
+			}
+		}
+		slots_.assign(num_slots, slot_t());
+		mask_ = num_slots > 0 ? num_slots - 1 : 0;
+		hits_ = 0;
+		misses_ = 0;
+	}
+	bool Enabled() const
+	{
+		return !slots_.empty();
+	}
+	//sets value and returns true if hash is in the cache
+	inline bool Find(uint64_t hash, double* value)
+	{
+		uint64_t key = Key(hash);
+		for (size_t probe = 0; probe < kMaxProbes; ++probe)
+		{
+			const slot_t& slot = slots_[(size_t)(key + probe) & mask_];
+			if (slot.key == key)
+			{
+				*value = slot.value;
+				hits_++;
+				return true;
+			}
+			if (slot.key == kEmpty)
+			{
+				break;
+			}
+		}
+		misses_++;
+		return false;
+	}
+	inline void Insert(uint64_t hash, double value)
+	{
+		uint64_t key = Key(hash);
+		size_t home = (size_t)key & mask_;
+		for (size_t probe = 0; probe < kMaxProbes; ++probe)
+		{
+			slot_t& slot = slots_[(home + probe) & mask_];
+			if (slot.key == key || slot.key == kEmpty)
+			{
+				slot.key = key;
+				slot.value = value;
+				return;
+			}
+		}
+		slots_[home].key = key;
+		slots_[home].value = value;
+	}
+	uint64_t Hits() const
+	{
+		return hits_;
+	}
+	uint64_t Misses() const
+	{
+		return misses_;
+	}
+private:
+	static const uint64_t kEmpty = 0;
+	//0 marks an empty slot, so a hash of 0 is stored as 1
+	static inline uint64_t Key(uint64_t hash)
+	{
+		return hash == kEmpty ? 1 : hash;
+	}
+	typedef struct slot_s
+	{
+		slot_s() : key(kEmpty), value(0.0)
+		{
+		}
+		uint64_t key;
+		double value;
+	} slot_t;
+	std::vector<slot_t> slots_;
+	size_t mask_;
+	uint64_t hits_;
+	uint64_t misses_;
+};
+#endif //CS776_FITNESS_CACHE_H_
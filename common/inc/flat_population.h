@@ -0,0 +1,153 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_FLAT_POPULATION_H_
+#define CS776_FLAT_POPULATION_H_
+#include "ionlib\log.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/*
+MemberView is a non-owning view of one member's genes, like a span. It is
+what FlatPopulation hands out instead of a reference to a container.
+*/
+template<typename Gene>
+class MemberView
+{
+public:
+	MemberView(Gene* data, size_t size) : data_(data), size_(size)
+	{
+	}
+	inline Gene* begin() const
+	{
+		return data_;
+	}
+	inline Gene* end() const
+	{
+		return data_ + size_;
+	}
+	inline Gene* data() const
+	{
+		return data_;
+	}
+	inline size_t size() const
+	{
+		return size_;
+	}
+	inline Gene& operator[](size_t index) const
+	{
+		return data_[index];
+	}
+private:
+	Gene* data_;
+	size_t size_;
+};
+
+/*
+FlatPopulation stores every member of a population in one contiguous buffer
+instead of one heap allocation per member.
+
+Each member starts on its own cache line (the member length is rounded up
+to a whole number of cache lines), so members never share a line and
+several threads could work on different members without false sharing.
+
+The buffer holds two generations: the current one, which Member returns,
+and the next one, which Offspring returns and which selection builds by
+copying members across with CopyToOffspring. SwapGenerations then makes
+the offspring the current generation in O(1). Only Resize allocates.
+
+Genes must be trivially copyable. Since the views point into the buffer a
+FlatPopulation can't be copied.
+*/
+template<typename Gene>
+class FlatPopulation
+{
+public:
+	static const size_t kCacheLineSize = 64;
+	FlatPopulation()
+	{
+		num_members_ = 0;
+		member_length_ = 0;
+		stride_ = 0;
+		current_ = NULL;
+		next_ = NULL;
+	}
+	FlatPopulation(size_t num_members, size_t member_length)
+	{
+		Resize(num_members, member_length);
+	}
+	FlatPopulation(const FlatPopulation&) = delete;
+	FlatPopulation& operator=(const FlatPopulation&) = delete;
+	void Resize(size_t num_members, size_t member_length)
+	{
+		const size_t kGenesPerLine = std::max<size_t>(1, kCacheLineSize / sizeof(Gene));
+		num_members_ = num_members;
+		member_length_ = member_length;
+		stride_ = ((member_length + kGenesPerLine - 1) / kGenesPerLine) * kGenesPerLine;
+		size_t generation_size = num_members * stride_;
+		//one extra line so the start can be moved up to a line boundary
+		storage_.assign(2 * generation_size + kGenesPerLine, Gene());
+		uintptr_t address = (uintptr_t)storage_.data();
+		uintptr_t aligned_address = (address + kCacheLineSize - 1) & ~(uintptr_t)(kCacheLineSize - 1);
+		current_ = storage_.data() + (aligned_address - address) / sizeof(Gene);
+		next_ = current_ + generation_size;
+	}
+	inline MemberView<Gene> Member(size_t member_index)
+	{
+		return MemberView<Gene>(current_ + member_index * stride_, member_length_);
+	}
+	inline MemberView<const Gene> Member(size_t member_index) const
+	{
+		return MemberView<const Gene>(current_ + member_index * stride_, member_length_);
+	}
+	inline MemberView<Gene> Offspring(size_t member_index)
+	{
+		return MemberView<Gene>(next_ + member_index * stride_, member_length_);
+	}
+	//copies member from of the current generation into slot to of the next generation
+	inline void CopyToOffspring(size_t from, size_t to)
+	{
+		std::copy(current_ + from * stride_, current_ + from * stride_ + member_length_, next_ + to * stride_);
+	}
+	inline void SwapGenerations()
+	{
+		std::swap(current_, next_);
+	}
+	inline size_t NumMembers() const
+	{
+		return num_members_;
+	}
+	inline size_t MemberLength() const
+	{
+		return member_length_;
+	}
+	//distance between the starts of consecutive members, in genes
+	inline size_t Stride() const
+	{
+		return stride_;
+	}
+private:
+	size_t num_members_;
+	size_t member_length_;
+	//distance between the starts of consecutive members, in genes
+	size_t stride_;
+	std::vector<Gene> storage_;
+	Gene* current_;
+	Gene* next_;
+};
+#endif //CS776_FLAT_POPULATION_H_
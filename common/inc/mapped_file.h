@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_MAPPED_FILE_H_
+#define CS776_MAPPED_FILE_H_
+#include <string>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+MappedFile maps a whole file read only into memory, so a parser can walk it
+as one array of characters without copying it through stream buffers. An
+empty file opens successfully with Size() 0.
+*/
+class MappedFile
+{
+public:
+	MappedFile()
+	{
+		data_ = NULL;
+		size_ = 0;
+#ifdef _WIN32
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = NULL;
+#endif
+	}
+	//not copyable, the mapping is released exactly once
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile()
+	{
+		Close();
+	}
+	bool Open(const std::string& filename)
+	{
+		Close();
+#ifdef _WIN32
+		file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file_ == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size))
+		{
+			Close();
+			return false;
+		}
+		size_ = (size_t)size.QuadPart;
+		if (size_ == 0)
+		{
+			return true;
+		}
+		mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_ == NULL)
+		{
+			Close();
+			return false;
+		}
+		data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		if (data_ == NULL)
+		{
+			Close();
+			return false;
+		}
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			close(fd);
+			return false;
+		}
+		size_ = (size_t)info.st_size;
+		if (size_ > 0)
+		{
+			void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				close(fd);
+				size_ = 0;
+				return false;
+			}
+			//the parsers read front to back
+			madvise(data, size_, MADV_SEQUENTIAL);
+			data_ = (const char*)data;
+		}
+		//the mapping stays valid after the descriptor is closed
+		close(fd);
+#endif
+		return true;
+	}
+	void Close()
+	{
+#ifdef _WIN32
+		if (data_ != NULL)
+		{
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_ != NULL)
+		{
+			CloseHandle(mapping_);
+			mapping_ = NULL;
+		}
+		if (file_ != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file_);
+			file_ = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (data_ != NULL)
+		{
+			munmap((void*)data_, size_);
+		}
+#endif
+		data_ = NULL;
+		size_ = 0;
+	}
+	const char* Data() const
+	{
+		return data_;
+	}
+	size_t Size() const
+	{
+		return size_;
+	}
+private:
+	const char* data_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
+#endif //CS776_MAPPED_FILE_H_
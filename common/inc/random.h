@@ -0,0 +1,316 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_RANDOM_H_
+#define CS776_RANDOM_H_
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+/*
+The rng functions are drop in replacements for ion::randlf, ion::randull and
+ion::random_normal_distribution, except that every thread draws from its own
+generator. This means trials running on different threads don't share (or
+race on) the C library's rand() state, and seeding a thread with Seed gives
+the same sequence no matter which thread runs the trial. Unlike rand() the
+full 64 bit range is available, so there is no RAND_MAX limit on what can
+be drawn.
+*/
+namespace rng
+{
+	/*
+	  Xoshiro256 is the xoshiro256** generator by Blackman and Vigna: 256 bits
+	  of state, a period of 2^256 - 1, and only a few shifts, rotates and adds
+	  per number, which makes it several times faster than std::mt19937_64.
+	  It meets the standard's UniformRandomBitGenerator requirements so it can
+	  be used with the <random> distributions too.
+	*/
+	class Xoshiro256
+	{
+	public:
+		typedef uint64_t result_type;
+		explicit Xoshiro256(uint64_t seed_value = 5489u)
+		{
+			seed(seed_value);
+		}
+		//the state is filled from seed_value with splitmix64, which can't produce the all zero state
+		void seed(uint64_t seed_value)
+		{
+			for (uint32_t word = 0; word < 4; ++word)
+			{
+				seed_value += 0x9E3779B97F4A7C15ull;
+				uint64_t z = seed_value;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+				state_[word] = z ^ (z >> 31);
+			}
+		}
+		inline uint64_t operator()()
+		{
+			uint64_t result = Rotate(state_[1] * 5, 7) * 9;
+			uint64_t shifted = state_[1] << 17;
+			state_[2] ^= state_[0];
+			state_[3] ^= state_[1];
+			state_[1] ^= state_[2];
+			state_[0] ^= state_[3];
+			state_[2] ^= shifted;
+			state_[3] = Rotate(state_[3], 45);
+			return result;
+		}
+		//the raw state, so a checkpoint can save a stream and continue it exactly
+		void GetState(uint64_t state[4]) const
+		{
+			std::copy(state_, state_ + 4, state);
+		}
+		void SetState(const uint64_t state[4])
+		{
+			std::copy(state, state + 4, state_);
+		}
+		static constexpr uint64_t min()
+		{
+			return 0;
+		}
+		static constexpr uint64_t max()
+		{
+			return std::numeric_limits<uint64_t>::max();
+		}
+	private:
+		static inline uint64_t Rotate(uint64_t value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+		uint64_t state_[4];
+	};
+	inline Xoshiro256& ThreadEngine()
+	{
+		static thread_local Xoshiro256 engine;
+		return engine;
+	}
+	//Restarts the calling thread's generator from seed
+	inline void Seed(uint64_t seed)
+	{
+		ThreadEngine().seed(seed);
+	}
+	/*
+	  Derives the seed for stream (for example a trial number) from a base
+	  seed. The splitmix64 finalizer makes nearby stream numbers produce
+	  unrelated seeds.
+	*/
+	inline uint64_t StreamSeed(uint64_t base_seed, uint64_t stream)
+	{
+		uint64_t z = base_seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	//Converts 64 random bits to a double in [0, 1) using the top 53 bits, so every value is equally likely
+	inline double ToUnit(uint64_t bits)
+	{
+		return (bits >> 11) * (1.0 / 9007199254740992.0);
+	}
+	//Returns a uniformly distributed number in [min, max)
+	inline double randlf(double min, double max)
+	{
+		return min + ToUnit(ThreadEngine()()) * (max - min);
+	}
+	//Returns a uniformly distributed integer in [min, max]
+	inline uint64_t randull(uint64_t min, uint64_t max)
+	{
+		uint64_t range = max - min + 1;
+		if (range == 0)
+		{
+			//[0, UINT64_MAX]
+			return ThreadEngine()();
+		}
+		return min + ThreadEngine()() % range;
+	}
+	/*
+	  Fills values[0, count) with uniformly distributed numbers in [min, max).
+	  The generator is copied into a local for the duration of the loop, so
+	  its state stays in registers instead of being loaded and stored through
+	  the thread_local for every number.
+	*/
+	inline void FillUniform(double* values, size_t count, double min, double max)
+	{
+		Xoshiro256 engine = ThreadEngine();
+		double scale = max - min;
+		for (size_t index = 0; index < count; ++index)
+		{
+			values[index] = min + ToUnit(engine()) * scale;
+		}
+		ThreadEngine() = engine;
+	}
+	//Returns a normally distributed number using the Box-Muller transform
+	inline double random_normal_distribution(double mean, double standard_deviation)
+	{
+		double u1 = 1.0 - randlf(0.0, 1.0);
+		double u2 = randlf(0.0, 1.0);
+		return mean + standard_deviation * std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+	}
+
+	/*
+	  The tables of Marsaglia and Tsang's 128 layer ziggurat for the standard
+	  normal distribution. The layers all have the same area; a draw picks a
+	  layer and a point in it, and only when the point lands outside the part
+	  of the layer which is certainly under the curve (about 1.2% of draws)
+	  is an exponential evaluated.
+	*/
+	class NormalZiggurat
+	{
+	public:
+		//where the tail starts
+		static constexpr double kTailStart = 3.442619855899;
+		static const NormalZiggurat& Tables()
+		{
+			static const NormalZiggurat tables;
+			return tables;
+		}
+		//a draw at layer with |value| < boundary[layer] is under the curve
+		uint32_t boundary[128];
+		//value * width[layer] is the x coordinate of the draw
+		double width[128];
+		//the density at each layer's upper edge
+		double density[128];
+	private:
+		NormalZiggurat()
+		{
+			const double kScale = 2147483648.0;
+			const double kLayerArea = 9.91256303526217e-3;
+			double edge = kTailStart;
+			double previous_edge = edge;
+			double q = kLayerArea / std::exp(-0.5 * edge * edge);
+			boundary[0] = (uint32_t)((edge / q) * kScale);
+			boundary[1] = 0;
+			width[0] = q / kScale;
+			width[127] = edge / kScale;
+			density[0] = 1.0;
+			density[127] = std::exp(-0.5 * edge * edge);
+			for (int layer = 126; layer >= 1; --layer)
+			{
+				edge = std::sqrt(-2.0 * std::log(kLayerArea / edge + std::exp(-0.5 * edge * edge)));
+				boundary[layer + 1] = (uint32_t)((edge / previous_edge) * kScale);
+				previous_edge = edge;
+				density[layer] = std::exp(-0.5 * edge * edge);
+				width[layer] = edge / kScale;
+			}
+		}
+	};
+	//Returns a standard normal number drawn from engine with the ziggurat method
+	inline double NextNormal(Xoshiro256& engine, const NormalZiggurat& tables)
+	{
+		for (;;)
+		{
+			//the low bits pick the layer and the high 32 are the signed position in it, so the two are independent
+			uint64_t bits = engine();
+			uint32_t layer = (uint32_t)(bits & 127);
+			int32_t position = (int32_t)(bits >> 32);
+			double x = position * tables.width[layer];
+			uint32_t magnitude = position < 0 ? (uint32_t)(-(int64_t)position) : (uint32_t)position;
+			if (magnitude < tables.boundary[layer])
+			{
+				return x;
+			}
+			if (layer == 0)
+			{
+				//the base layer's overhang is the tail beyond kTailStart, drawn by Marsaglia's method
+				double tail_x;
+				double tail_y;
+				do
+				{
+					tail_x = -std::log(1.0 - ToUnit(engine())) / NormalZiggurat::kTailStart;
+					tail_y = -std::log(1.0 - ToUnit(engine()));
+				} while (tail_y + tail_y < tail_x * tail_x);
+				return position > 0 ? NormalZiggurat::kTailStart + tail_x : -NormalZiggurat::kTailStart - tail_x;
+			}
+			if (tables.density[layer] + ToUnit(engine()) * (tables.density[layer - 1] - tables.density[layer]) < std::exp(-0.5 * x * x))
+			{
+				return x;
+			}
+		}
+	}
+	/*
+	  Fills values[0, count) with normally distributed numbers. This is the
+	  bulk replacement for random_normal_distribution: the ziggurat needs one
+	  64 bit draw and a table lookup for almost every number, instead of two
+	  draws, a log, a sqrt and a cos, and like FillUniform the generator stays
+	  in registers for the whole buffer.
+	*/
+	inline void FillNormal(double* values, size_t count, double mean, double standard_deviation)
+	{
+		const NormalZiggurat& tables = NormalZiggurat::Tables();
+		Xoshiro256 engine = ThreadEngine();
+		for (size_t index = 0; index < count; ++index)
+		{
+			values[index] = mean + standard_deviation * NextNormal(engine, tables);
+		}
+		ThreadEngine() = engine;
+	}
+
+	/*
+	  SkipSampler replaces "for every item, succeed with probability p" loops.
+	  Instead of drawing a number per item, Next draws how many items fail
+	  before the next success, which is geometrically distributed, so a pass
+	  over n items costs O(n * p) draws instead of O(n):
+
+		SkipSampler skip(p);
+		for (uint64_t index = skip.Next(); index < n; index = skip.Advance(index, n))
+		{
+			//item index succeeded
+		}
+	*/
+	class SkipSampler
+	{
+	public:
+		static const uint64_t kNever = UINT64_MAX;
+		explicit SkipSampler(double probability)
+		{
+			probability_ = probability;
+			log_failure_ = (probability > 0.0 && probability < 1.0) ? std::log(1.0 - probability) : 0.0;
+		}
+		//Returns how many items fail before the next success, or kNever if p is 0
+		inline uint64_t Next()
+		{
+			if (probability_ >= 1.0)
+			{
+				return 0;
+			}
+			if (probability_ <= 0.0)
+			{
+				return kNever;
+			}
+			//u is in (0, 1] so the log is finite
+			double u = 1.0 - randlf(0.0, 1.0);
+			double skip = std::floor(std::log(u) / log_failure_);
+			return skip >= 1.8e19 ? kNever : (uint64_t)skip;
+		}
+		//Returns the index of the success after index, or end if it is at or past end
+		inline uint64_t Advance(uint64_t index, uint64_t end)
+		{
+			uint64_t skip = Next();
+			if (skip >= end - index - 1)
+			{
+				return end;
+			}
+			return index + 1 + skip;
+		}
+	private:
+		double probability_;
+		double log_failure_;
+	};
+}
+#endif //CS776_RANDOM_H_
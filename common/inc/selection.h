@@ -0,0 +1,273 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_SELECTION_H_
+#define CS776_SELECTION_H_
+#include "ionlib\log.h"
+#include "random.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+
+/*
+ParentSelector picks the parents of the next generation from the fitnesses
+of the current one. It is shared by every ion::GeneticAlgorithm derived
+class in the project so the selection method can be chosen at runtime.
+
+The methods are:
+  * FITNESS_PROPORTIONAL: roulette wheel selection. Instead of walking the
+    fitness CDF for every draw (O(pop) per draw), Prepare builds a Walker
+    alias table in O(pop) and every draw is O(1)
+  * RANK_PROPORTIONAL: roulette wheel over the ranks (the best member has
+    weight pop, the worst has weight 1), also drawn from an alias table
+  * STOCHASTIC_UNIVERSAL: a single spin of a wheel with count equally spaced
+    pointers, which has the same expected counts as FITNESS_PROPORTIONAL but
+    much lower variance. The parents are shuffled afterwards so consecutive
+    parents aren't always neighbors on the wheel
+  * TOURNAMENT: each parent is the fittest of tournament_size members drawn
+    uniformly at random, which needs no preparation at all
+
+All of the buffers are kept between generations so selecting doesn't
+allocate once the population size is stable.
+*/
+class ParentSelector
+{
+public:
+	enum Method
+	{
+		FITNESS_PROPORTIONAL,
+		RANK_PROPORTIONAL,
+		STOCHASTIC_UNIVERSAL,
+		TOURNAMENT
+	};
+	ParentSelector()
+	{
+		method_ = FITNESS_PROPORTIONAL;
+		tournament_size_ = 2;
+		fitness_ = nullptr;
+	}
+	void SetMethod(Method method, uint32_t tournament_size = 2)
+	{
+		LOGASSERT(tournament_size >= 1);
+		method_ = method;
+		tournament_size_ = tournament_size;
+	}
+	Method GetMethod() const
+	{
+		return method_;
+	}
+	//Converts the names used on the command line to a Method, returns false if the name isn't recognized
+	static bool ParseMethod(const std::string& name, Method* method)
+	{
+		if (name == "fitness")
+		{
+			*method = FITNESS_PROPORTIONAL;
+		} else if (name == "rank")
+		{
+			*method = RANK_PROPORTIONAL;
+		} else if (name == "sus")
+		{
+			*method = STOCHASTIC_UNIVERSAL;
+		} else if (name == "tournament")
+		{
+			*method = TOURNAMENT;
+		} else
+		{
+			return false;
+		}
+		return true;
+	}
+	//Must be called once per generation, after the fitnesses are evaluated and before Select
+	void Prepare(const std::vector<double>& fitness)
+	{
+		fitness_ = &fitness;
+		switch (method_)
+		{
+		case FITNESS_PROPORTIONAL:
+			BuildAliasTable(fitness);
+			break;
+		case RANK_PROPORTIONAL:
+		{
+			//the weight of each member is its rank, the least fit member has rank 1
+			ranked_.resize(fitness.size());
+			std::iota(ranked_.begin(), ranked_.end(), 0);
+			std::sort(ranked_.begin(), ranked_.end(), [&fitness](uint32_t lhs, uint32_t rhs) { return fitness[lhs] < fitness[rhs]; });
+			weights_.resize(fitness.size());
+			for (size_t rank = 0; rank < ranked_.size(); ++rank)
+			{
+				weights_[ranked_[rank]] = (double)(rank + 1);
+			}
+			BuildAliasTable(weights_);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	//Fills parents with count indexes into the fitness vector given to Prepare
+	void Select(size_t count, std::vector<uint32_t>& parents)
+	{
+		LOGASSERT(fitness_ != nullptr && !fitness_->empty(), "Prepare must be called before Select");
+		parents.resize(count);
+		switch (method_)
+		{
+		case FITNESS_PROPORTIONAL:
+		case RANK_PROPORTIONAL:
+			for (size_t parent_index = 0; parent_index < count; ++parent_index)
+			{
+				parents[parent_index] = DrawFromAliasTable();
+			}
+			break;
+		case STOCHASTIC_UNIVERSAL:
+			SelectStochasticUniversal(count, parents);
+			break;
+		case TOURNAMENT:
+			for (size_t parent_index = 0; parent_index < count; ++parent_index)
+			{
+				parents[parent_index] = DrawTournament();
+			}
+			break;
+		}
+	}
+private:
+	/*
+	  Walker's alias method: every member gets a bucket of equal probability.
+	  Bucket i returns i with probability probability_[i] and alias_[i]
+	  otherwise. Buckets are filled by pairing a member with less than the
+	  average weight with one with more than the average weight, so building
+	  the table is O(pop).
+	*/
+	void BuildAliasTable(const std::vector<double>& weights)
+	{
+		size_t num_members = weights.size();
+		probability_.resize(num_members);
+		alias_.resize(num_members);
+		small_.clear();
+		large_.clear();
+		//either list can end up holding every member, reserving that up front means the pushes never allocate
+		small_.reserve(num_members);
+		large_.reserve(num_members);
+		double weight_sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+		if (weight_sum <= 0.0)
+		{
+			//every member has zero fitness, so select uniformly
+			std::fill(probability_.begin(), probability_.end(), 1.0);
+			std::iota(alias_.begin(), alias_.end(), 0);
+			return;
+		}
+		for (uint32_t member_index = 0; member_index < num_members; ++member_index)
+		{
+			probability_[member_index] = weights[member_index] * num_members / weight_sum;
+			if (probability_[member_index] < 1.0)
+			{
+				small_.push_back(member_index);
+			} else
+			{
+				large_.push_back(member_index);
+			}
+		}
+		while (!small_.empty() && !large_.empty())
+		{
+			uint32_t small_index = small_.back();
+			small_.pop_back();
+			uint32_t large_index = large_.back();
+			alias_[small_index] = large_index;
+			//the large member gives up enough probability to fill the small member's bucket
+			probability_[large_index] -= 1.0 - probability_[small_index];
+			if (probability_[large_index] < 1.0)
+			{
+				large_.pop_back();
+				small_.push_back(large_index);
+			}
+		}
+		//anything left over is only off from 1.0 because of rounding
+		for (std::vector<uint32_t>::iterator index_it = large_.begin(); index_it != large_.end(); ++index_it)
+		{
+			probability_[*index_it] = 1.0;
+			alias_[*index_it] = *index_it;
+		}
+		for (std::vector<uint32_t>::iterator index_it = small_.begin(); index_it != small_.end(); ++index_it)
+		{
+			probability_[*index_it] = 1.0;
+			alias_[*index_it] = *index_it;
+		}
+	}
+	inline uint32_t DrawFromAliasTable() const
+	{
+		uint32_t bucket = (uint32_t)rng::randull(0, probability_.size() - 1);
+		return (rng::randlf(0.0, 1.0) < probability_[bucket]) ? bucket : alias_[bucket];
+	}
+	void SelectStochasticUniversal(size_t count, std::vector<uint32_t>& parents)
+	{
+		const std::vector<double>& fitness = *fitness_;
+		double fitness_sum = std::accumulate(fitness.begin(), fitness.end(), 0.0);
+		if (fitness_sum <= 0.0)
+		{
+			//every member has zero fitness, so select uniformly like BuildAliasTable does
+			for (size_t parent_index = 0; parent_index < count; ++parent_index)
+			{
+				parents[parent_index] = (uint32_t)rng::randull(0, fitness.size() - 1);
+			}
+			return;
+		}
+		double spacing = fitness_sum / count;
+		double pointer = rng::randlf(0.0, spacing);
+		double cumulative = 0.0;
+		size_t member_index = 0;
+		for (size_t parent_index = 0; parent_index < count; ++parent_index)
+		{
+			//advance along the wheel until the member under this pointer is found
+			while (member_index + 1 < fitness.size() && cumulative + fitness[member_index] <= pointer)
+			{
+				cumulative += fitness[member_index];
+				member_index++;
+			}
+			parents[parent_index] = (uint32_t)member_index;
+			pointer += spacing;
+		}
+		//Fisher-Yates shuffle so the mating pairs are random
+		for (size_t parent_index = count; parent_index > 1; --parent_index)
+		{
+			std::swap(parents[parent_index - 1], parents[rng::randull(0, parent_index - 1)]);
+		}
+	}
+	inline uint32_t DrawTournament() const
+	{
+		const std::vector<double>& fitness = *fitness_;
+		uint32_t winner = (uint32_t)rng::randull(0, fitness.size() - 1);
+		for (uint32_t round = 1; round < tournament_size_; ++round)
+		{
+			uint32_t challenger = (uint32_t)rng::randull(0, fitness.size() - 1);
+			if (fitness[challenger] > fitness[winner])
+			{
+				winner = challenger;
+			}
+		}
+		return winner;
+	}
+	Method method_;
+	uint32_t tournament_size_;
+	const std::vector<double>* fitness_;
+	std::vector<double> probability_;
+	std::vector<uint32_t> alias_;
+	std::vector<uint32_t> small_;
+	std::vector<uint32_t> large_;
+	std::vector<uint32_t> ranked_;
+	std::vector<double> weights_;
+};
+#endif //CS776_SELECTION_H_
@@ -0,0 +1,167 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_SIMD_H_
+#define CS776_SIMD_H_
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+//MSVC defines __AVX2__ under /arch:AVX2, gcc and clang under -mavx2 or -march=native
+#ifdef __AVX2__
+#include <immintrin.h>
+#define CS776_HAVE_AVX2
+#endif
+
+/*
+The simd functions let the same template code run on one double or on a
+vector of them. Code written against a Real type parameter using the
+arithmetic operators and the functions below (Trunc, Abs, Sqrt, Sin, Cos)
+compiles for Real = double, and for Real = Vec4d, which holds 4 doubles in
+an AVX2 register, when the compiler targets AVX2.
+
+Sin and Cos have no AVX2 instruction, so the Vec4d versions call the
+scalar functions lane by lane.
+*/
+namespace simd
+{
+	//rounds toward zero, x must be in the int64_t range. The cast is one instruction where std::trunc may be a call
+	inline double Trunc(double x)
+	{
+		return (double)(int64_t)x;
+	}
+	inline double Abs(double x)
+	{
+		return std::fabs(x);
+	}
+	inline double Sqrt(double x)
+	{
+		return std::sqrt(x);
+	}
+	inline double Sin(double x)
+	{
+		return std::sin(x);
+	}
+	inline double Cos(double x)
+	{
+		return std::cos(x);
+	}
+	template<typename Real>
+	inline Real Square(const Real& x)
+	{
+		return x * x;
+	}
+
+#ifdef CS776_HAVE_AVX2
+	class Vec4d
+	{
+	public:
+		static const size_t kWidth = 4;
+		Vec4d()
+		{
+		}
+		//not explicit so constants mix with vectors, e.g. 2.0 * x
+		Vec4d(double value) : value_(_mm256_set1_pd(value))
+		{
+		}
+		explicit Vec4d(__m256d value) : value_(value)
+		{
+		}
+		static inline Vec4d Load(const double* values)
+		{
+			return Vec4d(_mm256_loadu_pd(values));
+		}
+		inline void Store(double* values) const
+		{
+			_mm256_storeu_pd(values, value_);
+		}
+		inline __m256d Value() const
+		{
+			return value_;
+		}
+		friend inline Vec4d operator+(const Vec4d& a, const Vec4d& b)
+		{
+			return Vec4d(_mm256_add_pd(a.value_, b.value_));
+		}
+		friend inline Vec4d operator-(const Vec4d& a, const Vec4d& b)
+		{
+			return Vec4d(_mm256_sub_pd(a.value_, b.value_));
+		}
+		friend inline Vec4d operator*(const Vec4d& a, const Vec4d& b)
+		{
+			return Vec4d(_mm256_mul_pd(a.value_, b.value_));
+		}
+		friend inline Vec4d operator/(const Vec4d& a, const Vec4d& b)
+		{
+			return Vec4d(_mm256_div_pd(a.value_, b.value_));
+		}
+		friend inline Vec4d operator-(const Vec4d& a)
+		{
+			return Vec4d(_mm256_sub_pd(_mm256_setzero_pd(), a.value_));
+		}
+		inline Vec4d& operator+=(const Vec4d& other)
+		{
+			value_ = _mm256_add_pd(value_, other.value_);
+			return *this;
+		}
+		inline Vec4d& operator-=(const Vec4d& other)
+		{
+			value_ = _mm256_sub_pd(value_, other.value_);
+			return *this;
+		}
+		inline Vec4d& operator*=(const Vec4d& other)
+		{
+			value_ = _mm256_mul_pd(value_, other.value_);
+			return *this;
+		}
+	private:
+		__m256d value_;
+	};
+	inline Vec4d Trunc(const Vec4d& x)
+	{
+		return Vec4d(_mm256_round_pd(x.Value(), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+	}
+	inline Vec4d Abs(const Vec4d& x)
+	{
+		//clear the sign bits
+		return Vec4d(_mm256_andnot_pd(_mm256_set1_pd(-0.0), x.Value()));
+	}
+	inline Vec4d Sqrt(const Vec4d& x)
+	{
+		return Vec4d(_mm256_sqrt_pd(x.Value()));
+	}
+	template<double(*Function)(double)>
+	inline Vec4d PerLane(const Vec4d& x)
+	{
+		double lanes[Vec4d::kWidth];
+		x.Store(lanes);
+		for (size_t lane = 0; lane < Vec4d::kWidth; ++lane)
+		{
+			lanes[lane] = Function(lanes[lane]);
+		}
+		return Vec4d::Load(lanes);
+	}
+	inline Vec4d Sin(const Vec4d& x)
+	{
+		return PerLane<Sin>(x);
+	}
+	inline Vec4d Cos(const Vec4d& x)
+	{
+		return PerLane<Cos>(x);
+	}
+#endif
+}
+#endif //CS776_SIMD_H_
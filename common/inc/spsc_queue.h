@@ -0,0 +1,86 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_SPSC_QUEUE_H_
+#define CS776_SPSC_QUEUE_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+/*
+SpscQueue is a bounded lock-free queue for exactly one producer thread and
+one consumer thread.
+
+The slots are allocated once from a prototype item, and items are copied in
+and out by assignment, so for items like std::vector whose size doesn't
+change pushing and popping never allocate. Neither side ever waits: TryPush
+fails if the queue is full and TryPop fails if it is empty.
+*/
+template<typename T>
+class SpscQueue
+{
+public:
+	SpscQueue(size_t capacity, const T& prototype) : slots_(capacity + 1, prototype), head_(0), tail_(0)
+	{
+		//one slot is always left empty so that head_ == tail_ only means empty
+	}
+	//called only by the producer
+	bool TryPush(const T& item)
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t next_tail = Next(tail);
+		if (next_tail == head_.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		slots_[tail] = item;
+		//publish the slot only after it has been written
+		tail_.store(next_tail, std::memory_order_release);
+		return true;
+	}
+	//called only by the consumer
+	bool TryPop(T& item)
+	{
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = slots_[head];
+		//hand the slot back to the producer only after it has been read
+		head_.store(Next(head), std::memory_order_release);
+		return true;
+	}
+	size_t Capacity() const
+	{
+		return slots_.size() - 1;
+	}
+private:
+	inline size_t Next(size_t index) const
+	{
+		return (index + 1 == slots_.size()) ? 0 : index + 1;
+	}
+	std::vector<T> slots_;
+	//the producer and consumer indexes are padded onto separate cache lines so the two threads don't fight over one line
+	static const size_t kCacheLineSize = 64;
+	std::atomic<size_t> head_;
+	char head_padding_[kCacheLineSize];
+	std::atomic<size_t> tail_;
+	char tail_padding_[kCacheLineSize];
+};
+#endif //CS776_SPSC_QUEUE_H_
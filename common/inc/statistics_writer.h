@@ -0,0 +1,403 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_STATISTICS_WRITER_H_
+#define CS776_STATISTICS_WRITER_H_
+#include "ionlib\log.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+StatisticsWriter writes a table of numeric rows, with free text notes
+between them, to a file on a background thread so that the thread producing
+the rows never waits on formatting or disk I/O.
+
+Rows are collected column by column into fixed size blocks. A full block
+(or a note) is handed to the writer thread, and the blocks are recycled once
+written, so steady state writing doesn't allocate. At most kMaxBlocks are in
+flight; if the disk falls that far behind, AddRow waits for a free block.
+
+The formats are:
+  * CSV: a header line with the column names, then one line per row and
+    one line per note, exactly as the rows and notes were added
+  * BINARY: a compact columnar format, see below. ConvertStatistics turns a
+    binary file into the CSV which the same calls would have written
+
+The binary format (native byte order) is the magic "CS776ST1", the uint32
+number of columns, then for each column its uint32 name length and the name.
+That's followed by any number of blocks, each starting with a uint32 tag:
+  * kRowsTag: the uint32 number of rows, then for each column that many
+    doubles
+  * kNoteTag: the uint32 note length and the note's characters
+*/
+class StatisticsWriter
+{
+public:
+	enum Format
+	{
+		CSV,
+		BINARY
+	};
+	static bool ParseFormat(const std::string& name, Format* format)
+	{
+		if (name == "csv")
+		{
+			*format = CSV;
+		} else if (name == "binary")
+		{
+			*format = BINARY;
+		} else
+		{
+			return false;
+		}
+		return true;
+	}
+	//the file extension for files in format, including the dot
+	static const char* Extension(Format format)
+	{
+		return format == CSV ? ".csv" : ".stats";
+	}
+	StatisticsWriter(const std::string& filename, Format format, const std::vector<std::string>& columns)
+	{
+		format_ = format;
+		num_columns_ = columns.size();
+		closed_ = false;
+		current_ = NULL;
+		file_ = fopen(filename.c_str(), "wb");
+		if (file_ == NULL)
+		{
+			LOGERROR("Couldn't open %s, its statistics will be lost", filename.c_str());
+		} else
+		{
+			setvbuf(file_, NULL, _IOFBF, kFileBufferSize);
+			WriteHeader(columns);
+		}
+		text_.reserve(kRowsPerBlock * num_columns_ * 16);
+		writer_ = std::thread(&StatisticsWriter::WriterThread, this);
+	}
+	~StatisticsWriter()
+	{
+		Close();
+	}
+	//values must hold one value per column
+	void AddRow(const double* values)
+	{
+		if (current_ == NULL)
+		{
+			current_ = AcquireBlock();
+			current_->is_note = false;
+			current_->num_rows = 0;
+		}
+		for (size_t column = 0; column < num_columns_; ++column)
+		{
+			current_->values[column * kRowsPerBlock + current_->num_rows] = values[column];
+		}
+		current_->num_rows++;
+		if (current_->num_rows == kRowsPerBlock)
+		{
+			SubmitCurrent();
+		}
+	}
+	void AddNote(const std::string& note)
+	{
+		SubmitCurrent();
+		block_t* block = AcquireBlock();
+		block->is_note = true;
+		block->note = note;
+		Submit(block);
+	}
+	//writes everything which has been added and closes the file
+	void Close()
+	{
+		if (closed_)
+		{
+			return;
+		}
+		SubmitCurrent();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+		}
+		pending_cv_.notify_one();
+		writer_.join();
+		if (file_ != NULL)
+		{
+			fclose(file_);
+			file_ = NULL;
+		}
+	}
+	//appends values as one CSV line, this is shared with ConvertStatistics so both produce the same text
+	static void AppendCsvRow(const double* values, size_t num_values, size_t stride, std::string* text)
+	{
+		char number[32];
+		for (size_t column = 0; column < num_values; ++column)
+		{
+			int length = snprintf(number, sizeof(number), column == 0 ? "%g" : ",%g", values[column * stride]);
+			text->append(number, length);
+		}
+		text->push_back('\n');
+	}
+	static const uint32_t kRowsTag = 1;
+	static const uint32_t kNoteTag = 2;
+	static const size_t kRowsPerBlock = 4096;
+private:
+	static const size_t kMaxBlocks = 8;
+	static const size_t kFileBufferSize = 1 << 20;
+	typedef struct block_s
+	{
+		bool is_note;
+		size_t num_rows;
+		//column major, values[column * kRowsPerBlock + row]
+		std::vector<double> values;
+		std::string note;
+	} block_t;
+	void WriteHeader(const std::vector<std::string>& columns)
+	{
+		if (format_ == CSV)
+		{
+			for (size_t column = 0; column < columns.size(); ++column)
+			{
+				if (column != 0)
+				{
+					fputc(',', file_);
+				}
+				fputs(columns[column].c_str(), file_);
+			}
+			fputc('\n', file_);
+			return;
+		}
+		fwrite("CS776ST1", 1, 8, file_);
+		WriteUint32((uint32_t)columns.size());
+		for (size_t column = 0; column < columns.size(); ++column)
+		{
+			WriteUint32((uint32_t)columns[column].size());
+			fwrite(columns[column].data(), 1, columns[column].size(), file_);
+		}
+	}
+	void WriteUint32(uint32_t value)
+	{
+		fwrite(&value, sizeof(value), 1, file_);
+	}
+	block_t* AcquireBlock()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (free_.empty() && blocks_.size() < kMaxBlocks)
+		{
+			blocks_.push_back(std::unique_ptr<block_t>(new block_t));
+			blocks_.back()->values.resize(kRowsPerBlock * num_columns_);
+			return blocks_.back().get();
+		}
+		free_cv_.wait(lock, [this]() { return !free_.empty(); });
+		block_t* block = free_.back();
+		free_.pop_back();
+		return block;
+	}
+	void Submit(block_t* block)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_.push_back(block);
+		}
+		pending_cv_.notify_one();
+	}
+	void SubmitCurrent()
+	{
+		if (current_ != NULL)
+		{
+			Submit(current_);
+			current_ = NULL;
+		}
+	}
+	void WriterThread()
+	{
+		for (;;)
+		{
+			block_t* block;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				pending_cv_.wait(lock, [this]() { return closed_ || !pending_.empty(); });
+				if (pending_.empty())
+				{
+					return;
+				}
+				block = pending_.front();
+				pending_.pop_front();
+			}
+			if (file_ != NULL)
+			{
+				WriteBlock(*block);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				free_.push_back(block);
+			}
+			free_cv_.notify_one();
+		}
+	}
+	void WriteBlock(const block_t& block)
+	{
+		if (block.is_note)
+		{
+			if (format_ == CSV)
+			{
+				fwrite(block.note.data(), 1, block.note.size(), file_);
+				fputc('\n', file_);
+			} else
+			{
+				WriteUint32(kNoteTag);
+				WriteUint32((uint32_t)block.note.size());
+				fwrite(block.note.data(), 1, block.note.size(), file_);
+			}
+			return;
+		}
+		if (format_ == CSV)
+		{
+			text_.clear();
+			for (size_t row = 0; row < block.num_rows; ++row)
+			{
+				AppendCsvRow(&block.values[row], num_columns_, kRowsPerBlock, &text_);
+			}
+			fwrite(text_.data(), 1, text_.size(), file_);
+		} else
+		{
+			WriteUint32(kRowsTag);
+			WriteUint32((uint32_t)block.num_rows);
+			for (size_t column = 0; column < num_columns_; ++column)
+			{
+				fwrite(&block.values[column * kRowsPerBlock], sizeof(double), block.num_rows, file_);
+			}
+		}
+	}
+	Format format_;
+	size_t num_columns_;
+	FILE* file_;
+	//the block AddRow is filling, only touched by the producer
+	block_t* current_;
+	//owns every block, the others hold pointers into it
+	std::vector<std::unique_ptr<block_t>> blocks_;
+	std::deque<block_t*> pending_;
+	std::vector<block_t*> free_;
+	std::mutex mutex_;
+	std::condition_variable pending_cv_;
+	std::condition_variable free_cv_;
+	bool closed_;
+	//the writer thread's formatting buffer
+	std::string text_;
+	std::thread writer_;
+};
+
+/*
+  Converts a file written by StatisticsWriter in the BINARY format to the CSV
+  which the CSV format would have produced. Returns false if binary_filename
+  can't be read or isn't a statistics file.
+*/
+inline bool ConvertStatistics(const std::string& binary_filename, const std::string& csv_filename)
+{
+	FILE* in = fopen(binary_filename.c_str(), "rb");
+	if (in == NULL)
+	{
+		LOGERROR("Couldn't open %s", binary_filename.c_str());
+		return false;
+	}
+	std::unique_ptr<FILE, int(*)(FILE*)> in_closer(in, fclose);
+	char magic[8];
+	uint32_t num_columns;
+	if (fread(magic, 1, 8, in) != 8 || memcmp(magic, "CS776ST1", 8) != 0 || fread(&num_columns, sizeof(num_columns), 1, in) != 1)
+	{
+		LOGERROR("%s isn't a statistics file", binary_filename.c_str());
+		return false;
+	}
+	FILE* out = fopen(csv_filename.c_str(), "wb");
+	if (out == NULL)
+	{
+		LOGERROR("Couldn't open %s", csv_filename.c_str());
+		return false;
+	}
+	std::unique_ptr<FILE, int(*)(FILE*)> out_closer(out, fclose);
+	std::string text;
+	for (uint32_t column = 0; column < num_columns; ++column)
+	{
+		uint32_t length;
+		if (fread(&length, sizeof(length), 1, in) != 1)
+		{
+			LOGERROR("%s is truncated", binary_filename.c_str());
+			return false;
+		}
+		std::string name(length, '\0');
+		if (length > 0 && fread(&name[0], 1, length, in) != length)
+		{
+			LOGERROR("%s is truncated", binary_filename.c_str());
+			return false;
+		}
+		if (column != 0)
+		{
+			text.push_back(',');
+		}
+		text.append(name);
+	}
+	text.push_back('\n');
+	std::vector<double> values;
+	uint32_t tag;
+	while (fread(&tag, sizeof(tag), 1, in) == 1)
+	{
+		uint32_t count;
+		if (fread(&count, sizeof(count), 1, in) != 1)
+		{
+			LOGERROR("%s is truncated", binary_filename.c_str());
+			return false;
+		}
+		if (tag == StatisticsWriter::kNoteTag)
+		{
+			std::string note(count, '\0');
+			if (count > 0 && fread(&note[0], 1, count, in) != count)
+			{
+				LOGERROR("%s is truncated", binary_filename.c_str());
+				return false;
+			}
+			text.append(note);
+			text.push_back('\n');
+		} else if (tag == StatisticsWriter::kRowsTag)
+		{
+			values.resize((size_t)count * num_columns);
+			if (fread(values.data(), sizeof(double), values.size(), in) != values.size())
+			{
+				LOGERROR("%s is truncated", binary_filename.c_str());
+				return false;
+			}
+			for (uint32_t row = 0; row < count; ++row)
+			{
+				StatisticsWriter::AppendCsvRow(&values[row], num_columns, count, &text);
+			}
+		} else
+		{
+			LOGERROR("%s has an unknown block type %u", binary_filename.c_str(), tag);
+			return false;
+		}
+		fwrite(text.data(), 1, text.size(), out);
+		text.clear();
+	}
+	fwrite(text.data(), 1, text.size(), out);
+	return true;
+}
+#endif //CS776_STATISTICS_WRITER_H_
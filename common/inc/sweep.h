@@ -0,0 +1,297 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_SWEEP_H_
+#define CS776_SWEEP_H_
+#include "ionlib\log.h"
+#include "random.h"
+#include <stdio.h>
+#include <cmath>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+
+/*
+ParameterSweep picks the points of a parameter sweep. A point is one value
+per parameter:
+  * Grid: every combination of the given values of each parameter
+  * Random: count points drawn uniformly from each parameter's range
+  * LatinHypercube: count points where each parameter's range is cut into
+    count equal strata and every stratum holds exactly one point, so a
+    handful of points still covers every parameter's whole range
+
+A range can be logarithmic, e.g. for mutation rates spanning several orders
+of magnitude, in which case it is sampled uniformly in log space.
+
+The samplers draw from their own generator seeded with seed, so the same
+seed gives the same points without disturbing any thread's rng stream.
+*/
+class ParameterSweep
+{
+public:
+	enum Method
+	{
+		GRID,
+		RANDOM,
+		LATIN_HYPERCUBE
+	};
+	static bool ParseMethod(const std::string& name, Method* method)
+	{
+		if (name == "grid")
+		{
+			*method = GRID;
+		} else if (name == "random")
+		{
+			*method = RANDOM;
+		} else if (name == "lhs")
+		{
+			*method = LATIN_HYPERCUBE;
+		} else
+		{
+			return false;
+		}
+		return true;
+	}
+	typedef struct range_s
+	{
+		double min;
+		double max;
+		bool logarithmic;
+	} Range;
+	//values[parameter] are the values parameter takes, the last parameter changes fastest
+	static std::vector<std::vector<double>> Grid(const std::vector<std::vector<double>>& values)
+	{
+		std::vector<std::vector<double>> points(1);
+		for (size_t parameter = 0; parameter < values.size(); ++parameter)
+		{
+			std::vector<std::vector<double>> extended;
+			extended.reserve(points.size() * values[parameter].size());
+			for (size_t point = 0; point < points.size(); ++point)
+			{
+				for (size_t value = 0; value < values[parameter].size(); ++value)
+				{
+					extended.push_back(points[point]);
+					extended.back().push_back(values[parameter][value]);
+				}
+			}
+			points.swap(extended);
+		}
+		return points;
+	}
+	static std::vector<std::vector<double>> Random(const std::vector<Range>& ranges, size_t count, uint64_t seed)
+	{
+		rng::Xoshiro256 engine(seed);
+		std::vector<std::vector<double>> points(count, std::vector<double>(ranges.size()));
+		for (size_t point = 0; point < count; ++point)
+		{
+			for (size_t parameter = 0; parameter < ranges.size(); ++parameter)
+			{
+				points[point][parameter] = Interpolate(ranges[parameter], rng::ToUnit(engine()));
+			}
+		}
+		return points;
+	}
+	static std::vector<std::vector<double>> LatinHypercube(const std::vector<Range>& ranges, size_t count, uint64_t seed)
+	{
+		rng::Xoshiro256 engine(seed);
+		std::vector<std::vector<double>> points(count, std::vector<double>(ranges.size()));
+		std::vector<size_t> strata(count);
+		for (size_t parameter = 0; parameter < ranges.size(); ++parameter)
+		{
+			//a random permutation assigns each point its own stratum of this parameter
+			std::iota(strata.begin(), strata.end(), (size_t)0);
+			for (size_t index = count; index > 1; --index)
+			{
+				std::swap(strata[index - 1], strata[engine() % index]);
+			}
+			for (size_t point = 0; point < count; ++point)
+			{
+				double position = (strata[point] + rng::ToUnit(engine())) / count;
+				points[point][parameter] = Interpolate(ranges[parameter], position);
+			}
+		}
+		return points;
+	}
+private:
+	//the value position of the way through range, position in [0, 1)
+	static double Interpolate(const Range& range, double position)
+	{
+		if (range.logarithmic)
+		{
+			return range.min * std::pow(range.max / range.min, position);
+		}
+		return range.min + position * (range.max - range.min);
+	}
+};
+
+//how well RunSweep kept the threads busy
+typedef struct sweep_report_s
+{
+	uint32_t num_threads;
+	uint64_t num_items;
+	//items a thread took from another thread's queue
+	uint64_t num_steals;
+	double wall_seconds;
+	//the time the threads spent running and merging items, i.e. about what one thread would have taken
+	double busy_seconds;
+	//from the first thread running out of work to the last one finishing
+	double tail_seconds;
+} sweep_report_t;
+
+//prints and logs report, efficiency is busy time over the time the threads were available
+inline void LogSweepReport(const sweep_report_t& report)
+{
+	double speedup = report.wall_seconds > 0.0 ? report.busy_seconds / report.wall_seconds : 0.0;
+	double efficiency = report.num_threads > 0 ? speedup / report.num_threads : 0.0;
+	printf("%llu items on %u threads: %.2lf s wall, %.2lf s busy, %.2lfx speedup, %.1lf%% efficiency, %.2lf s tail, %llu steals\n",
+		(unsigned long long)report.num_items, report.num_threads, report.wall_seconds, report.busy_seconds, speedup, efficiency * 100.0, report.tail_seconds, (unsigned long long)report.num_steals);
+	LOGINFO("Sweep of %llu items on %u threads took %.2lf s (%.2lf s busy, %.1lf%% efficiency, %.2lf s tail, %llu steals)",
+		(unsigned long long)report.num_items, report.num_threads, report.wall_seconds, report.busy_seconds, efficiency * 100.0, report.tail_seconds, (unsigned long long)report.num_steals);
+}
+
+/*
+  Runs run_trial(config, trial) for num_trials trials of every configuration
+  on num_threads threads (0 means one per hardware thread), and returns how
+  busy the threads were.
+
+  Every (configuration, trial) pair is a separate work item, so the threads
+  move on to the next configuration's trials instead of idling while the
+  last trials of a configuration finish. costs[config] is an estimate of
+  how long a trial of config takes, and the items are dealt out longest
+  first (round robin over per thread queues) so the long configurations
+  start early and the short ones fill in the gaps at the end. A thread
+  whose queue is empty steals the cheapest item left in another queue, which
+  corrects for the estimates being off.
+
+  As in RunTrials, the rng stream is seeded with rng::StreamSeed(base_seed,
+  trial) before every trial, so a configuration's results are the same as
+  running it through RunTrials with that seed. merge_trial(config, trial) is
+  called in trial order for each configuration as soon as that trial and the
+  ones before it have finished; merges of the same configuration run one at
+  a time, merges of different configurations may run concurrently.
+*/
+template<typename TrialFunction, typename MergeFunction>
+sweep_report_t RunSweep(const std::vector<double>& costs, uint32_t num_trials, uint64_t base_seed, uint32_t num_threads, TrialFunction run_trial, MergeFunction merge_trial)
+{
+	typedef std::chrono::steady_clock Clock;
+	const uint32_t num_configs = (uint32_t)costs.size();
+	const uint64_t num_items = (uint64_t)num_configs * num_trials;
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	num_threads = (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(num_threads, num_items));
+	std::vector<uint32_t> order(num_configs);
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return costs[a] > costs[b];
+	});
+	//the items last milliseconds to minutes, so a locked deque per thread costs nothing measurable
+	std::vector<std::deque<uint64_t>> queues(num_threads);
+	std::vector<std::mutex> queue_mutexes(num_threads);
+	uint64_t next_queue = 0;
+	for (uint32_t config_index = 0; config_index < num_configs; ++config_index)
+	{
+		for (uint32_t trial = 0; trial < num_trials; ++trial)
+		{
+			queues[next_queue++ % num_threads].push_back((uint64_t)order[config_index] * num_trials + trial);
+		}
+	}
+	std::vector<uint8_t> finished((size_t)num_items, 0);
+	std::vector<uint32_t> next_merge(num_configs, 0);
+	std::vector<std::mutex> merge_mutexes(num_configs);
+	std::vector<double> busy_seconds(num_threads, 0.0);
+	std::vector<Clock::time_point> finish_times(num_threads);
+	std::atomic<uint64_t> num_steals(0);
+	Clock::time_point start = Clock::now();
+	auto take = [&](uint32_t self, uint64_t* item)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue_mutexes[self]);
+			if (!queues[self].empty())
+			{
+				*item = queues[self].front();
+				queues[self].pop_front();
+				return true;
+			}
+		}
+		for (uint32_t offset = 1; offset < num_threads; ++offset)
+		{
+			uint32_t victim = (self + offset) % num_threads;
+			std::lock_guard<std::mutex> lock(queue_mutexes[victim]);
+			if (!queues[victim].empty())
+			{
+				*item = queues[victim].back();
+				queues[victim].pop_back();
+				num_steals++;
+				return true;
+			}
+		}
+		//nothing is ever added, so once every queue is empty there is no more work
+		return false;
+	};
+	auto worker = [&](uint32_t self)
+	{
+		uint64_t item;
+		while (take(self, &item))
+		{
+			Clock::time_point item_start = Clock::now();
+			uint32_t config = (uint32_t)(item / num_trials);
+			uint32_t trial = (uint32_t)(item % num_trials);
+			rng::Seed(rng::StreamSeed(base_seed, trial));
+			run_trial(config, trial);
+			{
+				std::lock_guard<std::mutex> lock(merge_mutexes[config]);
+				finished[(size_t)item] = 1;
+				while (next_merge[config] < num_trials && finished[(size_t)config * num_trials + next_merge[config]])
+				{
+					merge_trial(config, next_merge[config]++);
+				}
+			}
+			busy_seconds[self] += std::chrono::duration<double>(Clock::now() - item_start).count();
+		}
+		finish_times[self] = Clock::now();
+	};
+	std::vector<std::thread> threads;
+	for (uint32_t thread_index = 1; thread_index < num_threads; ++thread_index)
+	{
+		threads.push_back(std::thread(worker, thread_index));
+	}
+	//the calling thread does its share of the work too
+	worker(0);
+	for (std::vector<std::thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); ++thread_it)
+	{
+		thread_it->join();
+	}
+	sweep_report_t report;
+	report.num_threads = num_threads;
+	report.num_items = num_items;
+	report.num_steals = num_steals;
+	report.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	report.busy_seconds = std::accumulate(busy_seconds.begin(), busy_seconds.end(), 0.0);
+	std::pair<std::vector<Clock::time_point>::iterator, std::vector<Clock::time_point>::iterator> extremes = std::minmax_element(finish_times.begin(), finish_times.end());
+	report.tail_seconds = std::chrono::duration<double>(*extremes.second - *extremes.first).count();
+	return report;
+}
+#endif //CS776_SWEEP_H_
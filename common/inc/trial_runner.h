@@ -0,0 +1,265 @@
+/*
+Copyright (C) 2016  Tim Sweet
+
+This program is free software : you can redistribute it and / or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CS776_TRIAL_RUNNER_H_
+#define CS776_TRIAL_RUNNER_H_
+#include "random.h"
+#include "checkpoint.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+/*
+TrialStatistics holds the per generation statistics of a single trial. Each
+trial records into its own instance so trials can run concurrently, and the
+results are merged in trial order afterwards.
+*/
+class TrialStatistics
+{
+public:
+	void Reserve(size_t num_generations)
+	{
+		min_fitness.reserve(num_generations);
+		max_fitness.reserve(num_generations);
+		avg_fitness.reserve(num_generations);
+		num_evals.reserve(num_generations);
+	}
+	//reserves the cache counters too, for trials which call RecordCache
+	void ReserveCache(size_t num_generations)
+	{
+		cache_hits.reserve(num_generations);
+		cache_misses.reserve(num_generations);
+	}
+	//records the current generation of any ion::GeneticAlgorithm
+	template<typename GeneticAlgorithm>
+	void Record(GeneticAlgorithm& ga)
+	{
+		min_fitness.push_back(ga.GetMinFitness());
+		max_fitness.push_back(ga.GetMaxFitness());
+		avg_fitness.push_back(ga.GetAverageFitness());
+		num_evals.push_back(ga.GetNumEvals());
+	}
+	//records the running totals of a fitness cache's hits and misses, once per generation after Record
+	void RecordCache(uint64_t hits, uint64_t misses)
+	{
+		cache_hits.push_back((double)hits);
+		cache_misses.push_back((double)misses);
+	}
+	bool HasCache() const
+	{
+		return !cache_hits.empty();
+	}
+	size_t NumGenerations() const
+	{
+		return max_fitness.size();
+	}
+	void Save(ByteWriter& writer) const
+	{
+		writer.WriteVector(min_fitness);
+		writer.WriteVector(max_fitness);
+		writer.WriteVector(avg_fitness);
+		writer.WriteVector(num_evals);
+		writer.WriteVector(cache_hits);
+		writer.WriteVector(cache_misses);
+	}
+	bool Load(ByteReader& reader)
+	{
+		return reader.ReadVector(&min_fitness) && reader.ReadVector(&max_fitness) && reader.ReadVector(&avg_fitness) && reader.ReadVector(&num_evals) &&
+			reader.ReadVector(&cache_hits) && reader.ReadVector(&cache_misses);
+	}
+	//frees the buffers once the trial has been merged
+	void Release()
+	{
+		std::vector<double>().swap(min_fitness);
+		std::vector<double>().swap(max_fitness);
+		std::vector<double>().swap(avg_fitness);
+		std::vector<double>().swap(num_evals);
+		std::vector<double>().swap(cache_hits);
+		std::vector<double>().swap(cache_misses);
+	}
+	std::vector<double> min_fitness;
+	std::vector<double> max_fitness;
+	std::vector<double> avg_fitness;
+	std::vector<double> num_evals;
+	//empty unless the trial used a fitness cache
+	std::vector<double> cache_hits;
+	std::vector<double> cache_misses;
+};
+
+/*
+RunningStatistic keeps the mean and variance of a stream of values with
+Welford's online algorithm, which unlike summing and dividing at the end
+doesn't lose precision as the count grows.
+*/
+class RunningStatistic
+{
+public:
+	RunningStatistic() : count_(0), mean_(0.0), m2_(0.0)
+	{
+	}
+	void Add(double value)
+	{
+		count_++;
+		double delta = value - mean_;
+		mean_ += delta / count_;
+		m2_ += delta * (value - mean_);
+	}
+	uint64_t Count() const
+	{
+		return count_;
+	}
+	double Mean() const
+	{
+		return mean_;
+	}
+	//the sample variance, 0 until there are two values
+	double Variance() const
+	{
+		return count_ > 1 ? m2_ / (count_ - 1) : 0.0;
+	}
+private:
+	uint64_t count_;
+	double mean_;
+	double m2_;
+};
+
+//RunningStatistic is saved to checkpoints as raw bytes, so it must stay trivially copyable
+typedef struct generation_summary_s
+{
+	RunningStatistic min_fitness;
+	RunningStatistic max_fitness;
+	RunningStatistic avg_fitness;
+	RunningStatistic num_evals;
+	RunningStatistic cache_hits;
+	RunningStatistic cache_misses;
+} generation_summary_t;
+
+/*
+GenerationSummary aggregates the TrialStatistics of many trials generation
+by generation. Trials which stopped early only count towards the
+generations they reached.
+*/
+class GenerationSummary
+{
+public:
+	void Reserve(size_t num_generations)
+	{
+		generations_.reserve(num_generations);
+	}
+	void Add(const TrialStatistics& statistics)
+	{
+		if (statistics.NumGenerations() > generations_.size())
+		{
+			generations_.resize(statistics.NumGenerations());
+		}
+		for (size_t generation = 0; generation < statistics.NumGenerations(); ++generation)
+		{
+			generation_summary_t& summary = generations_[generation];
+			summary.min_fitness.Add(statistics.min_fitness[generation]);
+			summary.max_fitness.Add(statistics.max_fitness[generation]);
+			summary.avg_fitness.Add(statistics.avg_fitness[generation]);
+			summary.num_evals.Add(statistics.num_evals[generation]);
+			if (statistics.HasCache())
+			{
+				summary.cache_hits.Add(statistics.cache_hits[generation]);
+				summary.cache_misses.Add(statistics.cache_misses[generation]);
+			}
+		}
+	}
+	size_t NumGenerations() const
+	{
+		return generations_.size();
+	}
+	const generation_summary_t& operator[](size_t generation) const
+	{
+		return generations_[generation];
+	}
+	void Save(ByteWriter& writer) const
+	{
+		writer.WriteVector(generations_);
+	}
+	bool Load(ByteReader& reader)
+	{
+		return reader.ReadVector(&generations_);
+	}
+private:
+	std::vector<generation_summary_t> generations_;
+};
+
+/*
+  Runs run_trial(trial) for every trial in [0, num_trials) on num_threads
+  threads (0 means one per hardware thread).
+
+  Before each trial the running thread's rng stream is seeded from base_seed
+  and the trial number, so a trial draws the same random numbers no matter
+  which thread runs it or how many threads there are. run_trial must only
+  write to state owned by its trial.
+
+  merge_trial(trial) is called once per trial, in trial order, as soon as
+  that trial and every trial before it have finished. The merges run one at a
+  time on whichever worker finished the trial which let them proceed, so
+  merge_trial can stream results out (and free the trial's buffers) while
+  later trials are still running without locking anything itself.
+*/
+template<typename TrialFunction, typename MergeFunction>
+void RunTrials(uint32_t num_trials, uint64_t base_seed, uint32_t num_threads, TrialFunction run_trial, MergeFunction merge_trial)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	num_threads = std::min(num_threads, num_trials);
+	std::atomic<uint32_t> next_trial(0);
+	std::mutex merge_mutex;
+	std::vector<uint8_t> finished(num_trials, 0);
+	uint32_t next_merge = 0;
+	auto worker = [&]()
+	{
+		for (uint32_t trial = next_trial++; trial < num_trials; trial = next_trial++)
+		{
+			rng::Seed(rng::StreamSeed(base_seed, trial));
+			run_trial(trial);
+			std::lock_guard<std::mutex> lock(merge_mutex);
+			finished[trial] = 1;
+			while (next_merge < num_trials && finished[next_merge])
+			{
+				merge_trial(next_merge++);
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for (uint32_t thread_index = 1; thread_index < num_threads; ++thread_index)
+	{
+		threads.push_back(std::thread(worker));
+	}
+	//the calling thread does its share of the work too
+	worker();
+	for (std::vector<std::thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); ++thread_it)
+	{
+		thread_it->join();
+	}
+}
+
+//RunTrials without a merge step, the caller merges the results in trial order once this returns
+template<typename TrialFunction>
+void RunTrials(uint32_t num_trials, uint64_t base_seed, uint32_t num_threads, TrialFunction run_trial)
+{
+	RunTrials(num_trials, base_seed, num_threads, run_trial, [](uint32_t) {});
+}
+#endif //CS776_TRIAL_RUNNER_H_